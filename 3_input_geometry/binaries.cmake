@@ -3,6 +3,9 @@
 add_library(helper_v1 3_input_geometry/helper.c)
 target_include_directories(helper_v1 PUBLIC ${CMAKE_SOURCE_DIR}/3_input_geometry)
 target_link_libraries(helper_v1 PRIVATE webgpu_dawn)
+# The programs here load their shaders themselves, they are only validated
+validate_shaders(INPUT_GEOMETRY_SHADERS ${CMAKE_SOURCE_DIR}/3_input_geometry/resources)
+add_custom_target(input_geometry_shaders ALL DEPENDS ${INPUT_GEOMETRY_SHADERS})
 
 #---------- VERTEX_ATTRIBUTE
 add_executable(vertex_attribute
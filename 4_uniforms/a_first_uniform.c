@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <glfw3webgpu.h>
 #include "helper_v2.h"
+#include "shader_registry.h"
 
 int main(int argc, char *argv[]) {
 	WGPUInstanceDescriptor desc = { .nextInChain = NULL};
@@ -213,10 +214,10 @@ int main(int argc, char *argv[]) {
 
 	// Create index buffer
 	// (we reuse the bufferDesc initialized for the vertexBuffer)
-	// bufferDesc.size has to be indexCount × sizeof(float) or I get UnalignedBufferOffset(30) 
-	// Not sure why. I'll have to look into it
+	// bufferDesc.size has to be a multiple of 4 bytes or I get UnalignedBufferOffset(30).
+	// loadGeometry pads indexData with zeros up to that size.
 	bufferDesc = (WGPUBufferDescriptor){
-		.size = indexCount * sizeof(float),
+		.size = (indexDataSize + 3) & ~3,
 		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
 		.mappedAtCreation = false
 	};
@@ -320,6 +321,9 @@ int main(int argc, char *argv[]) {
 		wgpuSwapChainPresent(swapChain);
 	}
 
+	printShaderRegistryStats();
+	releaseShaderRegistry();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
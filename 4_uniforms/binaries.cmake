@@ -1,7 +1,18 @@
 #---------- HELPER V2
-add_library(helper_v2 4_uniforms/helper_v2.c)
-target_include_directories(helper_v2 PUBLIC ${CMAKE_SOURCE_DIR}/3_input_geometry)
+# The shader registry and uniform helpers are shared with helper_v3
+add_library(helper_v2
+4_uniforms/helper_v2.c
+5_3d_meshes/shader_registry.c
+5_3d_meshes/hash.c
+5_3d_meshes/uniform_ring.c
+5_3d_meshes/frames_in_flight.c
+5_3d_meshes/uniform_block.c
+5_3d_meshes/uniform_layout.c
+5_3d_meshes/wgsl_preprocessor.c
+)
+target_include_directories(helper_v2 PUBLIC ${CMAKE_SOURCE_DIR}/3_input_geometry ${CMAKE_SOURCE_DIR}/5_3d_meshes)
 target_link_libraries(helper_v2 PRIVATE webgpu_dawn)
+embed_shaders(helper_v2 ${CMAKE_SOURCE_DIR}/4_uniforms/resources)
 
 #---------- A_FIRST_UNIFORM
 add_executable(a_first_uniform
@@ -8,13 +8,16 @@
 #include <stdlib.h>
 #include <glfw3webgpu.h>
 #include "helper_v2.h"
+#include "shader_registry.h"
+#include "uniform_layout.h"
+#include "frames_in_flight.h"
+#include "uniform_ring.h"
 
-typedef struct MyUniforms {
-    float color[4];
-    float time;
-	float _pad[3];
-} MyUniforms;
-static_assert(sizeof(MyUniforms) % 16 == 0, "MyUniforms is multiple of 16");
+// Declared once, laid out the way WGSL lays it out (see uniform_layout.h)
+#define MY_UNIFORMS(FIELD) \
+	FIELD(vec4f, color) \
+	FIELD(f32, time)
+UNIFORM_STRUCT(MyUniforms, MY_UNIFORMS)
 
 int main(int argc, char *argv[]) {
 	WGPUInstanceDescriptor desc = { .nextInChain = NULL};
@@ -92,6 +95,8 @@ int main(int argc, char *argv[]) {
 
 	WGPUShaderModule shaderModule = loadShaderModule(RESOURCE_DIR "/more_uniforms.wsl", device);
 	printf( "Shader module: %p\n", shaderModule);
+	// Both sides must agree on the uniforms' layout
+	if (!checkShaderUniforms(RESOURCE_DIR "/more_uniforms.wsl", NULL, 0, UNIFORM_LAYOUT(MyUniforms))) return 1;
 
 	printf( "Creating render pipeline...\n");
 
@@ -225,10 +230,10 @@ int main(int argc, char *argv[]) {
 
 	// Create index buffer
 	// (we reuse the bufferDesc initialized for the vertexBuffer)
-	// bufferDesc.size has to be indexCount × sizeof(float) or I get UnalignedBufferOffset(30) 
-	// Not sure why. I'll have to look into it
+	// bufferDesc.size has to be a multiple of 4 bytes or I get UnalignedBufferOffset(30).
+	// loadGeometry pads indexData with zeros up to that size.
 	bufferDesc = (WGPUBufferDescriptor){
-		.size = indexCount * sizeof(float),
+		.size = (indexDataSize + 3) & ~3,
 		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
 		.mappedAtCreation = false
 	};
@@ -239,38 +244,35 @@ int main(int argc, char *argv[]) {
 	free(indexData);
 	free(pointData);
 
-	// Create uniform buffer
-	// Subtlety
-	uint32_t uniformStride = (uint32_t)sizeof(MyUniforms) > (uint32_t)requiredLimits.limits.minUniformBufferOffsetAlignment ? sizeof(MyUniforms) : requiredLimits.limits.minUniformBufferOffsetAlignment;
-	// The buffer will only contain 1 float with the value of uTime
-	bufferDesc = (WGPUBufferDescriptor){
-		.size = uniformStride + sizeof(MyUniforms),
-		.nextInChain = NULL,
-		// Make sure to flag the buffer as BufferUsage::Uniform
-		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-		.mappedAtCreation = false
-	};
-	WGPUBuffer uniformBuffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+	// Every draw gets its own slice of one uniform buffer, bound with a dynamic
+	// offset. The ring holds several frames of them, for the frames in flight.
+	t_frames_in_flight frames;
+	initFramesInFlight(&frames, device, 2);
+	t_uniform_ring uniformRing;
+	if (!initUniformRing(&uniformRing, &frames, 64 * 1024)) {
+		fprintf(stderr, "Could not create the uniform ring!\n");
+		return 1;
+	}
 
-	// Upload first value
-	MyUniforms uniforms = {
-		.color = { 0.0f, 1.0f, 0.4f, 1.0f },
-		.time = 1.0f,
-		};
-	wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
-	// Upload second value
-	uniforms = (MyUniforms){
-		.time = -1.0f,
-		.color = { 1.0f, 1.0f, 1.0f, 0.7f }
+	// One object per draw
+	MyUniforms objects[] = {
+		{
+			.color = { 0.0f, 1.0f, 0.4f, 1.0f },
+			.time = 1.0f,
+		},
+		{
+			.time = -1.0f,
+			.color = { 1.0f, 1.0f, 1.0f, 0.7f }
+		}
 	};
-	wgpuQueueWriteBuffer(queue, uniformBuffer, uniformStride, &uniforms, sizeof(MyUniforms));
+	size_t objectCount = sizeof(objects) / sizeof(objects[0]);
 	// Create a binding
 	WGPUBindGroupEntry binding = {
 		.nextInChain = NULL,
 		// The index of the binding (the entries in bindGroupDesc can be in any order)
 		.binding = 0,
 		// The buffer it is actually bound to
-		.buffer = uniformBuffer,
+		.buffer = uniformRing.buffer,
 		// We can specify an offset within the buffer, so that a single buffer can hold
 		// multiple uniform blocks.
 		.offset = 0,
@@ -290,8 +292,8 @@ int main(int argc, char *argv[]) {
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
-		uniforms.time = glfwGetTime();
-		wgpuQueueWriteBuffer(queue, uniformBuffer, offsetof(MyUniforms, time), &uniforms.time, sizeof(uniforms.time));
+		beginFrame(&frames);
+		objects[0].time = glfwGetTime();
 
 		WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView(swapChain);
 		if (!nextTexture) {
@@ -328,27 +330,32 @@ int main(int argc, char *argv[]) {
 		// we've done when creating the index buffer.
 		wgpuRenderPassEncoderSetIndexBuffer(renderPass, indexBuffer, WGPUIndexFormat_Uint16, 0, indexDataSize);
 
-		uint32_t dynamicOffset = 0;
-
-		// Set binding group
-		dynamicOffset = 0 * uniformStride;
-		wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 1, &dynamicOffset);
-		wgpuRenderPassEncoderDrawIndexed(renderPass, indexCount, 1, 0, 0, 0);
-
-		// Set binding group with a different uniform offset
-		dynamicOffset = 1 * uniformStride;
-		wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 1, &dynamicOffset);
-		wgpuRenderPassEncoderDrawIndexed(renderPass, indexCount, 1, 0, 0, 0);
+		for (size_t i = 0; i < objectCount; i++) {
+			// Set binding group with the offset of the object's uniforms
+			uint32_t dynamicOffset = pushUniforms(&uniformRing, &objects[i], sizeof(MyUniforms));
+			if (dynamicOffset == UNIFORM_RING_FULL) break;
+			wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 1, &dynamicOffset);
+			wgpuRenderPassEncoderDrawIndexed(renderPass, indexCount, 1, 0, 0, 0);
+		}
 
 		wgpuRenderPassEncoderEnd(renderPass);
 		
 		WGPUCommandBufferDescriptor cmdBufferDescriptor = {.label = "Command buffer"};
 		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+		// All the frame's uniforms in one write, ahead of the draws reading them
+		flushUniformRing(&uniformRing);
 		wgpuQueueSubmit(queue, 1, &command);
+		endFrame(&frames);
 
 		wgpuSwapChainPresent(swapChain);
 	}
 
+	releaseFramesInFlight(&frames);
+	releaseUniformRing(&uniformRing);
+
+	printShaderRegistryStats();
+	releaseShaderRegistry();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
@@ -6,7 +6,12 @@
 #include <errno.h>
 #include <float.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "helper_v2.h"
+#include "shader_registry.h"
 
 //  ------------------------------- Adapter------------------------------------------------------------------
 
@@ -120,127 +125,214 @@ void onDeviceLost(WGPUDeviceLostReason reason, char const* message, void* userda
     printf( "message: (%s)\n", message);
 };
 
+// Goes through the shader registry: a shader loaded again, by this program or
+// under another path, reuses the module created the first time.
 WGPUShaderModule loadShaderModule(const char * path, WGPUDevice device) {
-    FILE *f = fopen(path, "rt");
-    assert(f);
-    fseek(f, 0, SEEK_END);
-    long length = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char *buffer = (char *) malloc(length + 1);
-    buffer[length] = '\0';
-    fread(buffer, 1, length, f);
-    fclose(f);
-
-	WGPUShaderModuleWGSLDescriptor shaderCodeDesc = {
-		.chain = (WGPUChainedStruct){
-			.next = NULL,
-			.sType = WGPUSType_ShaderModuleWGSLDescriptor
-		},
-		.source = buffer
-	};
-	WGPUShaderModuleDescriptor shaderDesc = {
-		.nextInChain = &shaderCodeDesc.chain
-	};
-	WGPUShaderModule shadermodule = wgpuDeviceCreateShaderModule(device, &shaderDesc);
-    free(buffer);
-	return shadermodule;
+    return loadShaderVariant(device, path, NULL, NULL, NULL);
 }
 
-bool loadGeometry(const char * path, t_geometry_data * geometry_data) {
-    int pointcount = 0;
-    int indexcount = 0;
-    FILE *f = fopen(path, "rt");
-	if (!f){
-		printf("can't open file:\n %s\n", path);
-		return false;
-	}
+//  ------------------------------- Geometry------------------------------------------------------------------
 
-	enum Section {
-		None,
-		Points,
-		Indices,
-	};
-	enum Section currentSection = None;
+enum Section {
+	None,
+	Points,
+	Indices,
+};
 
-	float value;
-	uint16_t index;
-    size_t line_buf_size = 0;
-    char *line;
-
-    ssize_t line_size = getline(&line, &line_buf_size, f);
-
-	while (line_size >= 0) {
-		if (strcmp(line, "[points]\n") == 0) {
-			currentSection = Points;
-		}
-		else if (strcmp(line, "[indices]\n") == 0) {
-			currentSection = Indices;
-		}
-		else if (line[0] == '#' || line[0] == '\n') {
-		}
-		else if (currentSection == Points) {
-            char *start = line;
-            char *eon;
-            float value;
-            errno = 0;
-            
-            float * tmp;
-            // extract floating next point number after the current 'start' place in the the line
-            while ((value = strtof(start, &eon)),
-                eon != start &&
-                !((errno == EINVAL && value == 0) ||
-                    (errno == ERANGE && (value == FLT_MIN || value == FLT_MAX))))
-            {
-                tmp = realloc(geometry_data->pointData, geometry_data->pointDataSize + (sizeof(float)));
-                if (!tmp) {
-                    printf("Memory Re-allocation failed.\n");
-					return false;
-                } else {
-                    geometry_data->pointData = tmp;
-                    geometry_data->pointData[pointcount] = value;
-                    pointcount++;
-                    geometry_data->pointDataSize += (sizeof(float));
-
-                    start = eon;
-                    errno = 0;
-                }
-            }
-		}
-		else if (currentSection == Indices) {
-            char *start = line;
-            char *eon;
-            long value;
-            errno = 0;
-            
-            uint16_t * tmp;
-            // extract next long integer after the current 'start' point in the the line.
-            while ((value = strtol(start, &eon, 0)),
-                eon != start &&
-                !((errno == EINVAL && value == 0) ||
-                    (errno == ERANGE && (value == LONG_MIN || value == LONG_MAX))))
-            {
-                tmp = realloc(geometry_data->indexData, geometry_data->pointDataSize + sizeof(uint16_t));
-                if (!tmp) {
-                    printf("Memory Re-allocation failed.");
-					return false;
-                } else {
-                    geometry_data->indexData = tmp;
-                }
-                geometry_data->indexData[indexcount] = value;
-                indexcount++;
-                geometry_data->indexDataSize += (sizeof(uint16_t));
-
-                start = eon;
-                errno = 0;
-            }
-		}
-        line_size = getline(&line, &line_buf_size, f);
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static const char * skipBlanks(const char * p, const char * eol) {
+    while (p < eol && isBlank(*p)) p++;
+    return p;
+}
+
+// Returns the section a line switches to, or -1 if it is not a section header
+static int sectionHeader(const char * line, const char * eol) {
+    size_t length = eol - line;
+    if (length > 0 && line[length - 1] == '\r') length--;
+    if (length == 8 && memcmp(line, "[points]", 8) == 0) return Points;
+    if (length == 9 && memcmp(line, "[indices]", 9) == 0) return Indices;
+    return -1;
+}
+
+// Number of whitespace separated tokens in [p, eol)
+static size_t countTokens(const char * p, const char * eol) {
+    size_t count = 0;
+    bool inToken = false;
+    for (; p < eol; p++) {
+        bool blank = isBlank(*p);
+        if (!blank && !inToken) count++;
+        inToken = !blank;
+    }
+    return count;
+}
+
+// Doubles an array's capacity. Only needed when the first pass undercounted,
+// e.g. "1.0-2.0" is one token but two numbers.
+static bool growArray(void ** array, size_t * capacity, size_t elementSize) {
+    void *tmp = realloc(*array, *capacity * 2 * elementSize);
+    if (!tmp) {
+        printf("Memory Re-allocation failed.\n");
+        return false;
+    }
+    *array = tmp;
+    *capacity *= 2;
+    return true;
+}
+
+// Parses floats from [p, eol) and appends them to points. Like the old strtof
+// loop it stops at the first thing that is not a number.
+// Numbers are read in place: eol is always a '\n' or the NUL after the mapping.
+static bool parsePointLine(const char * p, const char * eol, float ** points, size_t * count, size_t * capacity) {
+    while ((p = skipBlanks(p, eol)) < eol) {
+        char *eon;
+        errno = 0;
+        float value = strtof(p, &eon);
+        if (eon == p ||
+            (errno == EINVAL && value == 0) ||
+            (errno == ERANGE && (value == FLT_MIN || value == FLT_MAX)))
+            break;
+        if (*count == *capacity && !growArray((void **)points, capacity, sizeof(float))) return false;
+        (*points)[(*count)++] = value;
+        p = eon;
+    }
+    return true;
+}
+
+// Same as parsePointLine for the integers of the [indices] section
+static bool parseIndexLine(const char * p, const char * eol, uint16_t ** indices, size_t * count, size_t * capacity) {
+    while ((p = skipBlanks(p, eol)) < eol) {
+        char *eon;
+        errno = 0;
+        long value = strtol(p, &eon, 0);
+        if (eon == p ||
+            (errno == EINVAL && value == 0) ||
+            (errno == ERANGE && (value == LONG_MIN || value == LONG_MAX)))
+            break;
+        if (*count == *capacity && !growArray((void **)indices, capacity, sizeof(uint16_t))) return false;
+        (*indices)[(*count)++] = value;
+        p = eon;
+    }
+    return true;
+}
+
+// Maps a whole file read-only, followed by at least one NUL byte so the text can
+// be handed to strtof & co without copying. Returns NULL on failure.
+// An empty file maps to an empty string.
+const char * mapFile(const char * path, size_t * size) {
+    int fd = open(path, O_RDONLY);
+	if (fd < 0){
+		printf("can't open file:\n %s\n", path);
+		return NULL;
 	}
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+		printf("can't stat file:\n %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    *size = st.st_size;
+    // Reserve one extra zeroed page, then map the file over the start of it
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    char *base = mmap(NULL, *size + pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        printf("can't map file:\n %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    if (*size > 0 && mmap(base, *size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        printf("can't map file:\n %s\n", path);
+        munmap(base, *size + pageSize);
+        close(fd);
+        return NULL;
+    }
+    madvise(base, *size, MADV_SEQUENTIAL);
+    close(fd);
+    return base;
+}
 
-    free(line);
-    fclose(f);
-	return true;
+void unmapFile(const char * data, size_t size) {
+    munmap((void *)data, size + sysconf(_SC_PAGESIZE));
 }
 
+// WebGPU buffer sizes and writes are multiples of 4 bytes. Pad the indices
+// with zeros up to that so indexData can go to wgpuQueueWriteBuffer as is.
+static bool padIndexData(t_geometry_data * geometry_data) {
+    size_t paddedSize = (geometry_data->indexDataSize + 3) & ~(size_t)3;
+    if (paddedSize == 0) paddedSize = 4;
+    char *indices = realloc(geometry_data->indexData, paddedSize);
+    if (!indices) {
+        printf("Memory Re-allocation failed.\n");
+        return false;
+    }
+    memset(indices + geometry_data->indexDataSize, 0, paddedSize - geometry_data->indexDataSize);
+    geometry_data->indexData = (uint16_t *)indices;
+    return true;
+}
 
+bool loadGeometry(const char * path, t_geometry_data * geometry_data) {
+    size_t fileSize;
+    const char *data = mapFile(path, &fileSize);
+    if (!data) return false;
+    const char *end = data + fileSize;
+
+    // First pass: count the tokens of each section so we can allocate once
+    size_t pointCount = 0;
+    size_t indexCount = 0;
+	enum Section currentSection = None;
+    for (const char *line = data; line < end;) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        int header = sectionHeader(line, eol);
+        if (header >= 0) {
+            currentSection = header;
+        }
+        else if (line[0] != '#') {
+            if (currentSection == Points) pointCount += countTokens(line, eol);
+            else if (currentSection == Indices) indexCount += countTokens(line, eol);
+        }
+        line = eol + 1;
+    }
 
+    // (never ask realloc for 0 bytes, it may free the caller's buffer)
+    size_t pointCapacity = pointCount ? pointCount : 1;
+    size_t indexCapacity = indexCount ? indexCount : 1;
+    float *points = realloc(geometry_data->pointData, pointCapacity * sizeof(float));
+    if (points) geometry_data->pointData = points;
+    uint16_t *indices = realloc(geometry_data->indexData, indexCapacity * sizeof(uint16_t));
+    if (indices) geometry_data->indexData = indices;
+    if (!points || !indices) {
+        printf("Memory Re-allocation failed.\n");
+        unmapFile(data, fileSize);
+        return false;
+    }
+
+    // Second pass: parse straight from the mapping into the final arrays
+    size_t pointsRead = 0;
+    size_t indicesRead = 0;
+    bool success = true;
+	currentSection = None;
+    for (const char *line = data; success && line < end;) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        int header = sectionHeader(line, eol);
+        if (header >= 0) {
+            currentSection = header;
+        }
+        else if (line[0] != '#') {
+            if (currentSection == Points) success = parsePointLine(line, eol, &points, &pointsRead, &pointCapacity);
+            else if (currentSection == Indices) success = parseIndexLine(line, eol, &indices, &indicesRead, &indexCapacity);
+        }
+        line = eol + 1;
+    }
+    geometry_data->pointData = points;
+    geometry_data->indexData = indices;
+    unmapFile(data, fileSize);
+    if (!success) return false;
+
+    geometry_data->pointDataSize = pointsRead * sizeof(float);
+    geometry_data->indexDataSize = indicesRead * sizeof(uint16_t);
+	return padIndexData(geometry_data);
+}
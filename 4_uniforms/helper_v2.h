@@ -63,6 +63,7 @@ static const WGPULimits DEFAULT_WGPU_LIMITS = {
 void cCallback(WGPUErrorType type, char const* message, void* userdata);
 void onDeviceLost(WGPUDeviceLostReason reason, char const* message, void* userdata);
 
+// The module belongs to the shader registry (see shader_registry.h), don't release it
 WGPUShaderModule loadShaderModule(const char * path, WGPUDevice device);
 
 typedef struct GeometryData {
@@ -74,6 +75,9 @@ typedef struct GeometryData {
 
 bool loadGeometry(const char * path, t_geometry_data * geometry_data);
 
+const char * mapFile(const char * path, size_t * size);
+void unmapFile(const char * data, size_t size);
+
 static const WGPUBindGroupLayoutEntry BIND_GROUP_DEFAULT = {
 	.binding = 0,
 	.buffer = {
@@ -7,13 +7,15 @@
 #include <stdlib.h>
 #include <glfw3webgpu.h>
 #include "helper_v2.h"
+#include "shader_registry.h"
+#include "uniform_layout.h"
+#include "uniform_block.h"
 
-typedef struct MyUniforms {
-    float color[4];
-    float time;
-	float _pad[3];
-} MyUniforms;
-static_assert(sizeof(MyUniforms) % 16 == 0, "MyUniforms is multiple of 16");
+// Declared once, laid out the way WGSL lays it out (see uniform_layout.h)
+#define MY_UNIFORMS(FIELD) \
+	FIELD(vec4f, color) \
+	FIELD(f32, time)
+UNIFORM_STRUCT(MyUniforms, MY_UNIFORMS)
 
 int main(int argc, char *argv[]) {
 	WGPUInstanceDescriptor desc = { .nextInChain = NULL};
@@ -89,6 +91,8 @@ int main(int argc, char *argv[]) {
 
 	WGPUShaderModule shaderModule = loadShaderModule(RESOURCE_DIR "/more_uniforms.wsl", device);
 	printf( "Shader module: %p\n", shaderModule);
+	// Both sides must agree on the uniforms' layout
+	if (!checkShaderUniforms(RESOURCE_DIR "/more_uniforms.wsl", NULL, 0, UNIFORM_LAYOUT(MyUniforms))) return 1;
 
 	printf( "Creating render pipeline...\n");
 
@@ -220,10 +224,10 @@ int main(int argc, char *argv[]) {
 
 	// Create index buffer
 	// (we reuse the bufferDesc initialized for the vertexBuffer)
-	// bufferDesc.size has to be indexCount × sizeof(float) or I get UnalignedBufferOffset(30) 
-	// Not sure why. I'll have to look into it
+	// bufferDesc.size has to be a multiple of 4 bytes or I get UnalignedBufferOffset(30).
+	// loadGeometry pads indexData with zeros up to that size.
 	bufferDesc = (WGPUBufferDescriptor){
-		.size = indexCount * sizeof(float),
+		.size = (indexDataSize + 3) & ~3,
 		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
 		.mappedAtCreation = false
 	};
@@ -250,7 +254,9 @@ int main(int argc, char *argv[]) {
 		.color = { 0.0f, 1.0f, 0.4f, 1.0f },
 		.time = 1.0f,
 		};
-	wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
+	// Later frames only upload the fields that changed
+	t_uniform_block uniformBlock;
+	initUniformBlock(&uniformBlock, queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
 
 	// Create a binding
 	WGPUBindGroupEntry binding = {
@@ -279,9 +285,7 @@ int main(int argc, char *argv[]) {
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 		uniforms.time = glfwGetTime();
-		// wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
-		wgpuQueueWriteBuffer(queue, uniformBuffer, offsetof(MyUniforms, time), &uniforms.time, sizeof(uniforms.time));
-		// wgpuQueueWriteBuffer(queue, uniformBuffer, offsetof(MyUniforms, color), &uniforms.color, sizeof(uniforms.color));
+		updateUniformBlock(&uniformBlock, &uniforms);
 
 		WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView(swapChain);
 		if (!nextTexture) {
@@ -328,11 +332,18 @@ int main(int argc, char *argv[]) {
 		
 		WGPUCommandBufferDescriptor cmdBufferDescriptor = {.label = "Command buffer"};
 		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+		flushUniformBlock(&uniformBlock);
 		wgpuQueueSubmit(queue, 1, &command);
 
 		wgpuSwapChainPresent(swapChain);
 	}
 
+	printUniformBlockStats(&uniformBlock);
+	releaseUniformBlock(&uniformBlock);
+
+	printShaderRegistryStats();
+	releaseShaderRegistry();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
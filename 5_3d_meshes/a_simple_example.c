@@ -7,13 +7,18 @@
 #include <stdlib.h>
 #include <glfw3webgpu.h>
 #include "helper_v3.h"
-
-typedef struct MyUniforms {
-    float color[4];
-    float time;
-	float _pad[3];
-} MyUniforms;
-static_assert(sizeof(MyUniforms) % 16 == 0, "MyUniforms is multiple of 16");
+#include "shader_registry.h"
+#include "uniform_layout.h"
+#include "uniform_block.h"
+#include "pipeline_registry.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+
+// Declared once, laid out the way WGSL lays it out (see uniform_layout.h)
+#define MY_UNIFORMS(FIELD) \
+	FIELD(vec4f, color) \
+	FIELD(f32, time)
+UNIFORM_STRUCT(MyUniforms, MY_UNIFORMS)
 
 int main(int argc, char *argv[]) {
 	WGPUInstanceDescriptor desc = { .nextInChain = NULL};
@@ -89,6 +94,8 @@ int main(int argc, char *argv[]) {
 
 	WGPUShaderModule shaderModule = loadShaderModule(RESOURCE_DIR "/shader.wsl", device);
 	printf( "Shader module: %p\n", shaderModule);
+	// Both sides must agree on the uniforms' layout
+	if (!checkShaderUniforms(RESOURCE_DIR "/shader.wsl", NULL, 0, UNIFORM_LAYOUT(MyUniforms))) return 1;
 
 	printf( "Creating render pipeline...\n");
 
@@ -159,7 +166,7 @@ int main(int argc, char *argv[]) {
 		.entryCount = 1,
 		.entries = &bindingLayout
 	};
-	WGPUBindGroupLayout bindGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &bindGroupLayoutDesc);
+	WGPUBindGroupLayout bindGroupLayout = getCachedBindGroupLayout(device, &bindGroupLayoutDesc);
 
 	WGPUPipelineLayoutDescriptor layoutDesc = {
 		.bindGroupLayoutCount = 1,
@@ -189,10 +196,10 @@ int main(int argc, char *argv[]) {
 			.mask = ~0u,
 			.alphaToCoverageEnabled = false
 		},
-		.layout = wgpuDeviceCreatePipelineLayout(device, &layoutDesc)
+		.layout = getCachedPipelineLayout(device, &layoutDesc)
 	};
 
-	WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+	WGPURenderPipeline pipeline = getCachedRenderPipeline(device, &pipelineDesc);
 	printf( "Render pipeline: %p\n", pipeline);
 
 	struct GeometryData geometrydata = {malloc(sizeof(float)), 0, malloc(sizeof(size_t)), 0};
@@ -202,10 +209,33 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
+	// Merge duplicate vertices. A file without [indices] gets an index buffer here.
+	size_t loadedCount = geometrydata.pointDataSize / vertexBufferLayout.arrayStride;
+	size_t uniqueCount;
+	if (weldVertices(&geometrydata, vertexBufferLayout.arrayStride, 0, &uniqueCount)) {
+		printf("Welded %zu vertices into %zu\n", loadedCount, uniqueCount);
+	}
+
+	// Reorder triangles and vertices for the GPU caches (same triangles, same look)
+	t_vertex_cache_stats before, after;
+	if (optimizeGeometry(&geometrydata, vertexBufferLayout.arrayStride, &before, &after)) {
+		printf("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+
+	// Levels of detail at 50%, 25% and 12.5% of the triangles, all in one index buffer
+	static const float lodRatios[] = {0.5f, 0.25f, 0.125f};
+	t_lod_chain lodChain = {.count = 1, .lods = {{0, geometrydata.indexDataSize / indexFormatSize(geometrydata.indexFormat), 0}}};
+	if (buildLodChain(&geometrydata, vertexBufferLayout.arrayStride, lodRatios, 3, &lodChain)) {
+		for (size_t i = 0; i < lodChain.count; i++) {
+			printf("LOD %zu: %u triangles, error %g\n", i, lodChain.lods[i].indexCount / 3, lodChain.lods[i].error);
+		}
+	}
+
 	float * pointData = geometrydata.pointData;
 	size_t pointDataSize = geometrydata.pointDataSize;
-	uint16_t * indexData = geometrydata.indexData;
+	void * indexData = geometrydata.indexData;
 	size_t indexDataSize = geometrydata.indexDataSize;
+	WGPUIndexFormat indexFormat = geometrydata.indexFormat;
 
 	// Create vertex buffer
 	WGPUBufferDescriptor bufferDesc = {
@@ -216,14 +246,13 @@ int main(int argc, char *argv[]) {
 	WGPUBuffer vertexBuffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
 	wgpuQueueWriteBuffer(queue, vertexBuffer, 0, pointData, bufferDesc.size);
 
-	int indexCount = indexDataSize/sizeof(indexData[0]);
 
 	// Create index buffer
 	// (we reuse the bufferDesc initialized for the vertexBuffer)
-	// bufferDesc.size has to be indexCount × sizeof(float) or I get UnalignedBufferOffset(30) 
-	// Not sure why. I'll have to look into it
+	// bufferDesc.size has to be a multiple of 4 bytes or I get UnalignedBufferOffset(30).
+	// loadGeometry pads indexData with zeros up to that size.
 	bufferDesc = (WGPUBufferDescriptor){
-		.size = indexCount * sizeof(float),
+		.size = (indexDataSize + 3) & ~3,
 		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
 		.mappedAtCreation = false
 	};
@@ -250,7 +279,9 @@ int main(int argc, char *argv[]) {
 		.color = { 0.0f, 1.0f, 0.4f, 1.0f },
 		.time = 1.0f,
 		};
-	wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
+	// Later frames only upload the fields that changed
+	t_uniform_block uniformBlock;
+	initUniformBlock(&uniformBlock, queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
 
 	// Create a binding
 	WGPUBindGroupEntry binding = {
@@ -279,9 +310,7 @@ int main(int argc, char *argv[]) {
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 		uniforms.time = glfwGetTime();
-		// wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
-		wgpuQueueWriteBuffer(queue, uniformBuffer, offsetof(MyUniforms, time), &uniforms.time, sizeof(uniforms.time));
-		// wgpuQueueWriteBuffer(queue, uniformBuffer, offsetof(MyUniforms, color), &uniforms.color, sizeof(uniforms.color));
+		updateUniformBlock(&uniformBlock, &uniforms);
 
 		WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView(swapChain);
 		if (!nextTexture) {
@@ -315,24 +344,39 @@ int main(int argc, char *argv[]) {
 		wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, vertexBuffer, 0, pointDataSize);
 
 		// The second argument must correspond to the choice of uint16_t or uint32_t
-		// we've done when creating the index buffer.
-		wgpuRenderPassEncoderSetIndexBuffer(renderPass, indexBuffer, WGPUIndexFormat_Uint16, 0, indexDataSize);
+		// loadGeometry has made for the index data.
+		wgpuRenderPassEncoderSetIndexBuffer(renderPass, indexBuffer, indexFormat, 0, indexDataSize);
 
 		// Set binding group
 		wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 0, NULL);
+		// Pick the coarsest LOD that stays within a pixel of the full mesh. The
+		// shader maps one unit to half the window height times the aspect ratio,
+		// with no perspective, so that is the same every frame here.
+		const t_geometry_lod *lod = &lodChain.lods[selectLod(&lodChain, 480 / 2 * 640.0f / 480, 1.0f)];
+
 		// Replace `draw()` with `drawIndexed()` and `vertexCount` with `indexCount`
 		// The extra argument is an offset within the index buffer.
-		wgpuRenderPassEncoderDrawIndexed(renderPass, indexCount, 1, 0, 0, 0);
+		wgpuRenderPassEncoderDrawIndexed(renderPass, lod->indexCount, 1, lod->firstIndex, 0, 0);
 
 		wgpuRenderPassEncoderEnd(renderPass);
 		
 		WGPUCommandBufferDescriptor cmdBufferDescriptor = {.label = "Command buffer"};
 		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+		flushUniformBlock(&uniformBlock);
 		wgpuQueueSubmit(queue, 1, &command);
 
 		wgpuSwapChainPresent(swapChain);
 	}
 
+	printUniformBlockStats(&uniformBlock);
+	releaseUniformBlock(&uniformBlock);
+
+	printPipelineRegistryStats();
+	releasePipelineRegistry();
+
+	printShaderRegistryStats();
+	releaseShaderRegistry();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
@@ -1,8 +1,42 @@
 #---------- HELPER V3 (mostly so I don't have to figure out why cmake 
 #    won't include the 3_input_geometry dir when I add helper_v2 to libraries)
-add_library(helper_v3 5_3d_meshes/helper_v3.c)
+add_library(helper_v3
+5_3d_meshes/helper_v3.c
+5_3d_meshes/geometry_cache.c
+5_3d_meshes/fast_parse.c
+5_3d_meshes/thread_pool.c
+5_3d_meshes/mesh_optimizer.c
+5_3d_meshes/vertex_compression.c
+5_3d_meshes/meshlets.c
+5_3d_meshes/mesh_simplifier.c
+5_3d_meshes/geometry_stream.c
+5_3d_meshes/shader_registry.c
+5_3d_meshes/hash.c
+5_3d_meshes/blob_cache.cpp
+5_3d_meshes/pipeline_manager.c
+5_3d_meshes/pipeline_registry.c
+5_3d_meshes/bind_group_cache.c
+5_3d_meshes/wgsl_preprocessor.c
+5_3d_meshes/shader_permutation.c
+5_3d_meshes/uniform_ring.c
+5_3d_meshes/frames_in_flight.c
+5_3d_meshes/uniform_block.c
+5_3d_meshes/uniform_layout.c
+5_3d_meshes/shader_reflection.cpp
+5_3d_meshes/instance_buffer.c
+5_3d_meshes/shader_watcher.c
+)
 target_include_directories(helper_v3 PUBLIC ${CMAKE_SOURCE_DIR}/5_3d_meshes)
-target_link_libraries(helper_v3 PRIVATE webgpu_dawn)
+find_package(Threads REQUIRED)
+# dawn_native and dawn_platform for the C++ platform/caching interface blob_cache plugs into,
+# libtint (from the dawn tree too) for the WGSL inspector shader_reflection uses
+target_link_libraries(helper_v3 PRIVATE webgpu_dawn dawn_native dawn_platform libtint Threads::Threads m)
+target_compile_features(helper_v3 PRIVATE cxx_std_17)
+# depth_buffer and instancing load these besides the default permutations
+embed_shaders(helper_v3 ${CMAKE_SOURCE_DIR}/5_3d_meshes/resources
+    PERMUTATIONS "depth_buffer.wsl GAMMA_CORRECTION=1" "depth_buffer.wsl GAMMA_CORRECTION=1 QUANTIZED=1"
+        "instanced.wsl INSTANCED=1"
+)
 
 #---------- A_SIMPLE_EXAMPLE
 add_executable(a_simple_example
@@ -21,3 +55,69 @@ target_compile_definitions(depth_buffer PRIVATE
     RESOURCE_DIR="${CMAKE_CURRENT_SOURCE_DIR}/5_3d_meshes/resources"
 )
 target_link_libraries(depth_buffer PRIVATE glfw webgpu_dawn glfw3webgpu helper_v3)
+
+#---------- STREAMING_GEOMETRY (draws vertices piped to stdin or a named pipe)
+add_executable(streaming_geometry
+5_3d_meshes/streaming_geometry.c
+)
+target_compile_definitions(streaming_geometry PRIVATE
+    RESOURCE_DIR="${CMAKE_CURRENT_SOURCE_DIR}/5_3d_meshes/resources"
+)
+target_link_libraries(streaming_geometry PRIVATE glfw webgpu_dawn glfw3webgpu helper_v3)
+
+#---------- INSTANCING (a grid of pyramids in one instanced draw, or one draw each with "per-draw")
+add_executable(instancing
+5_3d_meshes/instancing.c
+)
+target_compile_definitions(instancing PRIVATE
+    RESOURCE_DIR="${CMAKE_CURRENT_SOURCE_DIR}/5_3d_meshes/resources"
+)
+target_link_libraries(instancing PRIVATE glfw webgpu_dawn glfw3webgpu helper_v3)
+
+#---------- STARTUP_BENCH (cold vs warm blob cache startup on SwiftShader or Null, no window needed)
+add_executable(startup_bench
+5_3d_meshes/startup_bench.c
+)
+target_compile_definitions(startup_bench PRIVATE
+    RESOURCE_DIR="${CMAKE_CURRENT_SOURCE_DIR}/5_3d_meshes/resources"
+)
+target_link_libraries(startup_bench PRIVATE webgpu_dawn helper_v3)
+
+#---------- GEOMETRY_BENCH (loadGeometry throughput, no window needed)
+add_executable(geometry_bench
+5_3d_meshes/geometry_bench.c
+)
+target_link_libraries(geometry_bench PRIVATE webgpu_dawn helper_v3)
+
+#---------- PARSE_BENCH (strtof vs fast_parse tokenizers, no window needed)
+add_executable(parse_bench
+5_3d_meshes/parse_bench.c
+)
+target_compile_definitions(parse_bench PRIVATE
+    RESOURCE_DIR="${CMAKE_CURRENT_SOURCE_DIR}/5_3d_meshes/resources"
+)
+target_link_libraries(parse_bench PRIVATE webgpu_dawn helper_v3)
+
+#---------- COMPRESS_BENCH (quantized vertex formats: size and error, no window needed)
+add_executable(compress_bench
+5_3d_meshes/compress_bench.c
+)
+target_compile_definitions(compress_bench PRIVATE
+    RESOURCE_DIR="${CMAKE_CURRENT_SOURCE_DIR}/5_3d_meshes/resources"
+)
+target_link_libraries(compress_bench PRIVATE webgpu_dawn helper_v3)
+
+#---------- MESHLET_BENCH (meshlet build time against mesh size, no window needed)
+add_executable(meshlet_bench
+5_3d_meshes/meshlet_bench.c
+)
+target_link_libraries(meshlet_bench PRIVATE webgpu_dawn helper_v3 m)
+
+#---------- INSTANCING_BENCH (one draw per pyramid vs one instanced draw, 1 to 1M pyramids, no window needed)
+add_executable(instancing_bench
+5_3d_meshes/instancing_bench.c
+)
+target_compile_definitions(instancing_bench PRIVATE
+    RESOURCE_DIR="${CMAKE_CURRENT_SOURCE_DIR}/5_3d_meshes/resources"
+)
+target_link_libraries(instancing_bench PRIVATE webgpu_dawn helper_v3)
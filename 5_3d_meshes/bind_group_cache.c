@@ -0,0 +1,239 @@
+#include <webgpu/webgpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bind_group_cache.h"
+#include "hash.h"
+
+//  ------------------------------- Resource generations------------------------------------------------------------------
+
+static size_t resourceSlot(size_t size, const void * resource) {
+    uint64_t hash = hashBytes(&resource, sizeof(resource), 0);
+    return hash & (size - 1);
+}
+
+static uint32_t getGeneration(const t_bind_group_cache * cache, const void * resource) {
+    if (!resource || cache->resourceSize == 0) return 0;
+    size_t i = resourceSlot(cache->resourceSize, resource);
+    for (; cache->resources[i].resource; i = (i + 1) & (cache->resourceSize - 1)) {
+        if (cache->resources[i].resource == resource) return cache->resources[i].generation;
+    }
+    return 0;
+}
+
+static bool growResources(t_bind_group_cache * cache) {
+    size_t size = cache->resourceSize ? cache->resourceSize * 2 : 64;
+    t_resource_generation *resources = calloc(size, sizeof(t_resource_generation));
+    if (!resources) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    for (size_t i = 0; i < cache->resourceSize; i++) {
+        if (!cache->resources[i].resource) continue;
+        size_t slot = resourceSlot(size, cache->resources[i].resource);
+        while (resources[slot].resource) slot = (slot + 1) & (size - 1);
+        resources[slot] = cache->resources[i];
+    }
+    free(cache->resources);
+    cache->resources = resources;
+    cache->resourceSize = size;
+    return true;
+}
+
+// The generation of what the entry binds: one of the three handles is set
+static uint32_t getEntryGeneration(const t_bind_group_cache * cache, const WGPUBindGroupEntry * entry) {
+    return getGeneration(cache, entry->buffer) + getGeneration(cache, entry->sampler) + getGeneration(cache, entry->textureView);
+}
+
+//  ------------------------------- Keys------------------------------------------------------------------
+
+static int compareEntries(const void * a, const void * b) {
+    const WGPUBindGroupEntry *entryA = *(const WGPUBindGroupEntry * const *)a;
+    const WGPUBindGroupEntry *entryB = *(const WGPUBindGroupEntry * const *)b;
+    return (entryA->binding > entryB->binding) - (entryA->binding < entryB->binding);
+}
+
+// Writes the tuple of descriptor to key, its entries by binding to sorted.
+// Returns the number of words, 0 if the descriptor can't be cached.
+static size_t makeKey(const WGPUBindGroupDescriptor * descriptor, uint64_t * key, const WGPUBindGroupEntry ** sorted) {
+    if (descriptor->nextInChain || descriptor->entryCount > BIND_GROUP_CACHE_MAX_ENTRIES) return 0;
+    for (size_t i = 0; i < descriptor->entryCount; i++) {
+        // External textures are chained
+        if (descriptor->entries[i].nextInChain) return 0;
+        sorted[i] = &descriptor->entries[i];
+    }
+    qsort(sorted, descriptor->entryCount, sizeof(*sorted), compareEntries);
+    size_t length = 0;
+    key[length++] = (uintptr_t)descriptor->layout;
+    key[length++] = descriptor->entryCount;
+    for (size_t i = 0; i < descriptor->entryCount; i++) {
+        key[length++] = sorted[i]->binding;
+        key[length++] = (uintptr_t)sorted[i]->buffer;
+        key[length++] = sorted[i]->offset;
+        key[length++] = sorted[i]->size;
+        key[length++] = (uintptr_t)sorted[i]->sampler;
+        key[length++] = (uintptr_t)sorted[i]->textureView;
+    }
+    return length;
+}
+
+//  ------------------------------- Lookup------------------------------------------------------------------
+
+static bool rebuildIndex(t_bind_group_cache * cache, size_t indexSize) {
+    uint32_t *index = calloc(indexSize, sizeof(uint32_t));
+    if (!index) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    for (size_t i = 0; i < cache->count; i++) {
+        if (cache->groups[i].keyLength == 0) continue;
+        size_t slot = cache->groups[i].hash & (indexSize - 1);
+        while (index[slot]) slot = (slot + 1) & (indexSize - 1);
+        index[slot] = (uint32_t)i + 1;
+    }
+    free(cache->index);
+    cache->index = index;
+    cache->indexSize = indexSize;
+    return true;
+}
+
+static t_cached_bind_group * findGroup(t_bind_group_cache * cache, uint64_t hash, const uint64_t * key, size_t keyLength) {
+    if (cache->indexSize == 0) return NULL;
+    size_t i = hash & (cache->indexSize - 1);
+    for (; cache->index[i]; i = (i + 1) & (cache->indexSize - 1)) {
+        t_cached_bind_group *group = &cache->groups[cache->index[i] - 1];
+        if (group->hash == hash && group->keyLength == keyLength &&
+            memcmp(group->key, key, keyLength * sizeof(uint64_t)) == 0) return group;
+    }
+    return NULL;
+}
+
+// Takes ownership of bindGroup, indexing it under key when keyLength isn't 0
+static void addGroup(t_bind_group_cache * cache, uint64_t hash, const uint64_t * key, size_t keyLength,
+    const uint32_t * generations, size_t entryCount, WGPUBindGroup bindGroup) {
+    if (cache->count == cache->capacity) {
+        size_t grownCapacity = cache->capacity ? cache->capacity * 2 : 32;
+        t_cached_bind_group *tmp = realloc(cache->groups, grownCapacity * sizeof(t_cached_bind_group));
+        if (!tmp) {
+            // Not remembering it only costs a creation next time, but it leaks
+            printf("Memory Re-allocation failed.\n");
+            return;
+        }
+        cache->groups = tmp;
+        cache->capacity = grownCapacity;
+    }
+    t_cached_bind_group *group = &cache->groups[cache->count];
+    group->hash = hash;
+    group->keyLength = keyLength;
+    memcpy(group->key, key, keyLength * sizeof(uint64_t));
+    memcpy(group->generations, generations, entryCount * sizeof(uint32_t));
+    group->bindGroup = bindGroup;
+    group->lastUsed = cache->frame;
+    cache->count++;
+    if (keyLength == 0) return;
+    // Growing places every keyed group, this one included
+    if (2 * cache->count > cache->indexSize) {
+        rebuildIndex(cache, cache->indexSize ? cache->indexSize * 2 : 64);
+        return;
+    }
+    size_t slot = hash & (cache->indexSize - 1);
+    while (cache->index[slot]) slot = (slot + 1) & (cache->indexSize - 1);
+    cache->index[slot] = (uint32_t)cache->count;
+}
+
+//  ------------------------------- Public------------------------------------------------------------------
+
+void initBindGroupCache(t_bind_group_cache * cache, WGPUDevice device) {
+    *cache = (t_bind_group_cache){.device = device};
+}
+
+void releaseBindGroupCache(t_bind_group_cache * cache) {
+    for (size_t i = 0; i < cache->count; i++) wgpuBindGroupRelease(cache->groups[i].bindGroup);
+    free(cache->groups);
+    free(cache->index);
+    free(cache->resources);
+    *cache = (t_bind_group_cache){0};
+}
+
+WGPUBindGroup getCachedBindGroup(t_bind_group_cache * cache, const WGPUBindGroupDescriptor * descriptor) {
+    uint64_t key[BIND_GROUP_KEY_WORDS];
+    const WGPUBindGroupEntry *sorted[BIND_GROUP_CACHE_MAX_ENTRIES];
+    size_t keyLength = makeKey(descriptor, key, sorted);
+    uint32_t generations[BIND_GROUP_CACHE_MAX_ENTRIES];
+    uint64_t hash = 0;
+    if (keyLength == 0) {
+        cache->stats.uncached++;
+    } else {
+        for (size_t i = 0; i < descriptor->entryCount; i++) generations[i] = getEntryGeneration(cache, sorted[i]);
+        hash = hashBytes(key, keyLength * sizeof(uint64_t), 0);
+        t_cached_bind_group *group = findGroup(cache, hash, key, keyLength);
+        if (group && memcmp(group->generations, generations, descriptor->entryCount * sizeof(uint32_t)) == 0) {
+            cache->stats.hits++;
+            group->lastUsed = cache->frame;
+            return group->bindGroup;
+        }
+        if (group) {
+            // Same handles, but one of them was destroyed since: rebuild in place
+            WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(cache->device, descriptor);
+            if (!bindGroup) return NULL;
+            cache->stats.stale++;
+            wgpuBindGroupRelease(group->bindGroup);
+            group->bindGroup = bindGroup;
+            memcpy(group->generations, generations, descriptor->entryCount * sizeof(uint32_t));
+            group->lastUsed = cache->frame;
+            return bindGroup;
+        }
+        cache->stats.misses++;
+    }
+    WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(cache->device, descriptor);
+    // Uncached ones are kept unindexed until trimmed
+    if (bindGroup) addGroup(cache, hash, key, keyLength, generations, keyLength ? descriptor->entryCount : 0, bindGroup);
+    return bindGroup;
+}
+
+void invalidateBindGroupResource(t_bind_group_cache * cache, const void * resource) {
+    if (!resource) return;
+    if (2 * (cache->resourceCount + 1) > cache->resourceSize && !growResources(cache)) return;
+    size_t i = resourceSlot(cache->resourceSize, resource);
+    for (; cache->resources[i].resource; i = (i + 1) & (cache->resourceSize - 1)) {
+        if (cache->resources[i].resource == resource) {
+            cache->resources[i].generation++;
+            return;
+        }
+    }
+    cache->resources[i] = (t_resource_generation){resource, 1};
+    cache->resourceCount++;
+}
+
+size_t trimBindGroupCache(t_bind_group_cache * cache, uint64_t maxAge) {
+    size_t kept = 0;
+    for (size_t i = 0; i < cache->count; i++) {
+        t_cached_bind_group *group = &cache->groups[i];
+        if (cache->frame - group->lastUsed >= maxAge) {
+            wgpuBindGroupRelease(group->bindGroup);
+            continue;
+        }
+        if (kept != i) cache->groups[kept] = *group;
+        kept++;
+    }
+    size_t trimmed = cache->count - kept;
+    cache->count = kept;
+    cache->frame++;
+    if (trimmed == 0) return 0;
+    cache->stats.trimmed += trimmed;
+    // Groups moved: index them again
+    if (cache->indexSize && !rebuildIndex(cache, cache->indexSize)) {
+        // Without an index every lookup misses, but nothing is wrong
+        free(cache->index);
+        cache->index = NULL;
+        cache->indexSize = 0;
+    }
+    return trimmed;
+}
+
+double getBindGroupCacheHitRate(const t_bind_group_cache * cache) {
+    const t_bind_group_cache_stats *stats = &cache->stats;
+    size_t lookups = stats->hits + stats->misses + stats->stale;
+    return lookups ? (double)stats->hits / lookups : 0.0;
+}
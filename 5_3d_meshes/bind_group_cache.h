@@ -0,0 +1,85 @@
+#ifndef BIND_GROUP_CACHE_HEADER_FILE
+#define BIND_GROUP_CACHE_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//  ------------------------------- Bind group cache------------------------------------------------------------------
+// One bind group per distinct (layout, binding -> buffer/offset/size, sampler
+// or texture view) tuple, so draws can ask for their bind group every frame
+// instead of keeping it around, and only the first ask creates it. Entries
+// are sorted by binding before they are hashed, like the pipeline registry
+// does for layouts.
+//
+// A destroyed resource's handle may come back for a new one, and a resized
+// buffer is a new buffer: call invalidateBindGroupResource() when destroying
+// or replacing anything bound through the cache. That bumps the resource's
+// generation, every bind group made with the older one is rebuilt on its next
+// lookup. trimBindGroupCache(), once per frame, releases those that aren't
+// looked up anymore (and keep the old resource alive meanwhile).
+//
+// The cache owns the bind groups: don't release them. Not thread safe.
+
+#define BIND_GROUP_CACHE_MAX_ENTRIES 16
+
+typedef struct BindGroupCacheStats {
+    size_t hits;        // lookups that matched a current bind group
+    size_t misses;      // bind groups created for a new tuple
+    size_t stale;       // bind groups rebuilt after a resource was invalidated
+    size_t uncached;    // bind groups created every time: chained descriptors, too many entries
+    size_t trimmed;     // bind groups released for not being used
+} t_bind_group_cache_stats;
+
+// A tuple: the layout and the sorted entries, as 64 bit words
+#define BIND_GROUP_KEY_WORDS (2 + 6 * BIND_GROUP_CACHE_MAX_ENTRIES)
+
+typedef struct CachedBindGroup {
+    uint64_t hash;
+    uint64_t key[BIND_GROUP_KEY_WORDS];
+    size_t keyLength;                                   // words used
+    uint32_t generations[BIND_GROUP_CACHE_MAX_ENTRIES]; // of each entry's resource when created
+    WGPUBindGroup bindGroup;
+    uint64_t lastUsed;                                  // frame
+} t_cached_bind_group;
+
+typedef struct ResourceGeneration {
+    const void * resource;
+    uint32_t generation;
+} t_resource_generation;
+
+typedef struct BindGroupCache {
+    WGPUDevice device;
+    t_cached_bind_group * groups;
+    size_t count;
+    size_t capacity;
+    uint32_t * index;           // group index + 1, 0 for an empty slot
+    size_t indexSize;           // power of two, at least twice count
+    // Only invalidated resources are listed, the others are at generation 0.
+    // Entries stay once listed: a reused handle must not look current.
+    t_resource_generation * resources;
+    size_t resourceCount;
+    size_t resourceSize;        // power of two, at least twice resourceCount
+    uint64_t frame;
+    t_bind_group_cache_stats stats;
+} t_bind_group_cache;
+
+void initBindGroupCache(t_bind_group_cache * cache, WGPUDevice device);
+
+// Releases every bind group
+void releaseBindGroupCache(t_bind_group_cache * cache);
+
+WGPUBindGroup getCachedBindGroup(t_bind_group_cache * cache, const WGPUBindGroupDescriptor * descriptor);
+
+// For a buffer, sampler or texture view about to be destroyed or replaced
+void invalidateBindGroupResource(t_bind_group_cache * cache, const void * resource);
+
+// Ends a frame: releases the bind groups not looked up for maxAge frames.
+// Returns how many were released.
+size_t trimBindGroupCache(t_bind_group_cache * cache, uint64_t maxAge);
+
+// Share of lookups that found their bind group, 0 before the first one
+double getBindGroupCacheHitRate(const t_bind_group_cache * cache);
+
+#endif
@@ -0,0 +1,300 @@
+#include <dawn/native/DawnNative.h>
+#include <dawn/platform/DawnPlatform.h>
+#include <webgpu/webgpu.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include <sys/stat.h>
+#include "blob_cache.h"
+extern "C" {
+#include "hash.h"
+}
+
+#define BLOB_SUFFIX ".blob"
+
+// Dawn gets at the cache through its platform: a caching interface that
+// forwards to the C functions below, and a platform that hands it out.
+class DirectoryCachingInterface : public dawn::platform::CachingInterface {
+  public:
+    explicit DirectoryCachingInterface(t_blob_cache * cache) : mCache(cache) {}
+    size_t LoadData(const void * key, size_t keySize, void * value, size_t valueSize) override;
+    void StoreData(const void * key, size_t keySize, const void * value, size_t valueSize) override;
+
+  private:
+    t_blob_cache * mCache;
+};
+
+class CachePlatform : public dawn::platform::Platform {
+  public:
+    explicit CachePlatform(t_blob_cache * cache) : mCachingInterface(cache) {}
+    dawn::platform::CachingInterface * GetCachingInterface() override { return &mCachingInterface; }
+
+  private:
+    DirectoryCachingInterface mCachingInterface;
+};
+
+struct BlobCache {
+    char * directory;
+    uint64_t maxSize;
+    pthread_mutex_t lock;       // guards stats and tempCount
+    t_blob_cache_stats stats;
+    size_t tempCount;
+    CachePlatform * platform;
+};
+
+typedef struct BlobFile {
+    char name[32];
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint64_t size;
+} t_blob_file;
+
+static void blobPath(const t_blob_cache * cache, const void * key, size_t keySize, char * path, size_t pathSize) {
+    snprintf(path, pathSize, "%s/%016llx" BLOB_SUFFIX, cache->directory,
+        (unsigned long long)hashBytes(key, keySize, 0));
+}
+
+static bool isBlob(const char * name) {
+    size_t length = strlen(name);
+    size_t suffixLength = strlen(BLOB_SUFFIX);
+    return length > suffixLength && length < sizeof(((t_blob_file *)0)->name) &&
+        strcmp(name + length - suffixLength, BLOB_SUFFIX) == 0;
+}
+
+// Lists the blobs in the directory. Returns false when it can't be read.
+static bool listBlobs(const t_blob_cache * cache, t_blob_file ** files, size_t * count, uint64_t * totalSize) {
+    DIR *dir = opendir(cache->directory);
+    if (!dir) {
+        printf("can't open blob cache directory:\n %s\n", cache->directory);
+        return false;
+    }
+    *files = NULL;
+    *count = 0;
+    *totalSize = 0;
+    size_t capacity = 0;
+    char path[4096];
+    for (struct dirent *entry; (entry = readdir(dir));) {
+        if (!isBlob(entry->d_name)) continue;
+        struct stat blob;
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, entry->d_name);
+        if (stat(path, &blob) != 0) continue;
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            t_blob_file *tmp = (t_blob_file *)realloc(*files, capacity * sizeof(t_blob_file));
+            if (!tmp) {
+                printf("Memory Re-allocation failed.\n");
+                free(*files);
+                closedir(dir);
+                return false;
+            }
+            *files = tmp;
+        }
+        t_blob_file *file = &(*files)[(*count)++];
+        strcpy(file->name, entry->d_name);
+        file->mtimeSec = blob.st_mtim.tv_sec;
+        file->mtimeNsec = blob.st_mtim.tv_nsec;
+        file->size = blob.st_size;
+        *totalSize += blob.st_size;
+    }
+    closedir(dir);
+    return true;
+}
+
+static int compareLastUse(const void * a, const void * b) {
+    const t_blob_file *fa = (const t_blob_file *)a, *fb = (const t_blob_file *)b;
+    if (fa->mtimeSec != fb->mtimeSec) return fa->mtimeSec < fb->mtimeSec ? -1 : 1;
+    if (fa->mtimeNsec != fb->mtimeNsec) return fa->mtimeNsec < fb->mtimeNsec ? -1 : 1;
+    return 0;
+}
+
+// Deletes the least recently used blobs down to 3/4 of maxSize, so the
+// directory isn't scanned again on the very next store. Called locked.
+static void evictBlobs(t_blob_cache * cache) {
+    t_blob_file *files;
+    size_t count;
+    uint64_t totalSize;
+    if (!listBlobs(cache, &files, &count, &totalSize)) return;
+    qsort(files, count, sizeof(t_blob_file), compareLastUse);
+    char path[4096];
+    for (size_t i = 0; i < count && totalSize > cache->maxSize / 4 * 3; i++) {
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, files[i].name);
+        if (unlink(path) != 0) continue;
+        totalSize -= files[i].size;
+        cache->stats.evictions++;
+    }
+    cache->stats.size = totalSize;
+    free(files);
+}
+
+static bool readAll(int fd, void * data, size_t size) {
+    char *p = (char *)data;
+    while (size > 0) {
+        ssize_t length = read(fd, p, size);
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) return false;
+        p += length;
+        size -= length;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const void * data, size_t size) {
+    const char *p = (const char *)data;
+    while (size > 0) {
+        ssize_t length = write(fd, p, size);
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) return false;
+        p += length;
+        size -= length;
+    }
+    return true;
+}
+
+// Dawn asks for the size first (value == NULL), then for the data
+static size_t loadBlob(t_blob_cache * cache, const void * key, size_t keySize, void * value, size_t valueSize) {
+    char path[4096];
+    blobPath(cache, key, keySize, path, sizeof(path));
+    size_t blobSize = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat blob;
+        uint64_t storedKeySize;
+        char *storedKey = (char *)malloc(keySize ? keySize : 1);
+        if (storedKey && fstat(fd, &blob) == 0 &&
+            readAll(fd, &storedKeySize, sizeof(storedKeySize)) && storedKeySize == keySize &&
+            (uint64_t)blob.st_size >= sizeof(storedKeySize) + keySize &&
+            readAll(fd, storedKey, keySize) && memcmp(storedKey, key, keySize) == 0) {
+            blobSize = blob.st_size - sizeof(storedKeySize) - keySize;
+            if (value && valueSize >= blobSize) {
+                if (readAll(fd, value, blobSize)) {
+                    // Last use, for the eviction order
+                    futimens(fd, NULL);
+                } else {
+                    blobSize = 0;
+                }
+            }
+        }
+        free(storedKey);
+        close(fd);
+    }
+    if (value || blobSize == 0) {
+        pthread_mutex_lock(&cache->lock);
+        if (blobSize) cache->stats.hits++;
+        else cache->stats.misses++;
+        pthread_mutex_unlock(&cache->lock);
+    }
+    return blobSize;
+}
+
+// Written to a temporary file and renamed, so a reader never sees half a blob
+static void storeBlob(t_blob_cache * cache, const void * key, size_t keySize, const void * value, size_t valueSize) {
+    char path[4096], tempPath[4200];
+    blobPath(cache, key, keySize, path, sizeof(path));
+    pthread_mutex_lock(&cache->lock);
+    snprintf(tempPath, sizeof(tempPath), "%s.%d.%zu.tmp", path, (int)getpid(), cache->tempCount++);
+    pthread_mutex_unlock(&cache->lock);
+
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("can't write blob:\n %s\n", tempPath);
+        return;
+    }
+    uint64_t storedKeySize = keySize;
+    bool written = writeAll(fd, &storedKeySize, sizeof(storedKeySize)) &&
+        writeAll(fd, key, keySize) && writeAll(fd, value, valueSize);
+    written = close(fd) == 0 && written;
+    struct stat previous;
+    uint64_t previousSize = stat(path, &previous) == 0 ? previous.st_size : 0;
+    if (!written || rename(tempPath, path) != 0) {
+        printf("can't write blob:\n %s\n", path);
+        unlink(tempPath);
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stats.stores++;
+    // Replacing a blob only adds the difference
+    uint64_t size = cache->stats.size > previousSize ? cache->stats.size - previousSize : 0;
+    cache->stats.size = size + sizeof(storedKeySize) + keySize + valueSize;
+    if (cache->stats.size > cache->maxSize) evictBlobs(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+size_t DirectoryCachingInterface::LoadData(const void * key, size_t keySize, void * value, size_t valueSize) {
+    return loadBlob(mCache, key, keySize, value, valueSize);
+}
+
+void DirectoryCachingInterface::StoreData(const void * key, size_t keySize, const void * value, size_t valueSize) {
+    storeBlob(mCache, key, keySize, value, valueSize);
+}
+
+t_blob_cache * openBlobCache(const char * directory, uint64_t maxSize) {
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        printf("can't create blob cache directory:\n %s\n", directory);
+        return NULL;
+    }
+    t_blob_cache *cache = (t_blob_cache *)calloc(1, sizeof(t_blob_cache));
+    if (!cache || !(cache->directory = strdup(directory))) {
+        printf("Memory Allocation failed.\n");
+        free(cache);
+        return NULL;
+    }
+    cache->maxSize = maxSize;
+    pthread_mutex_init(&cache->lock, NULL);
+    t_blob_file *files;
+    size_t count;
+    if (!listBlobs(cache, &files, &count, &cache->stats.size) ||
+        !(cache->platform = new (std::nothrow) CachePlatform(cache))) {
+        closeBlobCache(cache);
+        return NULL;
+    }
+    free(files);
+    if (cache->stats.size > maxSize) evictBlobs(cache);
+    return cache;
+}
+
+void closeBlobCache(t_blob_cache * cache) {
+    if (!cache) return;
+    delete cache->platform;
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->directory);
+    free(cache);
+}
+
+bool clearBlobCache(t_blob_cache * cache) {
+    pthread_mutex_lock(&cache->lock);
+    t_blob_file *files;
+    size_t count;
+    uint64_t totalSize = cache->stats.size;
+    bool success = listBlobs(cache, &files, &count, &totalSize);
+    char path[4096];
+    for (size_t i = 0; success && i < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, files[i].name);
+        if (unlink(path) == 0) totalSize -= files[i].size;
+    }
+    if (success) free(files);
+    cache->stats.size = totalSize;
+    pthread_mutex_unlock(&cache->lock);
+    return success && totalSize == 0;
+}
+
+t_blob_cache_stats getBlobCacheStats(t_blob_cache * cache) {
+    pthread_mutex_lock(&cache->lock);
+    t_blob_cache_stats stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+    return stats;
+}
+
+WGPUInstance createCachedInstance(t_blob_cache * cache) {
+    dawn::native::DawnInstanceDescriptor dawnDesc;
+    dawnDesc.platform = cache ? cache->platform : nullptr;
+    WGPUInstanceDescriptor desc = {};
+    desc.nextInChain = reinterpret_cast<const WGPUChainedStruct *>(&dawnDesc);
+    return wgpuCreateInstance(&desc);
+}
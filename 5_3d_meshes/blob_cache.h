@@ -0,0 +1,54 @@
+#ifndef BLOB_CACHE_HEADER_FILE
+#define BLOB_CACHE_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  ------------------------------- Blob cache------------------------------------------------------------------
+// A directory backed store for Dawn's blob cache, so shader and pipeline
+// compilation results survive the process. Dawn hashes whatever it compiles
+// into a key and asks the cache for it before compiling; a warm launch then
+// skips the backend compilers.
+//
+// Each blob is one file "<hash>.blob" holding its key (to rule out hash
+// collisions) followed by the value. Reading a blob bumps its mtime, and once
+// the directory grows past maxSize the least recently used blobs are deleted.
+// Dawn may call in from its worker threads, the cache locks as needed.
+
+// Large enough for the pipelines of every program here
+#define BLOB_CACHE_DEFAULT_SIZE (64 * 1024 * 1024)
+
+typedef struct BlobCache t_blob_cache;
+
+typedef struct BlobCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t stores;
+    size_t evictions;
+    uint64_t size;      // bytes in the directory
+} t_blob_cache_stats;
+
+// Creates the directory if needed. Returns NULL when it can't be used.
+t_blob_cache * openBlobCache(const char * directory, uint64_t maxSize);
+// Only once every instance created with the cache is released
+void closeBlobCache(t_blob_cache * cache);
+
+// Deletes every blob (the next launch is a cold one)
+bool clearBlobCache(t_blob_cache * cache);
+t_blob_cache_stats getBlobCacheStats(t_blob_cache * cache);
+
+// wgpuCreateInstance with the cache plugged in as Dawn's caching interface.
+// A NULL cache gives a plain instance.
+WGPUInstance createCachedInstance(t_blob_cache * cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
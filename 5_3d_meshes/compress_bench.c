@@ -0,0 +1,76 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "helper_v3.h"
+#include "vertex_compression.h"
+
+// Compresses the vertices of a geometry file with each position encoding and
+// reports the size savings, the errors and the WGSL dequantization snippet.
+// Usage: compress_bench [file] [position components]
+// The file holds positions followed by an RGB colour, like pyramid.txt (3
+// position components, the default) or webgpu.txt (2).
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : RESOURCE_DIR "/pyramid.txt";
+    size_t positionComponents = argc > 2 ? strtoul(argv[2], NULL, 10) : 3;
+    if (positionComponents < 2 || positionComponents > 4) {
+        fprintf(stderr, "Positions have 2 to 4 components\n");
+        return 1;
+    }
+
+    struct GeometryData geometrydata = {NULL, 0, NULL, 0};
+    if (!loadGeometry(path, &geometrydata)) {
+        fprintf(stderr, "Could not load geometry!\n");
+        return 1;
+    }
+
+    static const WGPUVertexFormat floatFormats[] = {
+        WGPUVertexFormat_Undefined, WGPUVertexFormat_Float32, WGPUVertexFormat_Float32x2,
+        WGPUVertexFormat_Float32x3, WGPUVertexFormat_Float32x4
+    };
+    WGPUVertexAttribute vertexAttribs[2] = {
+        { .shaderLocation = 0, .format = floatFormats[positionComponents], .offset = 0 },
+        { .shaderLocation = 1, .format = WGPUVertexFormat_Float32x3, .offset = positionComponents * sizeof(float) }
+    };
+    WGPUVertexBufferLayout vertexBufferLayout = {
+        .attributeCount = 2,
+        .attributes = vertexAttribs,
+        .arrayStride = (positionComponents + 3) * sizeof(float),
+        .stepMode = WGPUVertexStepMode_Vertex
+    };
+    size_t vertexCount = geometrydata.pointDataSize / vertexBufferLayout.arrayStride;
+    printf("%s: %zu vertices, %zu bytes each, %zu bytes\n", path, vertexCount,
+        (size_t)vertexBufferLayout.arrayStride, vertexCount * vertexBufferLayout.arrayStride);
+
+    static const t_position_encoding encodings[] = {PositionEncoding_Snorm16, PositionEncoding_Float16};
+    static const char *names[] = {"snorm16", "float16"};
+    for (size_t i = 0; i < 2; i++) {
+        t_compressed_vertices compressed;
+        double start = now();
+        bool success = compressVertices(&geometrydata, &vertexBufferLayout, 0, 1, encodings[i], &compressed);
+        double elapsed = now() - start;
+        if (!success) continue;
+        printf("%s: %zu bytes each, %zu bytes (%.0f%% of the original) in %.3f ms\n", names[i],
+            compressed.arrayStride, compressed.vertexDataSize,
+            100.0 * compressed.vertexDataSize / (vertexCount * vertexBufferLayout.arrayStride), elapsed * 1e3);
+        printf("  position error: max %g, rms %g; colour error: max %g\n",
+            compressed.maxPositionError, compressed.rmsPositionError, compressed.maxColorError);
+        char *snippet = dequantizationSnippet(&compressed);
+        if (snippet) printf("%s", snippet);
+        free(snippet);
+        freeCompressedVertices(&compressed);
+    }
+
+    free(geometrydata.pointData);
+    free(geometrydata.indexData);
+    return 0;
+}
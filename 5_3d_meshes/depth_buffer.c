@@ -5,19 +5,53 @@
 #include <webgpu/webgpu.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <glfw3webgpu.h>
 #include "helper_v3.h"
-
-typedef struct MyUniforms {
-    float color[4];
-    float time;
-	float _pad[3];
-} MyUniforms;
-static_assert(sizeof(MyUniforms) % 16 == 0, "MyUniforms is multiple of 16");
+#include "shader_registry.h"
+#include "uniform_layout.h"
+#include "shader_reflection.h"
+#include "bind_group_cache.h"
+#include "frames_in_flight.h"
+#include "uniform_block.h"
+#include "pipeline_registry.h"
+#include "geometry_cache.h"
+#include "blob_cache.h"
+#include "pipeline_manager.h"
+#include "wgsl_preprocessor.h"
+#include "shader_watcher.h"
+#include "vertex_compression.h"
+
+// Declared once, laid out the way WGSL lays it out (see uniform_layout.h)
+#define MY_UNIFORMS(FIELD) \
+	FIELD(vec4f, color) \
+	FIELD(f32, time)
+UNIFORM_STRUCT(MyUniforms, MY_UNIFORMS)
+
+// What a shader edit needs to rebuild the pipeline
+typedef struct ShaderReload {
+	t_pipeline_manager *pipelines;
+	int pipelineHandle;
+	WGPURenderPipelineDescriptor *pipelineDesc;
+	WGPUFragmentState *fragmentState;
+} t_shader_reload_context;
+
+static void onShaderReload(WGPUShaderModule module, const char *path, void *userData) {
+	t_shader_reload_context *context = userData;
+	context->pipelineDesc->vertex.module = module;
+	context->fragmentState->module = module;
+	// The current pipeline keeps drawing until this one has compiled
+	replaceRenderPipeline(context->pipelines, context->pipelineHandle, context->pipelineDesc);
+}
 
 int main(int argc, char *argv[]) {
-	WGPUInstanceDescriptor desc = { .nextInChain = NULL};
-    WGPUInstance instance = wgpuCreateInstance(&desc);
+	// Vertices are quantized to 12 bytes (see vertex_compression.h) unless run
+	// as `depth_buffer float32`
+	bool quantized = argc < 2 || strcmp(argv[1], "float32") != 0;
+	// Compiled shaders and pipelines are kept on disk across launches.
+	// Without a cache directory we just compile everything every time.
+	t_blob_cache *blobCache = openBlobCache("blob_cache", BLOB_CACHE_DEFAULT_SIZE);
+    WGPUInstance instance = createCachedInstance(blobCache);
     if (!instance) {
         fprintf(stderr, "Could not initialize WebGPU!\n");
         return 1;
@@ -87,35 +121,55 @@ int main(int argc, char *argv[]) {
 	WGPUSwapChain swapChain = wgpuDeviceCreateSwapChain(device, surface, &swapChainDesc);
 	printf( "Swapchain: %p\n", swapChain);
 
-	WGPUShaderModule shaderModule = loadShaderModule(RESOURCE_DIR "/depth_buffer.wsl", device);
+	// Code that differs is chosen by the preprocessor, numbers are override
+	// constants set when the pipeline is built (see vertexConstants)
+	static const t_wgsl_define shaderDefines[] = {{"GAMMA_CORRECTION", "1"}, {"QUANTIZED", "1"}};
+	size_t shaderDefineCount = quantized ? 2 : 1;
+	WGPUShaderModule shaderModule = loadShaderPermutation(device, RESOURCE_DIR "/depth_buffer.wsl", shaderDefines, shaderDefineCount);
 	printf( "Shader module: %p\n", shaderModule);
+	// Both sides must agree on the uniforms' layout
+	if (!checkShaderUniforms(RESOURCE_DIR "/depth_buffer.wsl", shaderDefines, shaderDefineCount, UNIFORM_LAYOUT(MyUniforms))) return 1;
 
 	printf( "Creating render pipeline...\n");
 
-	// Vertex fetch
-	// We now have 2 attributes
-	WGPUVertexAttribute vertexAttribs[2];
-
-	// Position attribute
-	vertexAttribs[0] = (WGPUVertexAttribute){
-		.shaderLocation = 0,
-		.format = WGPUVertexFormat_Float32x3,
-		.offset = 0
-	};
-
-	// Color attribute
-	vertexAttribs[1] = (WGPUVertexAttribute){
-		.shaderLocation = 1,
-		.format = WGPUVertexFormat_Float32x3,
-		.offset = 3 * sizeof(float)
-	};
+	// Vertex fetch and bindings, as the shader declares them
+	t_shader_reflection reflection;
+	if (!reflectShader(RESOURCE_DIR "/depth_buffer.wsl", shaderDefines, shaderDefineCount, NULL, 0, &reflection)) return 1;
+	// Position and color, both at locations 0 and 1 of one buffer
+	WGPUVertexBufferLayout vertexBufferLayout = getReflectedVertexBuffer(&reflection, 0, 2, WGPUVertexStepMode_Vertex);
 
-	WGPUVertexBufferLayout vertexBufferLayout = {
-		.attributeCount = 2,
-		.attributes = vertexAttribs,
-		.arrayStride = 6 * sizeof(float),
-		.stepMode = WGPUVertexStepMode_Vertex
+	// Specializes the shader for the window when the pipeline compiles
+	WGPUConstantEntry vertexConstants[1 + DEQUANTIZATION_MAX_CONSTANTS] = {
+		{.key = "aspectRatio", .value = 640.0 / 480.0}
 	};
+	size_t vertexConstantCount = 1;
+
+	// The quantized layout and the constants that undo it depend on the mesh
+	// bounds, so that geometry loads before the pipeline is built
+	t_geometry_buffers geometryBuffers;
+	t_compressed_vertices compressed = {0};
+	if (quantized) {
+		// pyramid.txt holds a position and a color per vertex, 3 floats each
+		WGPUVertexAttribute fileAttribs[2] = {
+			{.shaderLocation = 0, .format = WGPUVertexFormat_Float32x3, .offset = 0},
+			{.shaderLocation = 1, .format = WGPUVertexFormat_Float32x3, .offset = 3 * sizeof(float)}
+		};
+		WGPUVertexBufferLayout fileLayout = {
+			.attributeCount = 2,
+			.attributes = fileAttribs,
+			.arrayStride = 6 * sizeof(float),
+			.stepMode = WGPUVertexStepMode_Vertex
+		};
+		if (!loadCompressedGeometryBuffers(device, RESOURCE_DIR "/pyramid.txt", &fileLayout, 0, 1,
+			PositionEncoding_Snorm16, &compressed, &geometryBuffers)) {
+			fprintf(stderr, "Could not load geometry!\n");
+			return 1;
+		}
+		vertexBufferLayout = compressedVertexLayout(&compressed);
+		vertexConstantCount += dequantizationConstants(&compressed, vertexConstants + 1);
+		printf("Quantized vertices: %zu bytes each instead of %zu, max position error %g, max color error %g\n",
+			(size_t)compressed.arrayStride, (size_t)fileLayout.arrayStride, compressed.maxPositionError, compressed.maxColorError);
+	}
 
 	WGPUBlendState blendState = {
 		.color = (WGPUBlendComponent){
@@ -181,36 +235,19 @@ int main(int argc, char *argv[]) {
 	WGPUTextureView depthTextureView = wgpuTextureCreateView(depthTexture, &depthTextureViewDesc);
 
 
-	// Create binding layout
-	WGPUBindGroupLayoutEntry bindingLayout = BIND_GROUP_DEFAULT;
-	// The binding index as used in the @binding attribute in the shader
-	bindingLayout.binding = 0;
-	// The stage that needs to access this resource
-	bindingLayout.visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment;
-	bindingLayout.buffer.type = WGPUBufferBindingType_Uniform;
-	bindingLayout.buffer.minBindingSize = sizeof(MyUniforms);
-
-	// Create a bind group layout
-	WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {
-		.entryCount = 1,
-		.entries = &bindingLayout
-	};
-	WGPUBindGroupLayout bindGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &bindGroupLayoutDesc);
-
-	WGPUPipelineLayoutDescriptor layoutDesc = {
-		.bindGroupLayoutCount = 1,
-		.bindGroupLayouts = &bindGroupLayout
-	};
+	// The uniform buffer's layout, visible to the stages that read it
+	WGPUBindGroupLayout bindGroupLayout = getReflectedBindGroupLayout(device, &reflection, 0);
 
 	WGPURenderPipelineDescriptor pipelineDesc = {
+		.label = "Depth buffer pipeline",
 		.vertex = (WGPUVertexState){
 			.bufferCount = 1,
 			.buffers = &vertexBufferLayout,
 
 			.module = shaderModule,
 			.entryPoint = "vs_main",
-			.constantCount = 0,
-			.constants = NULL
+			.constantCount = vertexConstantCount,
+			.constants = vertexConstants
 			},
 		.primitive = (WGPUPrimitiveState){
 			.topology = WGPUPrimitiveTopology_TriangleList,
@@ -225,54 +262,39 @@ int main(int argc, char *argv[]) {
 			.mask = ~0u,
 			.alphaToCoverageEnabled = false
 		},
-		.layout = wgpuDeviceCreatePipelineLayout(device, &layoutDesc)
+		.layout = getReflectedPipelineLayout(device, &reflection)
 	};
 
-	WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
-	printf( "Render pipeline: %p\n", pipeline);
-
-	struct GeometryData geometrydata = {malloc(sizeof(float)), 0, malloc(sizeof(size_t)), 0};
-	bool success = loadGeometry(RESOURCE_DIR "/pyramid.txt", &geometrydata);
+	// The pipeline compiles in the background while the geometry loads and the
+	// first frames go out. Until it is ready frames are only cleared.
+	t_pipeline_manager pipelines;
+	initPipelineManager(&pipelines, device);
+	int pipelineHandle = requestRenderPipeline(&pipelines, &pipelineDesc, NULL);
+
+	// Saving depth_buffer.wsl (or a file it includes) rebuilds the pipeline
+	// while the program runs. A shader that doesn't compile is reported and
+	// the running one stays.
+	t_shader_reload_context reloadContext = {&pipelines, pipelineHandle, &pipelineDesc, &fragmentState};
+	t_shader_watcher *shaderWatcher = createShaderWatcher(device);
+	if (shaderWatcher) watchShader(shaderWatcher, RESOURCE_DIR "/depth_buffer.wsl", shaderDefines, shaderDefineCount, onShaderReload, &reloadContext);
+
+	// Vertex and index data go straight into mapped GPU buffers, through the
+	// binary cache written next to pyramid.txt after the first run
+	bool success = quantized || loadGeometryBuffers(device, RESOURCE_DIR "/pyramid.txt", &vertexBufferLayout, &geometryBuffers);
 		if (!success) {
 		fprintf(stderr, "Could not load geometry!\n");
 		return 1;
 	}
 
-	float * pointData = geometrydata.pointData;
-	size_t pointDataSize = geometrydata.pointDataSize;
-	uint16_t * indexData = geometrydata.indexData;
-	size_t indexDataSize = geometrydata.indexDataSize;
-
-	// Create vertex buffer
-	WGPUBufferDescriptor bufferDesc = {
-		.size = pointDataSize,
-		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
-		.mappedAtCreation = false
-	};
-	WGPUBuffer vertexBuffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
-	wgpuQueueWriteBuffer(queue, vertexBuffer, 0, pointData, bufferDesc.size);
-
-	int indexCount = indexDataSize/sizeof(indexData[0]);
-
-	// Create index buffer
-	// (we reuse the bufferDesc initialized for the vertexBuffer)
-	// bufferDesc.size has to be indexCount × sizeof(float) or I get UnalignedBufferOffset(30) 
-	// Not sure why. I'll have to look into it
-	bufferDesc = (WGPUBufferDescriptor){
-		.size = indexCount * sizeof(float),
-		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
-		.mappedAtCreation = false
-	};
-	WGPUBuffer indexBuffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
-	wgpuQueueWriteBuffer(queue, indexBuffer, 0, indexData, bufferDesc.size);
-
-	//cleanup memory
-	free(indexData);
-	free(pointData);
+	WGPUBuffer vertexBuffer = geometryBuffers.vertexBuffer;
+	size_t pointDataSize = geometryBuffers.vertexDataSize;
+	WGPUBuffer indexBuffer = geometryBuffers.indexBuffer;
+	size_t indexDataSize = geometryBuffers.indexDataSize;
+	int indexCount = geometryBuffers.indexCount;
 
 	// Create uniform buffer
 	// The buffer will only contain 1 float with the value of uTime
-	bufferDesc = (WGPUBufferDescriptor){
+	WGPUBufferDescriptor bufferDesc = {
 		.size = sizeof(MyUniforms),
 		.nextInChain = NULL,
 		// Make sure to flag the buffer as BufferUsage::Uniform
@@ -286,7 +308,9 @@ int main(int argc, char *argv[]) {
 		.color = { 0.0f, 1.0f, 0.4f, 1.0f },
 		.time = 1.0f,
 		};
-	wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
+	// Later frames only upload the fields that changed
+	t_uniform_block uniformBlock;
+	initUniformBlock(&uniformBlock, queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
 
 	// Create a binding
 	WGPUBindGroupEntry binding = {
@@ -302,22 +326,42 @@ int main(int argc, char *argv[]) {
 		.size = sizeof(MyUniforms)
 	};
 
+	// The layout comes from the shader: it must declare this binding and no other
+	if (reflection.entryCounts[0] != 1 || !findReflectedBinding(&reflection, 0, 0)) {
+		fprintf(stderr, "depth_buffer.wsl must bind its uniforms alone, at @group(0) @binding(0)\n");
+		return 1;
+	}
+
 	// A bind group contains one or multiple bindings
 	WGPUBindGroupDescriptor bindGroupDesc = {
 		.nextInChain = NULL,
 		.layout = bindGroupLayout,
 		// There must be as many bindings as declared in the layout!
-		.entryCount = bindGroupLayoutDesc.entryCount,
+		.entryCount = 1,
 		.entries = &binding
 	};
-	WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(device, &bindGroupDesc);
-
+	// Looked up every frame, as draws whose buffers get swapped would do: only
+	// the first lookup creates it
+	t_bind_group_cache bindGroups;
+	initBindGroupCache(&bindGroups, device);
+
+	// Time to first frame and worst frame while compiling, since glfwInit()
+	bool firstFrame = true;
+	bool drawing = false;
+	double worstCompilingFrame = 0;
+	// The CPU stays at most 2 frames ahead of the GPU, what a frame uses is
+	// released once the GPU is done with it
+	t_frames_in_flight frames;
+	initFramesInFlight(&frames, device, 2);
 	while (!glfwWindowShouldClose(window)) {
+		double frameStart = glfwGetTime();
+		beginFrame(&frames);
 		glfwPollEvents();
+		if (shaderWatcher) pollShaderWatcher(shaderWatcher);
+		pollPipelineManager(&pipelines);
+		WGPURenderPipeline pipeline = getRenderPipeline(&pipelines, pipelineHandle);
 		uniforms.time = glfwGetTime();
-		// wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
-		wgpuQueueWriteBuffer(queue, uniformBuffer, offsetof(MyUniforms, time), &uniforms.time, sizeof(uniforms.time));
-		// wgpuQueueWriteBuffer(queue, uniformBuffer, offsetof(MyUniforms, color), &uniforms.color, sizeof(uniforms.color));
+		updateUniformBlock(&uniformBlock, &uniforms);
 
 		WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView(swapChain);
 		if (!nextTexture) {
@@ -366,28 +410,79 @@ int main(int argc, char *argv[]) {
 		};
 		WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
 
-		wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+		if (pipeline) {
+			wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
 
-		// Set both vertex and index buffers
-		wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, vertexBuffer, 0, pointDataSize);
+			// Set both vertex and index buffers
+			wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, vertexBuffer, 0, pointDataSize);
 
-		// The second argument must correspond to the choice of uint16_t or uint32_t
-		// we've done when creating the index buffer.
-		wgpuRenderPassEncoderSetIndexBuffer(renderPass, indexBuffer, WGPUIndexFormat_Uint16, 0, indexDataSize);
+			// The second argument must correspond to the choice of uint16_t or uint32_t
+			// loadGeometryBuffers has made for the index data.
+			wgpuRenderPassEncoderSetIndexBuffer(renderPass, indexBuffer, geometryBuffers.indexFormat, 0, indexDataSize);
 
-		// Set binding group
-		wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 0, NULL);
-		// Replace `draw()` with `drawIndexed()` and `vertexCount` with `indexCount`
-		// The extra argument is an offset within the index buffer.
-		wgpuRenderPassEncoderDrawIndexed(renderPass, indexCount, 1, 0, 0, 0);
+			// Set binding group
+			WGPUBindGroup bindGroup = getCachedBindGroup(&bindGroups, &bindGroupDesc);
+			wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 0, NULL);
+			// Replace `draw()` with `drawIndexed()` and `vertexCount` with `indexCount`
+			// The extra argument is an offset within the index buffer.
+			wgpuRenderPassEncoderDrawIndexed(renderPass, indexCount, 1, 0, 0, 0);
+		}
 
 		wgpuRenderPassEncoderEnd(renderPass);
+		wgpuRenderPassEncoderRelease(renderPass);
 		
 		WGPUCommandBufferDescriptor cmdBufferDescriptor = {.label = "Command buffer"};
 		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+		wgpuCommandEncoderRelease(encoder);
+		flushUniformBlock(&uniformBlock);
 		wgpuQueueSubmit(queue, 1, &command);
+		wgpuCommandBufferRelease(command);
+		deferTextureViewRelease(&frames, nextTexture);
+		endFrame(&frames);
+		// Bind groups unused for a second go
+		trimBindGroupCache(&bindGroups, 60);
 
 		wgpuSwapChainPresent(swapChain);
+
+		double frameEnd = glfwGetTime();
+		if (firstFrame) {
+			printf("First frame after %.1f ms\n", frameEnd * 1e3);
+			firstFrame = false;
+		}
+		if (!pipeline && frameEnd - frameStart > worstCompilingFrame) worstCompilingFrame = frameEnd - frameStart;
+		if (pipeline && !drawing) {
+			printf("Pipeline compiled in %.1f ms, drawing after %.1f ms, worst frame meanwhile %.1f ms\n",
+				pipelines.slots[pipelineHandle].compileTime * 1e3, frameEnd * 1e3, worstCompilingFrame * 1e3);
+			drawing = true;
+		}
+	}
+	printf("Frames in flight: waited on the GPU %zu times out of %llu frames, %.1f ms in total\n",
+		frames.waits, (unsigned long long)frames.nextFrame, frames.waitTime * 1e3);
+	releaseFramesInFlight(&frames);
+
+	printUniformBlockStats(&uniformBlock);
+	releaseUniformBlock(&uniformBlock);
+
+	t_bind_group_cache_stats bindGroupStats = bindGroups.stats;
+	printf("Bind group cache: %zu hits, %zu misses, %zu stale, %zu uncached, %zu trimmed (%.1f%% hit rate)\n",
+		bindGroupStats.hits, bindGroupStats.misses, bindGroupStats.stale, bindGroupStats.uncached, bindGroupStats.trimmed,
+		getBindGroupCacheHitRate(&bindGroups) * 100.0);
+	releaseBindGroupCache(&bindGroups);
+
+	destroyShaderWatcher(shaderWatcher);
+	releasePipelineManager(&pipelines);
+	// The pipeline descriptor's vertex layout pointed into it
+	freeCompressedVertices(&compressed);
+
+	printPipelineRegistryStats();
+	releasePipelineRegistry();
+
+	printShaderRegistryStats();
+	releaseShaderRegistry();
+	if (blobCache) {
+		// The cache stays open: the device may still store blobs until the process ends
+		t_blob_cache_stats blobStats = getBlobCacheStats(blobCache);
+		printf("Blob cache: %zu hits, %zu misses, %zu stores, %.1f KB\n", blobStats.hits, blobStats.misses, blobStats.stores, blobStats.size / 1024.0);
 	}
 
 	glfwDestroyWindow(window);
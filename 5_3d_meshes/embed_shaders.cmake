@@ -0,0 +1,87 @@
+#---------- SHADER VALIDATION AND EMBEDDING
+# Every .wsl is preprocessed with no defines and run through Tint (built from
+# the dawn subdirectory), so invalid WGSL fails the build instead of the
+# program. Each permutation the programs load is declared to embed_shaders()
+# and checked as well. embed_shaders() also compiles the sources into a
+# library, where loadShaderModule() finds them by their path in the resource
+# directory (see embedded_shaders.h).
+
+add_executable(wgsl_embed
+5_3d_meshes/wgsl_embed.c
+5_3d_meshes/wgsl_preprocessor.c
+5_3d_meshes/embedded_shaders.c
+)
+target_include_directories(wgsl_embed PRIVATE ${CMAKE_SOURCE_DIR}/5_3d_meshes)
+# Only for webgpu.h, wgsl_preprocessor.h declares loadShaderPermutation()
+target_link_libraries(wgsl_embed PRIVATE dawn_headers)
+
+# Preprocesses SHADER with the defines that follow it (NAME=value) and runs it
+# through Tint, the validated output goes in OUTPUT
+function(validate_permutation OUTPUT SHADER SHADERS OUTPUT_DIR)
+    get_filename_component(SHADER_NAME ${SHADER} NAME)
+    set(DEFINES ${ARGN})
+    set(PERMUTATION ${SHADER_NAME})
+    string(REPLACE ";" " " DEFINES_TEXT "${DEFINES}")
+    if(DEFINES)
+        string(REPLACE ";" "_" SUFFIX "${DEFINES}")
+        string(MAKE_C_IDENTIFIER ${SUFFIX} SUFFIX)
+        set(PERMUTATION ${SHADER_NAME}.${SUFFIX})
+    endif()
+    add_custom_command(
+        OUTPUT ${OUTPUT_DIR}/${PERMUTATION}.wgsl
+        COMMAND wgsl_embed preprocess ${SHADER} ${OUTPUT_DIR}/${PERMUTATION}.pp.wgsl ${DEFINES}
+        COMMAND tint --format wgsl -o ${OUTPUT_DIR}/${PERMUTATION}.wgsl ${OUTPUT_DIR}/${PERMUTATION}.pp.wgsl
+        # Any .wsl of the directory may be included
+        DEPENDS ${SHADERS} wgsl_embed tint
+        COMMENT "Validating ${SHADER_NAME} ${DEFINES_TEXT}"
+        VERBATIM
+    )
+    set(${OUTPUT} ${OUTPUT_DIR}/${PERMUTATION}.wgsl PARENT_SCOPE)
+endfunction()
+
+# Validates the .wsl files of DIRECTORY with no defines, and each of
+# PERMUTATIONS ("file.wsl NAME=value..."), the list of outputs goes in OUTPUTS
+function(validate_shaders OUTPUTS DIRECTORY)
+    set(PERMUTATIONS ${ARGN})
+    file(GLOB SHADERS CONFIGURE_DEPENDS ${DIRECTORY}/*.wsl)
+    file(RELATIVE_PATH NAME ${CMAKE_SOURCE_DIR} ${DIRECTORY})
+    string(REPLACE "/" "_" NAME ${NAME})
+    set(OUTPUT_DIR ${CMAKE_BINARY_DIR}/shaders/${NAME})
+    file(MAKE_DIRECTORY ${OUTPUT_DIR})
+    set(VALIDATED)
+    foreach(SHADER ${SHADERS})
+        validate_permutation(OUTPUT ${SHADER} "${SHADERS}" ${OUTPUT_DIR})
+        list(APPEND VALIDATED ${OUTPUT})
+    endforeach()
+    foreach(PERMUTATION ${PERMUTATIONS})
+        separate_arguments(PERMUTATION UNIX_COMMAND ${PERMUTATION})
+        list(GET PERMUTATION 0 SHADER_NAME)
+        list(REMOVE_AT PERMUTATION 0)
+        if(NOT EXISTS ${DIRECTORY}/${SHADER_NAME})
+            message(FATAL_ERROR "Permutation of a missing shader: ${DIRECTORY}/${SHADER_NAME}")
+        endif()
+        validate_permutation(OUTPUT ${DIRECTORY}/${SHADER_NAME} "${SHADERS}" ${OUTPUT_DIR} ${PERMUTATION})
+        list(APPEND VALIDATED ${OUTPUT})
+    endforeach()
+    set(${OUTPUTS} ${VALIDATED} PARENT_SCOPE)
+endfunction()
+
+# Validates the .wsl files of DIRECTORY and compiles them into TARGET.
+# PERMUTATIONS lists the ones the programs load besides the default, each as
+# "file.wsl NAME=value...", so Tint checks those too.
+function(embed_shaders TARGET DIRECTORY)
+    cmake_parse_arguments(EMBED "" "" "PERMUTATIONS" ${ARGN})
+    validate_shaders(VALIDATED ${DIRECTORY} ${EMBED_PERMUTATIONS})
+    file(GLOB SHADERS CONFIGURE_DEPENDS ${DIRECTORY}/*.wsl)
+    set(TABLE ${CMAKE_BINARY_DIR}/shaders/${TARGET}_shaders.c)
+    add_custom_command(
+        OUTPUT ${TABLE}
+        # Shaders are keyed by their path relative to DIRECTORY
+        COMMAND wgsl_embed table ${TABLE} ${DIRECTORY} ${SHADERS}
+        # Tint must accept them before they get in
+        DEPENDS ${SHADERS} ${VALIDATED} wgsl_embed
+        COMMENT "Embedding the shaders of ${TARGET}"
+        VERBATIM
+    )
+    target_sources(${TARGET} PRIVATE ${TABLE} ${CMAKE_SOURCE_DIR}/5_3d_meshes/embedded_shaders.c)
+endfunction()
@@ -0,0 +1,70 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "embedded_shaders.h"
+
+// The shader watcher's thread preprocesses (and looks up includes) too
+static atomic_bool embeddedOff;
+
+// The part of path after the embedded resource directory, or NULL when path
+// isn't in it
+static const char * relativeShaderPath(const char * path) {
+    size_t rootLength = strlen(embeddedShaderRoot);
+    if (rootLength == 0 || strncmp(path, embeddedShaderRoot, rootLength) != 0 || path[rootLength] != '/') return NULL;
+    const char *relative = path + rootLength + 1;
+    // "../" leaves the directory
+    return strstr(relative, "..") ? NULL : relative;
+}
+
+const t_embedded_shader * findEmbeddedShader(const char * path) {
+    if (atomic_load(&embeddedOff)) return NULL;
+    const char *relative = relativeShaderPath(path);
+    if (!relative) return NULL;
+    for (size_t i = 0; i < embeddedShaderCount; i++) {
+        if (strcmp(embeddedShaders[i].name, relative) == 0) return &embeddedShaders[i];
+    }
+    return NULL;
+}
+
+void useEmbeddedShaders(bool use) {
+    atomic_store(&embeddedOff, !use);
+}
+
+char * readShaderSource(const char * path, size_t * length) {
+    const t_embedded_shader *embedded = findEmbeddedShader(path);
+    if (embedded) {
+        char *copy = malloc(embedded->length + 1);
+        if (!copy) {
+            printf("Memory Allocation failed.\n");
+            return NULL;
+        }
+        memcpy(copy, embedded->source, embedded->length + 1);
+        *length = embedded->length;
+        return copy;
+    }
+    if (!atomic_load(&embeddedOff) && relativeShaderPath(path)) {
+        // Reading it from disk would use a shader Tint never checked
+        printf("shader isn't embedded, rebuild to add it:\n %s\n", path);
+        return NULL;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        printf("can't open shader file:\n %s\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buffer = size >= 0 ? malloc(size + 1) : NULL;
+    if (!buffer) {
+        printf("Memory Allocation failed.\n");
+        fclose(f);
+        return NULL;
+    }
+    *length = fread(buffer, 1, size, f);
+    buffer[*length] = '\0';
+    fclose(f);
+    return buffer;
+}
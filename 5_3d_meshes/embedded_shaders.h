@@ -0,0 +1,41 @@
+#ifndef EMBEDDED_SHADERS_HEADER_FILE
+#define EMBEDDED_SHADERS_HEADER_FILE
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//  ------------------------------- Embedded shaders------------------------------------------------------------------
+// The build validates every .wsl of a resource directory with Tint and
+// compiles the sources into the helper library (see embed_shaders.cmake), so
+// loading a shader reads no file. Shaders are keyed by their path relative to
+// the resource directory, each library embeds one. A path in that directory
+// that isn't embedded is an error (rebuild after adding a shader); files
+// elsewhere are read from disk as before.
+//
+// The sources are the files as written, preprocessor directives included, so
+// permutations and includes still work. Tint checked them with no defines and
+// with every permutation declared to embed_shaders().
+
+typedef struct EmbeddedShader {
+    const char * name;          // relative to embeddedShaderRoot, e.g. "shader.wsl"
+    const char * source;        // NUL terminated
+    size_t length;
+} t_embedded_shader;
+
+// Defined by the generated source of each library
+extern const t_embedded_shader embeddedShaders[];
+extern const size_t embeddedShaderCount;
+extern const char embeddedShaderRoot[];     // the resource directory, "" for none
+
+// NULL when path isn't embedded, or embedded shaders are off
+const t_embedded_shader * findEmbeddedShader(const char * path);
+
+// On by default. Off, every shader comes from disk: the shader watcher turns
+// them off so that edits (to includes too) are seen.
+void useEmbeddedShaders(bool use);
+
+// The embedded source, or else the file's. Returns a malloc'd, NUL terminated
+// copy, or NULL after printing why.
+char * readShaderSource(const char * path, size_t * length);
+
+#endif
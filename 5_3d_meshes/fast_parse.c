@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include "fast_parse.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FAST_PARSE_X86 1
+#endif
+
+//  ------------------------------- Scanning------------------------------------------------------------------
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static size_t countTokensScalar(const char * p, const char * eol) {
+    size_t count = 0;
+    bool inToken = false;
+    for (; p < eol; p++) {
+        bool blank = isBlank(*p);
+        if (!blank && !inToken) count++;
+        inToken = !blank;
+    }
+    return count;
+}
+
+static const char * findNewlineScalar(const char * p, const char * end) {
+    const char *eol = memchr(p, '\n', end - p);
+    return eol ? eol : end;
+}
+
+// Token starts in a block given its blank mask: a non blank byte whose
+// predecessor is blank. carry is 1 when the byte before the block was blank.
+static unsigned countTokenStarts(uint32_t blanks, uint32_t valid, uint32_t carry) {
+    uint32_t starts = ~blanks & ((blanks << 1) | carry) & valid;
+    return __builtin_popcount(starts);
+}
+
+#ifdef FAST_PARSE_X86
+
+static uint32_t blankMaskSSE2(__m128i chunk) {
+    __m128i blanks = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+        _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\v'))),
+            _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\f'))));
+    return (uint32_t)_mm_movemask_epi8(blanks);
+}
+
+static size_t countTokensSSE2(const char * p, const char * eol) {
+    size_t count = 0;
+    uint32_t carry = 1;
+    for (; p < eol; p += 16) {
+        size_t remaining = eol - p;
+        uint32_t valid = remaining >= 16 ? 0xFFFF : (1u << remaining) - 1;
+        uint32_t blanks = blankMaskSSE2(_mm_loadu_si128((const __m128i *)p)) | ~valid;
+        count += countTokenStarts(blanks, valid, carry);
+        carry = (blanks >> 15) & 1;
+    }
+    return count;
+}
+
+static const char * findNewlineSSE2(const char * p, const char * end) {
+    for (; p < end; p += 16) {
+        uint32_t newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), _mm_set1_epi8('\n')));
+        if (newlines) {
+            const char *eol = p + __builtin_ctz(newlines);
+            return eol < end ? eol : end;
+        }
+    }
+    return end;
+}
+
+__attribute__((target("avx2")))
+static uint32_t blankMaskAVX2(__m256i chunk) {
+    __m256i blanks = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\v'))),
+            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\f'))));
+    return (uint32_t)_mm256_movemask_epi8(blanks);
+}
+
+__attribute__((target("avx2")))
+static size_t countTokensAVX2(const char * p, const char * eol) {
+    size_t count = 0;
+    uint32_t carry = 1;
+    for (; p < eol; p += 32) {
+        size_t remaining = eol - p;
+        uint32_t valid = remaining >= 32 ? 0xFFFFFFFFu : (1u << remaining) - 1;
+        uint32_t blanks = blankMaskAVX2(_mm256_loadu_si256((const __m256i *)p)) | ~valid;
+        count += countTokenStarts(blanks, valid, carry);
+        carry = blanks >> 31;
+    }
+    return count;
+}
+
+__attribute__((target("avx2")))
+static const char * findNewlineAVX2(const char * p, const char * end) {
+    for (; p < end; p += 32) {
+        uint32_t newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), _mm256_set1_epi8('\n')));
+        if (newlines) {
+            const char *eol = p + __builtin_ctz(newlines);
+            return eol < end ? eol : end;
+        }
+    }
+    return end;
+}
+
+#endif
+
+//  ------------------------------- Numbers------------------------------------------------------------------
+
+// Same checks the original strtof loop in loadGeometry did
+static const char * strtofToken(const char * p, float * value) {
+    char *eon;
+    errno = 0;
+    *value = strtof(p, &eon);
+    if ((errno == EINVAL && *value == 0) ||
+        (errno == ERANGE && (*value == FLT_MIN || *value == FLT_MAX)))
+        return p;
+    return eon;
+}
+
+static const char * strtolToken(const char * p, long * value) {
+    char *eon;
+    errno = 0;
+    *value = strtol(p, &eon, 0);
+    if ((errno == EINVAL && *value == 0) ||
+        (errno == ERANGE && (*value == LONG_MIN || *value == LONG_MAX)))
+        return p;
+    return eon;
+}
+
+static bool isDigit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+// Every power of ten up to 1e22 is exact in a double
+static const double powersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Decimal to float in the spirit of Clinger's / Eisel-Lemire's fast paths:
+// with a mantissa below 2^53 and |exponent| <= 22 both operands are exact
+// doubles, so one multiplication or division gives the correctly rounded
+// double. Rounding that to float is only wrong when the double lands exactly
+// halfway between two floats, which we detect and leave to strtof.
+static const char * fastFloatToken(const char * p, float * value) {
+    const char *s = p;
+    bool negative = false;
+    if (*s == '-' || *s == '+') {
+        negative = *s == '-';
+        s++;
+    }
+    // Hexadecimal floats are strtof's business
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) return strtofToken(p, value);
+
+    uint64_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    const char *digitsStart = s;
+    for (; isDigit(*s); s++) {
+        if (mantissa == 0 && *s == '0') continue;
+        mantissa = mantissa * 10 + (*s - '0');
+        significantDigits++;
+    }
+    size_t integerDigits = s - digitsStart;
+    size_t fractionDigits = 0;
+    if (*s == '.') {
+        const char *fractionStart = ++s;
+        for (; isDigit(*s); s++) {
+            exponent--;
+            if (mantissa == 0 && *s == '0') continue;
+            mantissa = mantissa * 10 + (*s - '0');
+            significantDigits++;
+        }
+        fractionDigits = s - fractionStart;
+    }
+    // No digits at all: inf, nan or not a number
+    if (integerDigits + fractionDigits == 0) return strtofToken(p, value);
+    if (significantDigits > 19) return strtofToken(p, value);
+
+    if (*s == 'e' || *s == 'E') {
+        const char *e = s + 1;
+        bool negativeExponent = false;
+        if (*e == '-' || *e == '+') {
+            negativeExponent = *e == '-';
+            e++;
+        }
+        // "1e" or "1e+" end before the 'e', like strtof
+        if (isDigit(*e)) {
+            int explicitExponent = 0;
+            for (; isDigit(*e); e++) {
+                if (explicitExponent > 10000) return strtofToken(p, value);
+                explicitExponent = explicitExponent * 10 + (*e - '0');
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            s = e;
+        }
+    }
+
+    if (mantissa == 0) {
+        *value = negative ? -0.0f : 0.0f;
+        return s;
+    }
+    if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) return strtofToken(p, value);
+
+    double d = exponent < 0 ? (double)mantissa / powersOf10[-exponent] : (double)mantissa * powersOf10[exponent];
+    // Subnormal and overflowing floats need strtof's rounding and errno
+    if (d < FLT_MIN || d > FLT_MAX) return strtofToken(p, value);
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    // Double mantissa bits below the float's: exactly 1000...0 means a tie
+    if ((bits & 0x1FFFFFFFULL) == 0x10000000ULL) return strtofToken(p, value);
+
+    *value = (float)(negative ? -d : d);
+    return s;
+}
+
+static const char * fastLongToken(const char * p, long * value) {
+    const char *s = p;
+    bool negative = false;
+    if (*s == '-' || *s == '+') {
+        negative = *s == '-';
+        s++;
+    }
+    // Octal and hexadecimal (base 0 semantics) go to strtol
+    if (s[0] == '0' && (isDigit(s[1]) || s[1] == 'x' || s[1] == 'X')) return strtolToken(p, value);
+    const char *digitsStart = s;
+    long result = 0;
+    for (; isDigit(*s); s++) {
+        if (s - digitsStart >= 18) return strtolToken(p, value);
+        result = result * 10 + (*s - '0');
+    }
+    if (s == digitsStart) return strtolToken(p, value);
+    *value = negative ? -result : result;
+    return s;
+}
+
+//  ------------------------------- Dispatch------------------------------------------------------------------
+
+static t_geometry_parser currentParser = GeometryParser_Auto;
+static size_t (*countTokensImpl)(const char *, const char *) = countTokensScalar;
+static const char * (*findNewlineImpl)(const char *, const char *) = findNewlineScalar;
+static const char * (*floatTokenImpl)(const char *, float *) = strtofToken;
+static const char * (*longTokenImpl)(const char *, long *) = strtolToken;
+
+static bool parserSupported(t_geometry_parser parser) {
+    switch (parser) {
+    case GeometryParser_Strtof:
+    case GeometryParser_Scalar:
+        return true;
+#ifdef FAST_PARSE_X86
+    case GeometryParser_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case GeometryParser_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+void setGeometryParser(t_geometry_parser parser) {
+    if (parser == GeometryParser_Auto || !parserSupported(parser)) {
+        parser = parserSupported(GeometryParser_AVX2) ? GeometryParser_AVX2 :
+            parserSupported(GeometryParser_SSE2) ? GeometryParser_SSE2 : GeometryParser_Scalar;
+    }
+    currentParser = parser;
+    countTokensImpl = countTokensScalar;
+    findNewlineImpl = findNewlineScalar;
+    floatTokenImpl = parser == GeometryParser_Strtof ? strtofToken : fastFloatToken;
+    longTokenImpl = parser == GeometryParser_Strtof ? strtolToken : fastLongToken;
+#ifdef FAST_PARSE_X86
+    if (parser == GeometryParser_SSE2) {
+        countTokensImpl = countTokensSSE2;
+        findNewlineImpl = findNewlineSSE2;
+    }
+    else if (parser == GeometryParser_AVX2) {
+        countTokensImpl = countTokensAVX2;
+        findNewlineImpl = findNewlineAVX2;
+    }
+#endif
+}
+
+static void initGeometryParser() {
+    if (currentParser != GeometryParser_Auto) return;
+    t_geometry_parser parser = GeometryParser_Auto;
+    const char *name = getenv("GEOMETRY_PARSER");
+    if (name) {
+        for (int i = GeometryParser_Strtof; i <= GeometryParser_AVX2; i++) {
+            if (strcmp(name, geometryParserName(i)) == 0) parser = i;
+        }
+    }
+    setGeometryParser(parser);
+}
+
+t_geometry_parser getGeometryParser(void) {
+    initGeometryParser();
+    return currentParser;
+}
+
+const char * geometryParserName(t_geometry_parser parser) {
+    switch (parser) {
+    case GeometryParser_Strtof: return "strtof";
+    case GeometryParser_Scalar: return "scalar";
+    case GeometryParser_SSE2: return "sse2";
+    case GeometryParser_AVX2: return "avx2";
+    default: return "auto";
+    }
+}
+
+size_t countTokens(const char * p, const char * eol) {
+    initGeometryParser();
+    return countTokensImpl(p, eol);
+}
+
+const char * findNewline(const char * p, const char * end) {
+    initGeometryParser();
+    return findNewlineImpl(p, end);
+}
+
+const char * parseFloatToken(const char * p, float * value) {
+    initGeometryParser();
+    return floatTokenImpl(p, value);
+}
+
+const char * parseLongToken(const char * p, long * value) {
+    initGeometryParser();
+    return longTokenImpl(p, value);
+}
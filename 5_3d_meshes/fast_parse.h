@@ -0,0 +1,46 @@
+#ifndef FAST_PARSE_HEADER_FILE
+#define FAST_PARSE_HEADER_FILE
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//  ------------------------------- Fast text parsing------------------------------------------------------------------
+// Tokenizer and number parsers used by parseGeometry.
+//
+// Every parser returns exactly what strtof/strtol (base 0) would: same value, bit
+// for bit, and the same end pointer. The fast paths only handle plain decimal
+// numbers and hand anything else (hex, inf/nan, too many digits, values needing
+// more than one rounding...) back to libc.
+
+typedef enum GeometryParser {
+    GeometryParser_Auto,    // best one the CPU supports
+    GeometryParser_Strtof,  // libc strtof/strtol and scalar scanning, the reference
+    GeometryParser_Scalar,  // fast number parsing, scalar scanning
+    GeometryParser_SSE2,    // fast number parsing, SSE2 scanning
+    GeometryParser_AVX2,    // fast number parsing, AVX2 scanning
+} t_geometry_parser;
+
+// The SIMD scanners may read up to this many bytes past the end of a line.
+// mapFile() leaves a zeroed page after the file, which covers it.
+#define FAST_PARSE_PADDING 32
+
+// Selects the implementation used from now on. Falls back to the best
+// supported one if the CPU lacks the requested instruction set.
+// The GEOMETRY_PARSER environment variable (strtof, scalar, sse2, avx2) sets
+// the initial choice.
+void setGeometryParser(t_geometry_parser parser);
+t_geometry_parser getGeometryParser(void);
+const char * geometryParserName(t_geometry_parser parser);
+
+// Number of whitespace separated tokens in [p, eol)
+size_t countTokens(const char * p, const char * eol);
+
+// First '\n' in [p, end), or end
+const char * findNewline(const char * p, const char * end);
+
+// Parse one number at p. Return the end of the number, or p if there is none
+// (or it is out of range, like the original strtof/strtol checks).
+const char * parseFloatToken(const char * p, float * value);
+const char * parseLongToken(const char * p, long * value);
+
+#endif
@@ -0,0 +1,150 @@
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "frames_in_flight.h"
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void initFramesInFlight(t_frames_in_flight * frames, WGPUDevice device, size_t maxFrames) {
+    if (maxFrames < 1) maxFrames = 1;
+    if (maxFrames > MAX_FRAMES_IN_FLIGHT) maxFrames = MAX_FRAMES_IN_FLIGHT;
+    *frames = (t_frames_in_flight){
+        .device = device,
+        .queue = wgpuDeviceGetQueue(device),
+        .maxFrames = maxFrames
+    };
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) frames->contexts[i].slot = i;
+}
+
+static void onFrameDone(WGPUQueueWorkDoneStatus status, void * userData) {
+    t_frame_context *context = (t_frame_context *)userData;
+    // On an error the device is lost anyway, nothing uses the frame's resources
+    context->done = true;
+}
+
+static void runReleases(t_frame_context * context) {
+    for (size_t i = 0; i < context->releaseCount; i++) context->releases[i].release(context->releases[i].object);
+    context->releaseCount = 0;
+}
+
+// Retires the frames the GPU is done with, in submission order
+static void retireFrames(t_frames_in_flight * frames) {
+    while (frames->retiredFrames < frames->nextFrame) {
+        t_frame_context *context = &frames->contexts[frames->retiredFrames % frames->maxFrames];
+        // The frame being recorded isn't submitted yet
+        if (context == frames->current || (context->inFlight && !context->done)) return;
+        runReleases(context);
+        context->inFlight = false;
+        frames->retiredFrames++;
+    }
+}
+
+static void waitForFrame(t_frames_in_flight * frames, t_frame_context * context) {
+    frames->waits++;
+    double start = now();
+    while (context->inFlight) {
+        wgpuDeviceTick(frames->device);
+        retireFrames(frames);
+        if (context->inFlight) usleep(100);
+    }
+    frames->waitTime += now() - start;
+}
+
+t_frame_context * beginFrame(t_frames_in_flight * frames) {
+    if (frames->current) endFrame(frames);
+    // The slot was last used maxFrames frames ago
+    t_frame_context *context = &frames->contexts[frames->nextFrame % frames->maxFrames];
+    pollFrames(frames);
+    if (context->inFlight) waitForFrame(frames, context);
+    context->frame = frames->nextFrame++;
+    context->done = false;
+    frames->current = context;
+    return context;
+}
+
+void endFrame(t_frames_in_flight * frames) {
+    t_frame_context *context = frames->current;
+    if (!context) return;
+    // Covers everything submitted so far, this frame's work included
+    context->inFlight = true;
+    wgpuQueueOnSubmittedWorkDone(frames->queue, 0, onFrameDone, context);
+    frames->current = NULL;
+}
+
+void pollFrames(t_frames_in_flight * frames) {
+    if (frames->retiredFrames + (frames->current != NULL) < frames->nextFrame) wgpuDeviceTick(frames->device);
+    retireFrames(frames);
+}
+
+bool waitOldestFrame(t_frames_in_flight * frames) {
+    retireFrames(frames);
+    if (frames->retiredFrames == frames->nextFrame) return false;
+    t_frame_context *context = &frames->contexts[frames->retiredFrames % frames->maxFrames];
+    // It isn't submitted yet, waiting on it would never end
+    if (context == frames->current) return false;
+    waitForFrame(frames, context);
+    return true;
+}
+
+bool deferFrameRelease(t_frames_in_flight * frames, t_frame_release_callback release, void * object) {
+    t_frame_context *context = frames->current;
+    if (!context && frames->retiredFrames < frames->nextFrame) {
+        context = &frames->contexts[(frames->nextFrame - 1) % frames->maxFrames];
+    }
+    // Nothing of ours in flight: the GPU can't be using it
+    if (!context) {
+        release(object);
+        return true;
+    }
+    if (context->releaseCount == context->releaseCapacity) {
+        size_t grownCapacity = context->releaseCapacity ? context->releaseCapacity * 2 : 16;
+        t_frame_release *tmp = realloc(context->releases, grownCapacity * sizeof(t_frame_release));
+        if (!tmp) {
+            // Dawn keeps what submitted work uses alive: releasing early is safe
+            printf("Memory Re-allocation failed.\n");
+            release(object);
+            return false;
+        }
+        context->releases = tmp;
+        context->releaseCapacity = grownCapacity;
+    }
+    context->releases[context->releaseCount++] = (t_frame_release){release, object};
+    return true;
+}
+
+static void releaseBuffer(void * object) {
+    wgpuBufferRelease((WGPUBuffer)object);
+}
+
+static void releaseTextureView(void * object) {
+    wgpuTextureViewRelease((WGPUTextureView)object);
+}
+
+bool deferBufferRelease(t_frames_in_flight * frames, WGPUBuffer buffer) {
+    return deferFrameRelease(frames, releaseBuffer, buffer);
+}
+
+bool deferTextureViewRelease(t_frames_in_flight * frames, WGPUTextureView view) {
+    return deferFrameRelease(frames, releaseTextureView, view);
+}
+
+void releaseFramesInFlight(t_frames_in_flight * frames) {
+    endFrame(frames);
+    // A pending callback would write into the contexts
+    for (size_t i = 0; i < frames->maxFrames; i++) {
+        t_frame_context *context = &frames->contexts[i];
+        if (context->inFlight) waitForFrame(frames, context);
+    }
+    for (size_t i = 0; i < frames->maxFrames; i++) {
+        runReleases(&frames->contexts[i]);
+        free(frames->contexts[i].releases);
+    }
+    wgpuQueueRelease(frames->queue);
+    *frames = (t_frames_in_flight){0};
+}
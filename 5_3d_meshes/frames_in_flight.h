@@ -0,0 +1,83 @@
+#ifndef FRAMES_IN_FLIGHT_HEADER_FILE
+#define FRAMES_IN_FLIGHT_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//  ------------------------------- Frames in flight------------------------------------------------------------------
+// Keeps the CPU at most 2 or 3 frames ahead of the GPU. Each frame:
+//   beginFrame()       waits until the oldest frame's context is free again
+//                      and returns it for the new frame
+//   ...record, wgpuQueueSubmit()...
+//   endFrame()         the frame is in flight from here
+// wgpuQueueOnSubmittedWorkDone tells when a frame is done, polled with
+// wgpuDeviceTick(). Frames retire in submission order.
+//
+// Per frame resources go with the context's slot: keep one staging buffer,
+// uniform slice, etc. per slot (t_frame_context.slot indexes them), and reuse
+// them when beginFrame() hands the slot out again, the GPU is done with them
+// by then. Objects that only live for a frame, such as the swap chain's view,
+// are given to deferFrameRelease() and released when their frame retires.
+// uniform_ring.h gets its slices back that way too.
+
+#define MAX_FRAMES_IN_FLIGHT 3
+
+typedef void (*t_frame_release_callback)(void * object);
+
+typedef struct FrameRelease {
+    t_frame_release_callback release;
+    void * object;
+} t_frame_release;
+
+typedef struct FrameContext {
+    size_t slot;                // index of the context, for per slot resources
+    uint64_t frame;             // number of the frame using it, from 0
+    bool inFlight;              // submitted and not retired
+    bool done;                  // set by the work done callback
+    t_frame_release * releases; // to run when the frame retires
+    size_t releaseCount;
+    size_t releaseCapacity;
+} t_frame_context;
+
+// The callbacks point into contexts: don't move it with frames in flight
+typedef struct FramesInFlight {
+    WGPUDevice device;
+    WGPUQueue queue;
+    size_t maxFrames;           // 2 or 3, MAX_FRAMES_IN_FLIGHT at most
+    t_frame_context contexts[MAX_FRAMES_IN_FLIGHT];
+    t_frame_context * current;  // between beginFrame() and endFrame()
+    uint64_t nextFrame;
+    uint64_t retiredFrames;     // frames 0 to retiredFrames - 1 are done
+    size_t waits;               // times beginFrame() had to wait on the GPU
+    double waitTime;            // seconds spent waiting
+} t_frames_in_flight;
+
+void initFramesInFlight(t_frames_in_flight * frames, WGPUDevice device, size_t maxFrames);
+
+// Waits for every frame, then runs their releases
+void releaseFramesInFlight(t_frames_in_flight * frames);
+
+t_frame_context * beginFrame(t_frames_in_flight * frames);
+
+// Call right after the frame's last wgpuQueueSubmit()
+void endFrame(t_frames_in_flight * frames);
+
+// Retires the frames the GPU is done with, without waiting
+void pollFrames(t_frames_in_flight * frames);
+
+// Waits until the oldest frame in flight retires. Returns false when there is
+// none, the frame being recorded aside.
+bool waitOldestFrame(t_frames_in_flight * frames);
+
+// Has release(object) called once the current frame retires (between frames,
+// the last one submitted). Returns false, after releasing the object at once,
+// when out of memory.
+bool deferFrameRelease(t_frames_in_flight * frames, t_frame_release_callback release, void * object);
+
+// The usual releases, with the right casts
+bool deferBufferRelease(t_frames_in_flight * frames, WGPUBuffer buffer);
+bool deferTextureViewRelease(t_frames_in_flight * frames, WGPUTextureView view);
+
+#endif
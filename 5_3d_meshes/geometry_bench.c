@@ -0,0 +1,110 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "helper_v3.h"
+#include "geometry_cache.h"
+#include "mesh_optimizer.h"
+
+// Generates a synthetic geometry file of about targetSize bytes and reports how
+// fast parseGeometry gets through it, and how fast loadGeometry is once the
+// binary cache exists. Then runs the mesh optimizer over it.
+// Usage: geometry_bench [file] [size in MB]
+// If the file already exists it is loaded as is (it needs 6 floats per vertex
+// for the optimizer).
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool generateGeometry(const char * path, size_t targetSize) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        printf("can't create file:\n %s\n", path);
+        return false;
+    }
+    srand(42);
+    // Points take ~90% of the file, indices the rest
+    size_t written = fprintf(f, "[points]\n# x   y   z      r   g   b\n");
+    size_t vertexCount = 0;
+    while (written < targetSize * 9 / 10) {
+        written += fprintf(f, "%+.4f %+.4f %+.4f    %.3f %.3f %.3f\n",
+            rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f,
+            rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+        vertexCount++;
+    }
+    // Large files have more than 65535 vertices, so this also exercises Uint32 indices
+    written += fprintf(f, "\n[indices]\n");
+    while (written < targetSize) {
+        written += fprintf(f, "%zu %zu %zu\n",
+            rand() % vertexCount, rand() % vertexCount, rand() % vertexCount);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool benchmark(const char * name, bool (*loader)(const char *, t_geometry_data *), const char * path, double megabytes) {
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        struct GeometryData geometrydata = {NULL, 0, NULL, 0};
+        double start = now();
+        bool success = loader(path, &geometrydata);
+        double elapsed = now() - start;
+        if (!success) {
+            fprintf(stderr, "Could not load geometry!\n");
+            return false;
+        }
+        printf("%s run %d: %zu floats, %zu indices (%s) in %.3f s (%.1f MB/s)\n", name, run,
+            geometrydata.pointDataSize / sizeof(float), geometrydata.indexDataSize / indexFormatSize(geometrydata.indexFormat),
+            geometrydata.indexFormat == WGPUIndexFormat_Uint32 ? "uint32" : "uint16",
+            elapsed, megabytes / elapsed);
+        if (best == 0 || elapsed < best) best = elapsed;
+        free(geometrydata.pointData);
+        free(geometrydata.indexData);
+    }
+    printf("%s: %.1f MB in %.3f s, %.1f MB/s\n", name, megabytes, best, megabytes / best);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "geometry_bench.txt";
+    size_t sizeMB = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        printf("Generating %zu MB of geometry in %s...\n", sizeMB, path);
+        if (!generateGeometry(path, sizeMB * 1024 * 1024)) return 1;
+        stat(path, &st);
+    }
+    double megabytes = st.st_size / (1024.0 * 1024.0);
+
+    benchmark("parseGeometry", parseGeometry, path, megabytes);
+    // Make sure the binary cache exists, then time cache hits
+    struct GeometryData geometrydata = {NULL, 0, NULL, 0};
+    loadGeometry(path, &geometrydata);
+    free(geometrydata.pointData);
+    free(geometrydata.indexData);
+    benchmark("loadGeometry (cached)", loadGeometry, path, megabytes);
+
+    geometrydata = (struct GeometryData){NULL, 0, NULL, 0};
+    if (loadGeometry(path, &geometrydata)) {
+        t_vertex_cache_stats before, after;
+        double start = now();
+        bool success = optimizeGeometry(&geometrydata, 6 * sizeof(float), &before, &after);
+        double elapsed = now() - start;
+        if (success) {
+            printf("optimizeGeometry: %zu triangles in %.3f s\n", after.triangleCount, elapsed);
+            printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (cache of %d)\n",
+                before.acmr, after.acmr, before.atvr, after.atvr, MESH_OPTIMIZER_CACHE_SIZE);
+        }
+    }
+    free(geometrydata.pointData);
+    free(geometrydata.indexData);
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "geometry_cache.h"
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static char * cachePath(const char * sourcePath) {
+    size_t length = strlen(sourcePath);
+    char *path = malloc(length + sizeof(GEOMETRY_CACHE_SUFFIX));
+    if (!path) return NULL;
+    memcpy(path, sourcePath, length);
+    memcpy(path + length, GEOMETRY_CACHE_SUFFIX, sizeof(GEOMETRY_CACHE_SUFFIX));
+    return path;
+}
+
+static uint64_t headerChecksum(const t_geometry_cache_header * header, const void * vertices, const void * indices) {
+    t_geometry_cache_header copy = *header;
+    copy.checksum = 0;
+    uint64_t hash = hashBytes(&copy, sizeof(copy), 0);
+    hash = hashBytes(vertices, header->vertexSize, hash);
+    return hashBytes(indices, header->indexSize, hash);
+}
+
+static void fillLayout(t_geometry_cache_header * header, const WGPUVertexBufferLayout * layout) {
+    if (!layout || layout->attributeCount > GEOMETRY_CACHE_MAX_ATTRIBUTES) return;
+    header->arrayStride = layout->arrayStride;
+    header->attributeCount = layout->attributeCount;
+    for (size_t i = 0; i < layout->attributeCount; i++) {
+        header->attributes[i] = (t_geometry_cache_attribute){
+            .format = layout->attributes[i].format,
+            .shaderLocation = layout->attributes[i].shaderLocation,
+            .offset = layout->attributes[i].offset
+        };
+    }
+}
+
+static bool layoutMatches(const t_geometry_cache_header * header, const WGPUVertexBufferLayout * layout) {
+    if (!layout || header->attributeCount == 0) return true;
+    t_geometry_cache_header expected = {0};
+    fillLayout(&expected, layout);
+    return expected.arrayStride == header->arrayStride &&
+        expected.attributeCount == header->attributeCount &&
+        memcmp(expected.attributes, header->attributes, sizeof(expected.attributes)) == 0;
+}
+
+bool openGeometryCache(const char * sourcePath, const WGPUVertexBufferLayout * layout, t_geometry_cache * cache) {
+    struct stat source;
+    if (stat(sourcePath, &source) != 0) return false;
+    char *path = cachePath(sourcePath);
+    if (!path) return false;
+    struct stat st;
+    bool exists = stat(path, &st) == 0;
+    size_t size = 0;
+    const char *data = exists ? mapFile(path, &size) : NULL;
+    free(path);
+    if (!data) return false;
+
+    const t_geometry_cache_header *header = (const t_geometry_cache_header *)data;
+    bool valid = size >= sizeof(*header) &&
+        header->magic == GEOMETRY_CACHE_MAGIC &&
+        header->version == GEOMETRY_CACHE_VERSION &&
+        header->sourceMtimeSec == source.st_mtim.tv_sec &&
+        header->sourceMtimeNsec == source.st_mtim.tv_nsec &&
+        header->sourceSize == (uint64_t)source.st_size &&
+        header->vertexOffset <= size && header->vertexSize <= size - header->vertexOffset &&
+        header->indexOffset <= size && header->indexSize <= size - header->indexOffset &&
+        layoutMatches(header, layout) &&
+        headerChecksum(header, data + header->vertexOffset, data + header->indexOffset) == header->checksum;
+    if (!valid) {
+        unmapFile(data, size);
+        return false;
+    }
+
+    *cache = (t_geometry_cache){
+        .data = data,
+        .size = size,
+        .header = header,
+        .vertices = data + header->vertexOffset,
+        .indices = data + header->indexOffset
+    };
+    return true;
+}
+
+void closeGeometryCache(t_geometry_cache * cache) {
+    if (cache->data) unmapFile(cache->data, cache->size);
+    *cache = (t_geometry_cache){0};
+}
+
+bool writeGeometryCache(const char * sourcePath, const t_geometry_data * geometry_data, const WGPUVertexBufferLayout * layout) {
+    struct stat source;
+    if (stat(sourcePath, &source) != 0) return false;
+
+    t_geometry_cache_header header = {
+        .magic = GEOMETRY_CACHE_MAGIC,
+        .version = GEOMETRY_CACHE_VERSION,
+        .sourceMtimeSec = source.st_mtim.tv_sec,
+        .sourceMtimeNsec = source.st_mtim.tv_nsec,
+        .sourceSize = source.st_size,
+        .indexFormat = geometry_data->indexFormat,
+        .vertexSize = geometry_data->pointDataSize,
+        .indexSize = geometry_data->indexDataSize
+    };
+    fillLayout(&header, layout);
+    header.vertexOffset = alignUp(sizeof(header), 16);
+    header.indexOffset = alignUp(header.vertexOffset + header.vertexSize, 16);
+    header.checksum = headerChecksum(&header, geometry_data->pointData, geometry_data->indexData);
+
+    // Write to a temporary file and rename it so readers never see a partial cache
+    char *path = cachePath(sourcePath);
+    if (!path) return false;
+    size_t length = strlen(path);
+    char *tmpPath = malloc(length + sizeof(".tmp"));
+    if (!tmpPath) {
+        free(path);
+        return false;
+    }
+    memcpy(tmpPath, path, length);
+    memcpy(tmpPath + length, ".tmp", sizeof(".tmp"));
+
+    static const char zeros[16] = {0};
+    FILE *f = fopen(tmpPath, "wb");
+    bool success = f &&
+        fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(zeros, 1, header.vertexOffset - sizeof(header), f) == header.vertexOffset - sizeof(header) &&
+        fwrite(geometry_data->pointData, 1, header.vertexSize, f) == header.vertexSize &&
+        fwrite(zeros, 1, header.indexOffset - header.vertexOffset - header.vertexSize, f) == header.indexOffset - header.vertexOffset - header.vertexSize &&
+        fwrite(geometry_data->indexData, 1, header.indexSize, f) == header.indexSize;
+    if (f && fclose(f) != 0) success = false;
+    if (success) success = rename(tmpPath, path) == 0;
+    if (!success) {
+        printf("can't write geometry cache:\n %s\n", path);
+        remove(tmpPath);
+    }
+    free(tmpPath);
+    free(path);
+    return success;
+}
+
+WGPUBuffer createBufferWithData(WGPUDevice device, WGPUBufferUsageFlags usage, const void * data, size_t size) {
+    WGPUBufferDescriptor bufferDesc = {
+        .size = alignUp(size, 4),
+        .usage = usage,
+        .mappedAtCreation = true
+    };
+    WGPUBuffer buffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+    char *mapped = wgpuBufferGetMappedRange(buffer, 0, bufferDesc.size);
+    memcpy(mapped, data, size);
+    memset(mapped + size, 0, bufferDesc.size - size);
+    wgpuBufferUnmap(buffer);
+    return buffer;
+}
+
+bool loadGeometryBuffers(WGPUDevice device, const char * path, const WGPUVertexBufferLayout * layout, t_geometry_buffers * buffers) {
+    t_geometry_cache cache;
+    if (openGeometryCache(path, layout, &cache)) {
+        *buffers = (t_geometry_buffers){
+            .vertexBuffer = createBufferWithData(device, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex, cache.vertices, cache.header->vertexSize),
+            .vertexDataSize = cache.header->vertexSize,
+            .indexBuffer = createBufferWithData(device, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index, cache.indices, cache.header->indexSize),
+            .indexDataSize = cache.header->indexSize,
+            .indexCount = cache.header->indexSize / indexFormatSize(cache.header->indexFormat),
+            .indexFormat = cache.header->indexFormat
+        };
+        closeGeometryCache(&cache);
+        return true;
+    }
+
+    struct GeometryData geometrydata = {NULL, 0, NULL, 0};
+    if (!parseGeometry(path, &geometrydata)) {
+        free(geometrydata.pointData);
+        free(geometrydata.indexData);
+        return false;
+    }
+    writeGeometryCache(path, &geometrydata, layout);
+    *buffers = (t_geometry_buffers){
+        .vertexBuffer = createBufferWithData(device, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex, geometrydata.pointData, geometrydata.pointDataSize),
+        .vertexDataSize = geometrydata.pointDataSize,
+        .indexBuffer = createBufferWithData(device, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index, geometrydata.indexData, geometrydata.indexDataSize),
+        .indexDataSize = geometrydata.indexDataSize,
+        .indexCount = geometrydata.indexDataSize / indexFormatSize(geometrydata.indexFormat),
+        .indexFormat = geometrydata.indexFormat
+    };
+    free(geometrydata.pointData);
+    free(geometrydata.indexData);
+    return true;
+}
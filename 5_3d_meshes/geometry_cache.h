@@ -0,0 +1,86 @@
+#ifndef GEOMETRY_CACHE_HEADER_FILE
+#define GEOMETRY_CACHE_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "helper_v3.h"
+
+//  ------------------------------- Geometry cache------------------------------------------------------------------
+// Binary copy of a parsed geometry text file, written next to it as "<file>.cache".
+// It is reused as long as the text file keeps the same mtime and size.
+//
+// Layout on disk (little endian, as written by the host):
+//   t_geometry_cache_header
+//   vertex blob (at header.vertexOffset, 16 byte aligned)
+//   index blob  (at header.indexOffset, 16 byte aligned)
+
+#define GEOMETRY_CACHE_MAGIC 0x4F454757 // "WGEO"
+// 2: indices are Uint32 when they don't fit in 16 bits (1 wrapped them)
+#define GEOMETRY_CACHE_VERSION 2
+#define GEOMETRY_CACHE_MAX_ATTRIBUTES 8
+#define GEOMETRY_CACHE_SUFFIX ".cache"
+
+typedef struct GeometryCacheAttribute {
+    uint32_t format;         // WGPUVertexFormat
+    uint32_t shaderLocation;
+    uint64_t offset;
+} t_geometry_cache_attribute;
+
+typedef struct GeometryCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    // Identifies the text file the blobs were parsed from
+    int64_t sourceMtimeSec;
+    int64_t sourceMtimeNsec;
+    uint64_t sourceSize;
+    // Vertex layout descriptor (attributeCount == 0 means "not specified")
+    uint64_t arrayStride;
+    uint32_t attributeCount;
+    uint32_t indexFormat;    // WGPUIndexFormat
+    t_geometry_cache_attribute attributes[GEOMETRY_CACHE_MAX_ATTRIBUTES];
+    uint64_t vertexOffset;
+    uint64_t vertexSize;
+    uint64_t indexOffset;
+    uint64_t indexSize;
+    // hashBytes() of the header (with checksum = 0) followed by both blobs
+    uint64_t checksum;
+} t_geometry_cache_header;
+
+// A cache file mapped in memory. vertices/indices point into the mapping.
+typedef struct GeometryCache {
+    const char * data;
+    size_t size;
+    const t_geometry_cache_header * header;
+    const void * vertices;
+    const void * indices;
+} t_geometry_cache;
+
+// Maps the cache of sourcePath if it exists, is intact and still matches the text file.
+// If layout is not NULL the cached layout must match it too (or be unspecified).
+bool openGeometryCache(const char * sourcePath, const WGPUVertexBufferLayout * layout, t_geometry_cache * cache);
+void closeGeometryCache(t_geometry_cache * cache);
+
+// Writes (atomically replaces) the cache of sourcePath. layout may be NULL.
+bool writeGeometryCache(const char * sourcePath, const t_geometry_data * geometry_data, const WGPUVertexBufferLayout * layout);
+
+// Creates a buffer with mappedAtCreation and copies data straight into it.
+// The size is rounded up to the 4 bytes WebGPU requires, the padding is zeroed.
+WGPUBuffer createBufferWithData(WGPUDevice device, WGPUBufferUsageFlags usage, const void * data, size_t size);
+
+typedef struct GeometryBuffers {
+    WGPUBuffer vertexBuffer;
+    uint64_t vertexDataSize;
+    WGPUBuffer indexBuffer;
+    uint64_t indexDataSize;
+    uint32_t indexCount;
+    WGPUIndexFormat indexFormat;
+} t_geometry_buffers;
+
+// Loads a geometry text file directly into GPU buffers. On a cache hit the
+// blobs go from the mapped cache file to the mapped buffers without any
+// intermediate array; on a miss the text is parsed and the cache written.
+bool loadGeometryBuffers(WGPUDevice device, const char * path, const WGPUVertexBufferLayout * layout, t_geometry_buffers * buffers);
+
+#endif
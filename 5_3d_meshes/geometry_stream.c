@@ -0,0 +1,164 @@
+#include <webgpu/webgpu.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "geometry_stream.h"
+#include "helper_v3.h"
+#include "fast_parse.h"
+
+// Room for a partial line carried over plus one read, then the parser padding
+#define TEXT_CAPACITY (2 * GEOMETRY_STREAM_READ_SIZE + FAST_PARSE_PADDING + 1)
+
+static WGPUBuffer createStreamBuffer(WGPUDevice device, uint64_t size) {
+    WGPUBufferDescriptor bufferDesc = {
+        .size = size,
+        // CopySrc so the content can move to a larger buffer
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc | WGPUBufferUsage_Vertex,
+        .mappedAtCreation = false
+    };
+    return wgpuDeviceCreateBuffer(device, &bufferDesc);
+}
+
+bool openGeometryStream(t_geometry_stream * stream, WGPUDevice device, const char * path, size_t vertexStride, size_t initialSize) {
+    *stream = (t_geometry_stream){.fd = -1};
+    if (vertexStride == 0 || vertexStride % sizeof(float) != 0) {
+        printf("Stream vertices must be made of floats.\n");
+        return false;
+    }
+    // A named pipe opened without O_NONBLOCK would wait for a writer
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        printf("can't open stream:\n %s\n", path);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    uint64_t size = (initialSize + 3) & ~(uint64_t)3;
+    *stream = (t_geometry_stream){
+        .fd = fd,
+        .device = device,
+        .queue = wgpuDeviceGetQueue(device),
+        .buffer = createStreamBuffer(device, size ? size : 4),
+        .bufferSize = size ? size : 4,
+        .vertexStride = vertexStride,
+        .text = malloc(TEXT_CAPACITY),
+        .section = GEOMETRY_SECTION_POINTS,
+        .valueCapacity = GEOMETRY_STREAM_READ_SIZE / 2,
+        .values = malloc(GEOMETRY_STREAM_READ_SIZE / 2 * sizeof(float))
+    };
+    if (!stream->text || !stream->values) {
+        printf("Memory Allocation failed.\n");
+        closeGeometryStream(stream);
+        return false;
+    }
+    return true;
+}
+
+// Replaces the buffer with one at least size bytes large, copying the
+// vertices already there on the GPU
+static void growBuffer(t_geometry_stream * stream, uint64_t size) {
+    uint64_t grownSize = stream->bufferSize;
+    while (grownSize < size) grownSize *= 2;
+    WGPUBuffer grown = createStreamBuffer(stream->device, grownSize);
+
+    WGPUCommandEncoderDescriptor encoderDesc = {.label = "Stream growth"};
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(stream->device, &encoderDesc);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, stream->buffer, 0, grown, 0, stream->dataSize);
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {.label = "Stream growth"};
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+    wgpuQueueSubmit(stream->queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    wgpuCommandEncoderRelease(encoder);
+
+    wgpuBufferDestroy(stream->buffer);
+    wgpuBufferRelease(stream->buffer);
+    stream->buffer = grown;
+    stream->bufferSize = grownSize;
+}
+
+// Uploads the whole vertices parsed so far and keeps the rest for later
+static void uploadVertices(t_geometry_stream * stream) {
+    size_t floatsPerVertex = stream->vertexStride / sizeof(float);
+    size_t vertices = stream->valueCount / floatsPerVertex;
+    if (vertices == 0) return;
+    uint64_t size = vertices * stream->vertexStride;
+    if (stream->dataSize + size > stream->bufferSize) growBuffer(stream, stream->dataSize + size);
+    // Queue writes run after the copy submitted before them
+    wgpuQueueWriteBuffer(stream->queue, stream->buffer, stream->dataSize, stream->values, size);
+    stream->dataSize += size;
+    stream->vertexCount += vertices;
+    stream->valueCount -= vertices * floatsPerVertex;
+    memmove(stream->values, stream->values + vertices * floatsPerVertex, stream->valueCount * sizeof(float));
+}
+
+static bool parseLine(t_geometry_stream * stream, const char * line, const char * eol) {
+    int header = geometrySectionHeader(line, eol);
+    if (header >= 0) {
+        stream->section = header;
+        return true;
+    }
+    if (stream->section != GEOMETRY_SECTION_POINTS) return true;
+    return parseGeometryPointLine(line, eol, &stream->values, &stream->valueCount, &stream->valueCapacity);
+}
+
+// Parses the complete lines of the read buffer (all of it at the end of the
+// stream) and moves what is left of the last line to the start
+static bool parseText(t_geometry_stream * stream) {
+    char *text = stream->text;
+    const char *end = text + stream->textSize;
+    memset(text + stream->textSize, 0, FAST_PARSE_PADDING + 1);
+    const char *line = text;
+    for (const char *eol; (eol = memchr(line, '\n', end - line)); line = eol + 1) {
+        if (!parseLine(stream, line, eol)) return false;
+    }
+    if (stream->ended && line < end) {
+        if (!parseLine(stream, line, end)) return false;
+        line = end;
+    }
+    size_t rest = end - line;
+    if (rest > GEOMETRY_STREAM_READ_SIZE) {
+        printf("Stream line longer than %d bytes, skipped.\n", GEOMETRY_STREAM_READ_SIZE);
+        // Keep skipping up to the next newline
+        text[0] = '#';
+        rest = 1;
+    } else {
+        memmove(text, line, rest);
+    }
+    stream->textSize = rest;
+    return true;
+}
+
+bool pollGeometryStream(t_geometry_stream * stream, size_t maxBytes) {
+    size_t total = 0;
+    do {
+        ssize_t length = read(stream->fd, stream->text + stream->textSize, GEOMETRY_STREAM_READ_SIZE);
+        if (length < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            printf("can't read stream:\n %s\n", strerror(errno));
+            return false;
+        }
+        // No writer (any more). A named pipe may get a new one later.
+        stream->ended = length == 0;
+        stream->textSize += length;
+        total += length;
+        if (!parseText(stream)) return false;
+        uploadVertices(stream);
+        if (stream->ended) break;
+    } while (total < maxBytes);
+    return true;
+}
+
+void closeGeometryStream(t_geometry_stream * stream) {
+    if (stream->fd > STDIN_FILENO) close(stream->fd);
+    if (stream->buffer) {
+        wgpuBufferDestroy(stream->buffer);
+        wgpuBufferRelease(stream->buffer);
+    }
+    free(stream->text);
+    free(stream->values);
+    *stream = (t_geometry_stream){.fd = -1};
+}
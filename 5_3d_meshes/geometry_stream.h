@@ -0,0 +1,52 @@
+#ifndef GEOMETRY_STREAM_HEADER_FILE
+#define GEOMETRY_STREAM_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//  ------------------------------- Geometry stream------------------------------------------------------------------
+// Geometry text that keeps arriving on stdin or a named pipe, e.g. point and
+// colour records from a capture process. Each poll reads what is available, up
+// to a byte budget, parses the complete lines and appends the whole vertices
+// to a GPU vertex buffer with wgpuQueueWriteBuffer. The buffer grows
+// geometrically; on growth the old content is copied over on the GPU, so
+// nothing is ever uploaded twice.
+//
+// The text uses the same format as loadGeometry. The [points] header is
+// optional, [indices] sections are skipped.
+
+// Largest read per poll. Also bounds the memory used for parsing.
+#define GEOMETRY_STREAM_READ_SIZE (64 * 1024)
+
+typedef struct GeometryStream {
+    int fd;
+    bool ended;                 // the writer closed its end
+    WGPUDevice device;
+    WGPUQueue queue;
+    // Vertex buffer: bind it again every frame, growing replaces it
+    WGPUBuffer buffer;
+    uint64_t bufferSize;
+    uint64_t dataSize;
+    size_t vertexStride;
+    uint32_t vertexCount;
+    // Parsing state
+    char * text;                // read buffer, the end of a partial line is kept at the start
+    size_t textSize;
+    int section;
+    float * values;             // parsed floats not uploaded yet (less than one vertex between polls)
+    size_t valueCount;
+    size_t valueCapacity;
+} t_geometry_stream;
+
+// path "-" is stdin. initialSize is the first buffer size in bytes.
+bool openGeometryStream(t_geometry_stream * stream, WGPUDevice device, const char * path, size_t vertexStride, size_t initialSize);
+
+// Reads up to maxBytes (at least one read), without blocking, and uploads the
+// new vertices. Returns false on a read or allocation error.
+bool pollGeometryStream(t_geometry_stream * stream, size_t maxBytes);
+
+void closeGeometryStream(t_geometry_stream * stream);
+
+#endif
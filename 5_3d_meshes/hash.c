@@ -0,0 +1,31 @@
+#include <stdint.h>
+#include <string.h>
+#include "hash.h"
+
+//  ------------------------------- Hashing------------------------------------------------------------------
+
+static uint64_t rotateLeft(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+uint64_t hashBytes(const void * data, size_t size, uint64_t seed) {
+    // Word at a time multiply/rotate hash in the spirit of xxHash64
+    const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    const unsigned char *p = data;
+    uint64_t hash = seed + prime2 + size;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash ^= rotateLeft(word * prime2, 31) * prime1;
+        hash = rotateLeft(hash, 27) * prime1 + prime2;
+    }
+    for (; size > 0; p++, size--) {
+        hash ^= *p * prime1;
+        hash = rotateLeft(hash, 11) * prime2;
+    }
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    return hash;
+}
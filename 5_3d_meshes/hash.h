@@ -0,0 +1,10 @@
+#ifndef HASH_HEADER_FILE
+#define HASH_HEADER_FILE
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64 bit hash of a byte range. Chain calls by passing the previous hash as seed.
+uint64_t hashBytes(const void * data, size_t size, uint64_t seed);
+
+#endif
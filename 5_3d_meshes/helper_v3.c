@@ -6,7 +6,15 @@
 #include <errno.h>
 #include <float.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "helper_v3.h"
+#include "shader_registry.h"
+#include "geometry_cache.h"
+#include "fast_parse.h"
+#include "thread_pool.h"
 
 //  ------------------------------- Adapter------------------------------------------------------------------
 
@@ -120,127 +128,478 @@ void onDeviceLost(WGPUDeviceLostReason reason, char const* message, void* userda
     printf( "message: (%s)\n", message);
 };
 
+// Goes through the shader registry: a shader loaded again, by this program or
+// under another path, reuses the module created the first time.
 WGPUShaderModule loadShaderModule(const char * path, WGPUDevice device) {
-    FILE *f = fopen(path, "rt");
-    assert(f);
-    fseek(f, 0, SEEK_END);
-    long length = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char *buffer = (char *) malloc(length + 1);
-    buffer[length] = '\0';
-    fread(buffer, 1, length, f);
-    fclose(f);
-
-	WGPUShaderModuleWGSLDescriptor shaderCodeDesc = {
-		.chain = (WGPUChainedStruct){
-			.next = NULL,
-			.sType = WGPUSType_ShaderModuleWGSLDescriptor
-		},
-		.source = buffer
-	};
-	WGPUShaderModuleDescriptor shaderDesc = {
-		.nextInChain = &shaderCodeDesc.chain
-	};
-	WGPUShaderModule shadermodule = wgpuDeviceCreateShaderModule(device, &shaderDesc);
-    free(buffer);
-	return shadermodule;
+    return loadShaderVariant(device, path, NULL, NULL, NULL);
 }
 
-bool loadGeometry(const char * path, t_geometry_data * geometry_data) {
-    int pointcount = 0;
-    int indexcount = 0;
-    FILE *f = fopen(path, "rt");
-	if (!f){
+//  ------------------------------- Geometry------------------------------------------------------------------
+
+enum Section {
+	None,
+	Points,
+	Indices,
+};
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static const char * skipBlanks(const char * p, const char * eol) {
+    while (p < eol && isBlank(*p)) p++;
+    return p;
+}
+
+// Returns the section a line switches to, or -1 if it is not a section header
+static int sectionHeader(const char * line, const char * eol) {
+    size_t length = eol - line;
+    if (length > 0 && line[length - 1] == '\r') length--;
+    if (length == 8 && memcmp(line, "[points]", 8) == 0) return Points;
+    if (length == 9 && memcmp(line, "[indices]", 9) == 0) return Indices;
+    return -1;
+}
+
+// Doubles an array's capacity. Only needed when the first pass undercounted,
+// e.g. "1.0-2.0" is one token but two numbers.
+static bool growArray(void ** array, size_t * capacity, size_t elementSize) {
+    void *tmp = realloc(*array, *capacity * 2 * elementSize);
+    if (!tmp) {
+        printf("Memory Re-allocation failed.\n");
+        return false;
+    }
+    *array = tmp;
+    *capacity *= 2;
+    return true;
+}
+
+// Parses floats from [p, eol) and appends them to points. Like the old strtof
+// loop it stops at the first thing that is not a number (see fast_parse.h).
+// Numbers are read in place: eol is always a '\n' or the NUL after the mapping.
+// Returns false when points is full and may not grow, or growing failed.
+static bool parsePointLine(const char * p, const char * eol, float ** points, size_t * count, size_t * capacity, bool canGrow) {
+    while ((p = skipBlanks(p, eol)) < eol) {
+        float value;
+        const char *eon = parseFloatToken(p, &value);
+        if (eon == p) break;
+        if (*count == *capacity && (!canGrow || !growArray((void **)points, capacity, sizeof(float)))) return false;
+        (*points)[(*count)++] = value;
+        p = eon;
+    }
+    return true;
+}
+
+// Same as parsePointLine for the integers of the [indices] section.
+// Indices are read as 32 bits and the largest one goes to maxIndex, so the
+// caller can tell whether they fit in 16 bits.
+static bool parseIndexLine(const char * p, const char * eol, uint32_t ** indices, size_t * count, size_t * capacity, bool canGrow, uint32_t * maxIndex) {
+    while ((p = skipBlanks(p, eol)) < eol) {
+        long value;
+        const char *eon = parseLongToken(p, &value);
+        if (eon == p) break;
+        if (*count == *capacity && (!canGrow || !growArray((void **)indices, capacity, sizeof(uint32_t)))) return false;
+        uint32_t index = value;
+        if (index > *maxIndex) *maxIndex = index;
+        (*indices)[(*count)++] = index;
+        p = eon;
+    }
+    return true;
+}
+
+int geometrySectionHeader(const char * line, const char * eol) {
+    int section = sectionHeader(line, eol);
+    return section == Points ? GEOMETRY_SECTION_POINTS : section == Indices ? GEOMETRY_SECTION_INDICES : -1;
+}
+
+bool parseGeometryPointLine(const char * line, const char * eol, float ** points, size_t * count, size_t * capacity) {
+    if (line < eol && line[0] == '#') return true;
+    return parsePointLine(line, eol, points, count, capacity, true);
+}
+
+// Maps a whole file read-only, followed by at least one NUL byte so the text can
+// be handed to strtof & co without copying. Returns NULL on failure.
+// An empty file maps to an empty string.
+const char * mapFile(const char * path, size_t * size) {
+    int fd = open(path, O_RDONLY);
+	if (fd < 0){
 		printf("can't open file:\n %s\n", path);
-		return false;
+		return NULL;
 	}
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+		printf("can't stat file:\n %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    *size = st.st_size;
+    // Reserve one extra zeroed page, then map the file over the start of it
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    char *base = mmap(NULL, *size + pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        printf("can't map file:\n %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    if (*size > 0 && mmap(base, *size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        printf("can't map file:\n %s\n", path);
+        munmap(base, *size + pageSize);
+        close(fd);
+        return NULL;
+    }
+    madvise(base, *size, MADV_SEQUENTIAL);
+    close(fd);
+    return base;
+}
+
+void unmapFile(const char * data, size_t size) {
+    munmap((void *)data, size + sysconf(_SC_PAGESIZE));
+}
+
+// WebGPU buffer sizes and writes are multiples of 4 bytes. Pad the indices
+// with zeros up to that so indexData can go to wgpuQueueWriteBuffer as is.
+static bool padIndexData(t_geometry_data * geometry_data) {
+    size_t paddedSize = (geometry_data->indexDataSize + 3) & ~(size_t)3;
+    if (paddedSize == 0) paddedSize = 4;
+    char *indices = realloc(geometry_data->indexData, paddedSize);
+    if (!indices) {
+        printf("Memory Re-allocation failed.\n");
+        return false;
+    }
+    memset(indices + geometry_data->indexDataSize, 0, paddedSize - geometry_data->indexDataSize);
+    geometry_data->indexData = indices;
+    return true;
+}
+
+size_t indexFormatSize(WGPUIndexFormat format) {
+    return format == WGPUIndexFormat_Uint32 ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
+// Picks the smallest index format that holds maxIndex. With Uint16 the 32 bit
+// indices are narrowed in place, front to back so nothing is overwritten
+// before it is read.
+static void selectIndexFormat(t_geometry_data * geometry_data, size_t indexCount, uint32_t maxIndex) {
+    if (maxIndex > UINT16_MAX) {
+        geometry_data->indexFormat = WGPUIndexFormat_Uint32;
+        geometry_data->indexDataSize = indexCount * sizeof(uint32_t);
+        return;
+    }
+    // (read through memcpy: the two views alias)
+    const char *wide = geometry_data->indexData;
+    uint16_t *narrow = geometry_data->indexData;
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t index;
+        memcpy(&index, wide + i * sizeof(uint32_t), sizeof(index));
+        narrow[i] = index;
+    }
+    geometry_data->indexFormat = WGPUIndexFormat_Uint16;
+    geometry_data->indexDataSize = indexCount * sizeof(uint16_t);
+}
 
-	enum Section {
-		None,
-		Points,
-		Indices,
-	};
+uint32_t * getGeometryIndices(const t_geometry_data * geometry_data, size_t * indexCount) {
+    size_t count = geometry_data->indexDataSize / indexFormatSize(geometry_data->indexFormat);
+    uint32_t *indices = malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!indices) {
+        printf("Memory Allocation failed.\n");
+        return NULL;
+    }
+    if (geometry_data->indexFormat == WGPUIndexFormat_Uint32) {
+        memcpy(indices, geometry_data->indexData, count * sizeof(uint32_t));
+    } else {
+        const uint16_t *narrow = geometry_data->indexData;
+        for (size_t i = 0; i < count; i++) indices[i] = narrow[i];
+    }
+    *indexCount = count;
+    return indices;
+}
+
+bool setGeometryIndices(t_geometry_data * geometry_data, const uint32_t * indices, size_t indexCount) {
+    uint32_t *wide = realloc(geometry_data->indexData, (indexCount ? indexCount : 1) * sizeof(uint32_t));
+    if (!wide) {
+        printf("Memory Re-allocation failed.\n");
+        return false;
+    }
+    uint32_t maxIndex = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        wide[i] = indices[i];
+        if (indices[i] > maxIndex) maxIndex = indices[i];
+    }
+    geometry_data->indexData = wide;
+    selectIndexFormat(geometry_data, indexCount, maxIndex);
+    return padIndexData(geometry_data);
+}
+
+//  ------------------------------- Chunked parsing------------------------------------------------------------------
+// parseGeometry splits every section into chunks that start and end on line
+// boundaries, counts their tokens in parallel, turns the counts into output
+// offsets with a prefix sum and parses the chunks in parallel straight into
+// the final arrays. Small files end up with one chunk per section, which is
+// the plain serial parse.
+
+// Below this a chunk is not worth handing to another thread
+#define MIN_CHUNK_SIZE (1024 * 1024)
+// Chunks per thread, so uneven lines still balance out
+#define CHUNKS_PER_THREAD 4
+
+typedef struct GeometryChunk {
+    const char * begin;     // first line
+    const char * end;       // just past the last line
+    enum Section section;
+    size_t count;           // tokens found by the first pass
+    size_t offset;          // where the chunk's values start in the output
+    void * values;          // where they were parsed to
+    size_t parsed;          // how many were parsed
+    bool ownsValues;        // values is a private array (the count was off)
+    uint32_t maxIndex;      // largest index parsed, for [indices] chunks
+    bool failed;
+} t_geometry_chunk;
+
+typedef struct ChunkList {
+    t_geometry_chunk * chunks;
+    size_t count;
+    size_t capacity;
+    float * points;
+    uint32_t * indices;
+} t_chunk_list;
+
+static t_thread_pool * geometryThreadPool = NULL;
+static size_t geometryThreads = 0;
+
+void setGeometryThreads(size_t threadCount) {
+    if (threadCount == 0) {
+        const char *env = getenv("GEOMETRY_THREADS");
+        threadCount = env ? strtoul(env, NULL, 10) : 0;
+        if (threadCount == 0) threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threadCount == 0) threadCount = 1;
+    }
+    if (geometryThreadPool && threadPoolSize(geometryThreadPool) == threadCount) return;
+    destroyThreadPool(geometryThreadPool);
+    geometryThreadPool = threadCount > 1 ? createThreadPool(threadCount) : NULL;
+    geometryThreads = threadCount;
+}
+
+size_t getGeometryThreads(void) {
+    if (geometryThreads == 0) setGeometryThreads(0);
+    return geometryThreads;
+}
+
+static bool addChunk(t_chunk_list * list, const char * begin, const char * end, enum Section section) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        t_geometry_chunk *tmp = realloc(list->chunks, capacity * sizeof(t_geometry_chunk));
+        if (!tmp) return false;
+        list->chunks = tmp;
+        list->capacity = capacity;
+    }
+    list->chunks[list->count++] = (t_geometry_chunk){
+        .begin = begin,
+        .end = end,
+        .section = section
+    };
+    return true;
+}
+
+// Cuts [begin, end) into chunks of about chunkSize bytes, on line boundaries
+static bool addSectionChunks(t_chunk_list * list, const char * begin, const char * end, enum Section section, size_t chunkSize) {
+    if (section == None || begin >= end) return true;
+    while (begin < end) {
+        const char *chunkEnd = end;
+        if ((size_t)(end - begin) > chunkSize + chunkSize / 2) {
+            chunkEnd = findNewline(begin + chunkSize, end);
+            if (chunkEnd < end) chunkEnd++;
+        }
+        if (!addChunk(list, begin, chunkEnd, section)) return false;
+        begin = chunkEnd;
+    }
+    return true;
+}
+
+// Splits the file at its section headers. Headers are the only lines starting
+// with '[', so we only look at those instead of walking every line.
+static bool splitSections(t_chunk_list * list, const char * data, const char * end, size_t chunkSize) {
 	enum Section currentSection = None;
+    const char *sectionBegin = data;
+    for (const char *p = data; p < end; p++) {
+        p = memchr(p, '[', end - p);
+        if (!p) break;
+        if (p != data && p[-1] != '\n') continue;
+        const char *eol = findNewline(p, end);
+        int header = sectionHeader(p, eol);
+        if (header < 0) continue;
+        if (!addSectionChunks(list, sectionBegin, p, currentSection, chunkSize)) return false;
+        currentSection = header;
+        sectionBegin = eol < end ? eol + 1 : end;
+        p = eol;
+    }
+    return addSectionChunks(list, sectionBegin, end, currentSection, chunkSize);
+}
 
-	float value;
-	uint16_t index;
-    size_t line_buf_size = 0;
-    char *line;
-
-    ssize_t line_size = getline(&line, &line_buf_size, f);
-
-	while (line_size >= 0) {
-		if (strcmp(line, "[points]\n") == 0) {
-			currentSection = Points;
-		}
-		else if (strcmp(line, "[indices]\n") == 0) {
-			currentSection = Indices;
-		}
-		else if (line[0] == '#' || line[0] == '\n') {
-		}
-		else if (currentSection == Points) {
-            char *start = line;
-            char *eon;
-            float value;
-            errno = 0;
-            
-            float * tmp;
-            // extract floating next point number after the current 'start' place in the the line
-            while ((value = strtof(start, &eon)),
-                eon != start &&
-                !((errno == EINVAL && value == 0) ||
-                    (errno == ERANGE && (value == FLT_MIN || value == FLT_MAX))))
-            {
-                tmp = realloc(geometry_data->pointData, geometry_data->pointDataSize + (sizeof(float)));
-                if (!tmp) {
-                    printf("Memory Re-allocation failed.\n");
-					return false;
-                } else {
-                    geometry_data->pointData = tmp;
-                    geometry_data->pointData[pointcount] = value;
-                    pointcount++;
-                    geometry_data->pointDataSize += (sizeof(float));
-
-                    start = eon;
-                    errno = 0;
-                }
-            }
-		}
-		else if (currentSection == Indices) {
-            char *start = line;
-            char *eon;
-            long value;
-            errno = 0;
-            
-            uint16_t * tmp;
-            // extract next long integer after the current 'start' point in the the line.
-            while ((value = strtol(start, &eon, 0)),
-                eon != start &&
-                !((errno == EINVAL && value == 0) ||
-                    (errno == ERANGE && (value == LONG_MIN || value == LONG_MAX))))
-            {
-                tmp = realloc(geometry_data->indexData, geometry_data->pointDataSize + sizeof(uint16_t));
-                if (!tmp) {
-                    printf("Memory Re-allocation failed.");
-					return false;
-                } else {
-                    geometry_data->indexData = tmp;
-                }
-                geometry_data->indexData[indexcount] = value;
-                indexcount++;
-                geometry_data->indexDataSize += (sizeof(uint16_t));
-
-                start = eon;
-                errno = 0;
-            }
-		}
-        line_size = getline(&line, &line_buf_size, f);
-	}
+static void countChunk(size_t index, void * pList) {
+    t_geometry_chunk *chunk = &((t_chunk_list *)pList)->chunks[index];
+    for (const char *line = chunk->begin; line < chunk->end;) {
+        const char *eol = findNewline(line, chunk->end);
+        if (line[0] != '#') chunk->count += countTokens(line, eol);
+        line = eol + 1;
+    }
+}
 
-    free(line);
-    fclose(f);
-	return true;
+static bool parseChunkLines(t_geometry_chunk * chunk, size_t * capacity, bool canGrow) {
+    bool success = true;
+    chunk->parsed = 0;
+    chunk->maxIndex = 0;
+    for (const char *line = chunk->begin; success && line < chunk->end;) {
+        const char *eol = findNewline(line, chunk->end);
+        if (line[0] != '#') {
+            if (chunk->section == Points) success = parsePointLine(line, eol, (float **)&chunk->values, &chunk->parsed, capacity, canGrow);
+            else success = parseIndexLine(line, eol, (uint32_t **)&chunk->values, &chunk->parsed, capacity, canGrow, &chunk->maxIndex);
+        }
+        line = eol + 1;
+    }
+    return success;
 }
 
+static void parseChunk(size_t index, void * pList) {
+    t_chunk_list *list = pList;
+    t_geometry_chunk *chunk = &list->chunks[index];
+    size_t elementSize = chunk->section == Points ? sizeof(float) : sizeof(uint32_t);
+
+    // Values go straight to the chunk's slot in the shared output array
+    size_t capacity = chunk->count;
+    chunk->values = chunk->section == Points ? (void *)(list->points + chunk->offset) : (void *)(list->indices + chunk->offset);
+    if (parseChunkLines(chunk, &capacity, false)) return;
+
+    // More numbers than tokens: parse again into an array of its own
+    capacity = chunk->count * 2 + 16;
+    chunk->values = malloc(capacity * elementSize);
+    chunk->ownsValues = true;
+    chunk->failed = !chunk->values || !parseChunkLines(chunk, &capacity, true);
+}
 
+// When some chunk parsed a different number of values than it counted, the
+// slots no longer line up. Rebuild the array in chunk order.
+static bool compactSection(t_chunk_list * list, enum Section section, void ** array, size_t * total) {
+    size_t elementSize = section == Points ? sizeof(float) : sizeof(uint32_t);
+    bool aligned = true;
+    size_t parsed = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        t_geometry_chunk *chunk = &list->chunks[i];
+        if (chunk->section != section) continue;
+        aligned = aligned && !chunk->ownsValues && chunk->parsed == chunk->count;
+        parsed += chunk->parsed;
+    }
+    *total = parsed;
+    if (aligned) return true;
+
+    char *compacted = malloc((parsed ? parsed : 1) * elementSize);
+    if (!compacted) {
+        printf("Memory Re-allocation failed.\n");
+        return false;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        t_geometry_chunk *chunk = &list->chunks[i];
+        if (chunk->section != section) continue;
+        memcpy(compacted + offset * elementSize, chunk->values, chunk->parsed * elementSize);
+        offset += chunk->parsed;
+    }
+    free(*array);
+    *array = compacted;
+    return true;
+}
+
+bool parseGeometry(const char * path, t_geometry_data * geometry_data) {
+    size_t fileSize;
+    const char *data = mapFile(path, &fileSize);
+    if (!data) return false;
+    const char *end = data + fileSize;
+
+    size_t threadCount = getGeometryThreads();
+    size_t chunkSize = fileSize / (threadCount * CHUNKS_PER_THREAD);
+    if (threadCount == 1 || chunkSize < MIN_CHUNK_SIZE) chunkSize = threadCount == 1 ? fileSize : MIN_CHUNK_SIZE;
+    t_chunk_list list = {0};
+    if (!splitSections(&list, data, end, chunkSize)) {
+        printf("Memory Re-allocation failed.\n");
+        unmapFile(data, fileSize);
+        free(list.chunks);
+        return false;
+    }
+
+    // First pass: count the tokens of each chunk, then prefix sum them into offsets
+    threadPoolParallelFor(geometryThreadPool, list.count, countChunk, &list);
+    size_t pointCount = 0;
+    size_t indexCount = 0;
+    for (size_t i = 0; i < list.count; i++) {
+        t_geometry_chunk *chunk = &list.chunks[i];
+        size_t *sectionCount = chunk->section == Points ? &pointCount : &indexCount;
+        chunk->offset = *sectionCount;
+        *sectionCount += chunk->count;
+    }
+
+    // (never ask realloc for 0 bytes, it may free the caller's buffer)
+    float *points = realloc(geometry_data->pointData, (pointCount ? pointCount : 1) * sizeof(float));
+    if (points) geometry_data->pointData = points;
+    uint32_t *indices = realloc(geometry_data->indexData, (indexCount ? indexCount : 1) * sizeof(uint32_t));
+    if (indices) geometry_data->indexData = indices;
+    if (!points || !indices) {
+        printf("Memory Re-allocation failed.\n");
+        unmapFile(data, fileSize);
+        free(list.chunks);
+        return false;
+    }
 
+    // Second pass: parse every chunk straight from the mapping into its slot
+    list.points = points;
+    list.indices = indices;
+    threadPoolParallelFor(geometryThreadPool, list.count, parseChunk, &list);
+
+    bool success = true;
+    uint32_t maxIndex = 0;
+    for (size_t i = 0; i < list.count; i++) {
+        success = success && !list.chunks[i].failed;
+        if (list.chunks[i].section == Indices && list.chunks[i].maxIndex > maxIndex) maxIndex = list.chunks[i].maxIndex;
+    }
+    size_t pointsRead = 0;
+    size_t indicesRead = 0;
+    success = success &&
+        compactSection(&list, Points, (void **)&geometry_data->pointData, &pointsRead) &&
+        compactSection(&list, Indices, (void **)&geometry_data->indexData, &indicesRead);
+
+    for (size_t i = 0; i < list.count; i++) {
+        if (list.chunks[i].ownsValues) free(list.chunks[i].values);
+    }
+    free(list.chunks);
+    unmapFile(data, fileSize);
+    if (!success) return false;
+
+    geometry_data->pointDataSize = pointsRead * sizeof(float);
+    selectIndexFormat(geometry_data, indicesRead, maxIndex);
+	return padIndexData(geometry_data);
+}
+
+bool loadGeometry(const char * path, t_geometry_data * geometry_data) {
+    t_geometry_cache cache;
+    if (openGeometryCache(path, NULL, &cache)) {
+        size_t pointDataSize = cache.header->vertexSize;
+        size_t indexDataSize = cache.header->indexSize;
+        float *points = realloc(geometry_data->pointData, pointDataSize ? pointDataSize : 1);
+        if (points) geometry_data->pointData = points;
+        void *indices = realloc(geometry_data->indexData, indexDataSize ? indexDataSize : 1);
+        if (indices) geometry_data->indexData = indices;
+        if (!points || !indices) {
+            printf("Memory Re-allocation failed.\n");
+            closeGeometryCache(&cache);
+            return false;
+        }
+        memcpy(points, cache.vertices, pointDataSize);
+        memcpy(indices, cache.indices, indexDataSize);
+        geometry_data->pointDataSize = pointDataSize;
+        geometry_data->indexDataSize = indexDataSize;
+        geometry_data->indexFormat = cache.header->indexFormat;
+        closeGeometryCache(&cache);
+        return padIndexData(geometry_data);
+    }
+
+    if (!parseGeometry(path, geometry_data)) return false;
+    // A missing cache is not an error, we'll just parse again next time
+    writeGeometryCache(path, geometry_data, NULL);
+    return true;
+}
@@ -3,6 +3,7 @@
 
 #include <webgpu/webgpu.h>
 #include <assert.h>
+#include "hash.h"
 
 //  ------------------------------- Adapter------------------------------------------------------------------
 struct AdapterUserData {
@@ -63,16 +64,48 @@ static const WGPULimits DEFAULT_WGPU_LIMITS = {
 void cCallback(WGPUErrorType type, char const* message, void* userdata);
 void onDeviceLost(WGPUDeviceLostReason reason, char const* message, void* userdata);
 
+// The module belongs to the shader registry (see shader_registry.h), don't release it
 WGPUShaderModule loadShaderModule(const char * path, WGPUDevice device);
 
 typedef struct GeometryData {
     float *pointData;
     size_t pointDataSize;
-    uint16_t * indexData;
+    void * indexData;       // uint16_t or uint32_t, see indexFormat
     size_t indexDataSize;
+    WGPUIndexFormat indexFormat;
 } t_geometry_data;
 
+// Loads a geometry text file, going through its binary cache (see geometry_cache.h)
 bool loadGeometry(const char * path, t_geometry_data * geometry_data);
+// Parses the text file only, never touches the cache.
+// Indices are stored as Uint16 when they all fit, Uint32 otherwise.
+bool parseGeometry(const char * path, t_geometry_data * geometry_data);
+
+// Bytes per index of an index format
+size_t indexFormatSize(WGPUIndexFormat format);
+// Copies indexData, whatever its format, to a malloc'd uint32_t array
+uint32_t * getGeometryIndices(const t_geometry_data * geometry_data, size_t * indexCount);
+// Replaces indexData with a copy of indices, in the smallest format that holds them
+bool setGeometryIndices(t_geometry_data * geometry_data, const uint32_t * indices, size_t indexCount);
+
+// Line by line access to the parser, for text that arrives in pieces.
+// The line [line, eol) must be followed by FAST_PARSE_PADDING readable bytes
+// and eol must point at a '\n' or a NUL.
+#define GEOMETRY_SECTION_POINTS 1
+#define GEOMETRY_SECTION_INDICES 2
+// GEOMETRY_SECTION_xxx if the line is a section header, -1 otherwise
+int geometrySectionHeader(const char * line, const char * eol);
+// Appends the numbers of a [points] line to points (capacity > 0), growing
+// it as needed. Comment lines are skipped.
+bool parseGeometryPointLine(const char * line, const char * eol, float ** points, size_t * count, size_t * capacity);
+
+// Threads parseGeometry splits large files across. 0 means the
+// GEOMETRY_THREADS environment variable, or else one per CPU.
+void setGeometryThreads(size_t threadCount);
+size_t getGeometryThreads(void);
+
+const char * mapFile(const char * path, size_t * size);
+void unmapFile(const char * data, size_t size);
 
 static const WGPUBindGroupLayoutEntry BIND_GROUP_DEFAULT = {
 	.binding = 0,
@@ -0,0 +1,116 @@
+#include <webgpu/webgpu.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "instance_buffer.h"
+
+static const WGPUVertexAttribute instanceAttributes[INSTANCE_ATTRIBUTE_COUNT] = {
+    // Position and scale
+    {.shaderLocation = INSTANCE_FIRST_LOCATION, .format = WGPUVertexFormat_Float32x4, .offset = offsetof(t_instance_data, position)},
+    {.shaderLocation = INSTANCE_FIRST_LOCATION + 1, .format = WGPUVertexFormat_Float32x4, .offset = offsetof(t_instance_data, color)},
+    {.shaderLocation = INSTANCE_FIRST_LOCATION + 2, .format = WGPUVertexFormat_Float32, .offset = offsetof(t_instance_data, timeOffset)}
+};
+
+const WGPUVertexBufferLayout instanceBufferLayout = {
+    .attributeCount = INSTANCE_ATTRIBUTE_COUNT,
+    .attributes = instanceAttributes,
+    .arrayStride = sizeof(t_instance_data),
+    // Advance once per instance instead of once per vertex
+    .stepMode = WGPUVertexStepMode_Instance
+};
+
+static bool createBuffer(t_instance_buffer * instances, size_t capacity) {
+    WGPUBufferDescriptor bufferDesc = {
+        .label = "Instances",
+        .size = capacity * sizeof(t_instance_data),
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
+        .mappedAtCreation = false
+    };
+    WGPUBuffer buffer = wgpuDeviceCreateBuffer(instances->device, &bufferDesc);
+    if (!buffer) {
+        printf("can't create an instance buffer of %zu instances\n", capacity);
+        return false;
+    }
+    // Draws already submitted keep the old buffer alive until they are done
+    if (instances->buffer) wgpuBufferRelease(instances->buffer);
+    instances->buffer = buffer;
+    instances->bufferCapacity = capacity;
+    return true;
+}
+
+bool initInstanceBuffer(t_instance_buffer * instances, WGPUDevice device, size_t capacity) {
+    if (capacity == 0) capacity = 1;
+    *instances = (t_instance_buffer){
+        .device = device,
+        .queue = wgpuDeviceGetQueue(device),
+        .data = malloc(capacity * sizeof(t_instance_data)),
+        .capacity = capacity
+    };
+    if (!instances->data) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    return createBuffer(instances, capacity);
+}
+
+void releaseInstanceBuffer(t_instance_buffer * instances) {
+    if (instances->buffer) wgpuBufferRelease(instances->buffer);
+    free(instances->data);
+    instances->buffer = NULL;
+    instances->data = NULL;
+}
+
+t_instance_data * addInstances(t_instance_buffer * instances, size_t count) {
+    if (instances->count + count > instances->capacity) {
+        size_t capacity = instances->capacity * 2;
+        if (capacity < instances->count + count) capacity = instances->count + count;
+        t_instance_data *data = realloc(instances->data, capacity * sizeof(t_instance_data));
+        if (!data) {
+            printf("Memory Re-allocation failed.\n");
+            return NULL;
+        }
+        instances->data = data;
+        instances->capacity = capacity;
+    }
+    t_instance_data *added = instances->data + instances->count;
+    instances->count += count;
+    return added;
+}
+
+void clearInstances(t_instance_buffer * instances) {
+    instances->count = 0;
+}
+
+bool flushInstanceBuffer(t_instance_buffer * instances) {
+    if (instances->count > instances->bufferCapacity && !createBuffer(instances, instances->capacity)) return false;
+    if (instances->count > 0) {
+        wgpuQueueWriteBuffer(instances->queue, instances->buffer, 0, instances->data, instances->count * sizeof(t_instance_data));
+    }
+    return true;
+}
+
+void layoutInstanceGrid(t_instance_data * instances, size_t count, float aspectRatio) {
+    // Clip space is 2 wide and 2 / aspectRatio high before the shader scales y
+    float height = 2.0f / aspectRatio;
+    size_t columns = (size_t)ceilf(sqrtf(count * 2.0f / height));
+    if (columns == 0) columns = 1;
+    size_t rows = (count + columns - 1) / columns;
+    float spacing = fminf(2.0f / columns, height / rows);
+    // Centered on the side that isn't filled
+    float left = -spacing * columns / 2;
+    float bottom = -spacing * rows / 2;
+    for (size_t i = 0; i < count; i++) {
+        size_t column = i % columns;
+        size_t row = i / columns;
+        float u = (column + 0.5f) / columns;
+        float v = (row + 0.5f) / rows;
+        instances[i] = (t_instance_data){
+            .position = {left + (column + 0.5f) * spacing, bottom + (row + 0.5f) * spacing, 0.0f},
+            // The pyramid is one unit wide
+            .scale = spacing * 0.8f,
+            .color = {u, v, 1.0f - u, 1.0f},
+            .timeOffset = (i % 64) * 0.1f
+        };
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef INSTANCE_BUFFER_HEADER_FILE
+#define INSTANCE_BUFFER_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "uniform_layout.h"
+
+//  ------------------------------- Instance buffer------------------------------------------------------------------
+// Per object data for hardware instancing: the objects go in one vertex buffer
+// read with WGPUVertexStepMode_Instance, and N of them are drawn with a single
+// wgpuRenderPassEncoderDrawIndexed(pass, indexCount, N, 0, 0, 0) instead of a
+// SetBindGroup and a DrawIndexed each. The shader gets an object's fields as
+// vertex attributes at INSTANCE_FIRST_LOCATION onwards:
+//   @location(2) positionScale: vec4<f32>,
+//   @location(3) color: vec4<f32>,
+//   @location(4) timeOffset: f32,
+//
+// A vertex buffer rather than a storage buffer indexed by instance_index: it
+// needs no bind group and fits the default limits (and compatibility mode,
+// where vertex shaders may not have storage buffers).
+
+#define INSTANCE_FIRST_LOCATION 2
+#define INSTANCE_ATTRIBUTE_COUNT 3
+
+// The shader's Instance struct, which per draw uniforms use too (see
+// instanced.wsl). timeOffset is added to the time, so objects don't move in step.
+#define INSTANCE_FIELDS(FIELD) \
+    FIELD(vec3f, position) \
+    FIELD(f32, scale) \
+    FIELD(vec4f, color) \
+    FIELD(f32, timeOffset)
+UNIFORM_STRUCT(Instance, INSTANCE_FIELDS)
+typedef Instance t_instance_data;
+
+typedef struct InstanceBuffer {
+    WGPUDevice device;
+    WGPUQueue queue;
+    WGPUBuffer buffer;
+    size_t bufferCapacity;      // instances the buffer holds
+    t_instance_data * data;     // CPU copy, uploaded by flushInstanceBuffer()
+    size_t count;
+    size_t capacity;
+} t_instance_buffer;
+
+// Layout of the instance buffer, for WGPUVertexState.buffers
+extern const WGPUVertexBufferLayout instanceBufferLayout;
+
+bool initInstanceBuffer(t_instance_buffer * instances, WGPUDevice device, size_t capacity);
+void releaseInstanceBuffer(t_instance_buffer * instances);
+
+// Room for count more instances, to fill before the flush. NULL if it can't grow.
+t_instance_data * addInstances(t_instance_buffer * instances, size_t count);
+void clearInstances(t_instance_buffer * instances);
+
+// Uploads every instance with one write, growing the GPU buffer if needed
+// (which gives a new instances->buffer). Returns false if it can't.
+bool flushInstanceBuffer(t_instance_buffer * instances);
+
+// Fills count instances with objects on a grid covering the window (the
+// shader multiplies y by aspectRatio), each with its own colour and timeOffset
+void layoutInstanceGrid(t_instance_data * instances, size_t count, float aspectRatio);
+
+#endif
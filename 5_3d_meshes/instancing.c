@@ -0,0 +1,400 @@
+#include <GLFW/glfw3.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glfw3webgpu.h>
+#include "helper_v3.h"
+#include "shader_registry.h"
+#include "pipeline_registry.h"
+#include "geometry_cache.h"
+#include "wgsl_preprocessor.h"
+#include "instance_buffer.h"
+#include "frames_in_flight.h"
+#include "uniform_ring.h"
+#include "uniform_layout.h"
+#include "shader_reflection.h"
+
+// A grid of spinning pyramids, drawn with a single instanced draw call: each
+// pyramid's position, colour and time offset are vertex attributes stepping per
+// instance. With "per-draw" they are drawn the way dynamic_uniforms.c does it
+// instead, one SetBindGroup and DrawIndexed each. instancing_bench compares both.
+// Usage: instancing [count] [per-draw]
+
+// Per draw mode needs a uniform slice per pyramid per frame in flight
+#define MAX_PER_DRAW_PYRAMIDS 65536
+
+// What all pyramids share, laid out the way WGSL lays it out (see uniform_layout.h)
+#define FRAME_UNIFORMS(FIELD) \
+	FIELD(f32, time)
+UNIFORM_STRUCT(FrameUniforms, FRAME_UNIFORMS)
+
+int main(int argc, char *argv[]) {
+	size_t pyramidCount = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	bool instanced = argc < 3 || strcmp(argv[2], "per-draw") != 0;
+	if (!instanced && pyramidCount > MAX_PER_DRAW_PYRAMIDS) {
+		printf("Per draw mode is limited to %d pyramids\n", MAX_PER_DRAW_PYRAMIDS);
+		pyramidCount = MAX_PER_DRAW_PYRAMIDS;
+	}
+
+	WGPUInstanceDescriptor desc = { .nextInChain = NULL};
+    WGPUInstance instance = wgpuCreateInstance(&desc);
+    if (!instance) {
+        fprintf(stderr, "Could not initialize WebGPU!\n");
+        return 1;
+    }
+    if (!glfwInit()) {
+        printf("Could not initialize GLFW!\n");
+        return 1;
+    }
+
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(640, 480, "Learn WebGPU", NULL, NULL);
+    if (!window) {
+        printf("Could not open window!\n");
+        glfwTerminate();
+        return 1;
+    }
+
+	printf("Requesting adapter...\n");
+	WGPUSurface surface = glfwGetWGPUSurface(instance, window);
+	WGPURequestAdapterOptions adapterOpts = {
+		.compatibleSurface = surface
+	};
+	WGPUAdapter adapter = requestAdapter(instance, &adapterOpts);
+	printf( "Got adapter: %p\n", adapter);
+
+	printf("Requesting device...\n");
+	WGPURequiredLimits requiredLimits = {
+		.limits = DEFAULT_WGPU_LIMITS
+	};
+	// Position and colour per vertex, then position and scale, colour and time offset per instance
+	requiredLimits.limits.maxVertexAttributes = 2 + INSTANCE_ATTRIBUTE_COUNT;
+	// The pyramid's vertices and the instances
+	requiredLimits.limits.maxVertexBuffers = 2;
+	// need these limits for it to run on my machine
+    requiredLimits.limits.minUniformBufferOffsetAlignment = 64;
+    requiredLimits.limits.minStorageBufferOffsetAlignment = 32;
+	requiredLimits.limits.maxBindGroups = 1;
+	// Frame uniforms, and the pyramid's in per draw mode
+	requiredLimits.limits.maxUniformBuffersPerShaderStage = 2;
+	requiredLimits.limits.maxUniformBufferBindingSize = 16 * 4;
+	requiredLimits.limits.maxDynamicUniformBuffersPerPipelineLayout = 1;
+	WGPUDeviceDescriptor deviceDesc = {
+		.nextInChain = NULL,
+		.label = "My Device",
+		.requiredFeaturesCount = 0,
+		.requiredLimits = &requiredLimits,
+		.defaultQueue.label = "The default queue"
+	};
+	WGPUDevice device = requestDevice(adapter, &deviceDesc);
+	printf( "Got device: %p\n", device);
+
+	// Add an error callback for more debug info
+	wgpuDeviceSetUncapturedErrorCallback(device, cCallback, NULL);
+	wgpuDeviceSetDeviceLostCallback(device, onDeviceLost, NULL);
+
+	WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+	printf( "Creating swapchain...\n");
+	WGPUTextureFormat swapChainFormat = WGPUTextureFormat_BGRA8Unorm;
+	WGPUSwapChainDescriptor swapChainDesc = {
+		.width = 640,
+		.height = 480,
+		.usage = WGPUTextureUsage_RenderAttachment,
+		.format = swapChainFormat,
+		.presentMode = WGPUPresentMode_Fifo
+	};
+	WGPUSwapChain swapChain = wgpuDeviceCreateSwapChain(device, surface, &swapChainDesc);
+	printf( "Swapchain: %p\n", swapChain);
+
+	// One file for both modes, the preprocessor picks where the pyramid's data comes from
+	static const t_wgsl_define shaderDefines[] = {{"INSTANCED", "1"}};
+	WGPUShaderModule shaderModule = loadShaderPermutation(device, RESOURCE_DIR "/instanced.wsl", shaderDefines, instanced ? 1 : 0);
+	printf( "Shader module: %p\n", shaderModule);
+	// Both sides must agree on the uniforms' and the instances' layout
+	if (!checkShaderUniforms(RESOURCE_DIR "/instanced.wsl", shaderDefines, instanced ? 1 : 0, UNIFORM_LAYOUT(FrameUniforms)) ||
+		!checkShaderUniforms(RESOURCE_DIR "/instanced.wsl", shaderDefines, instanced ? 1 : 0, UNIFORM_LAYOUT(Instance))) {
+		return 1;
+	}
+
+	printf( "Creating render pipeline...\n");
+
+	// Vertex fetch and bindings, as the shader of this mode declares them
+	t_shader_reflection reflection;
+	if (!reflectShader(RESOURCE_DIR "/instanced.wsl", shaderDefines, instanced ? 1 : 0, NULL, 0, &reflection)) return 1;
+
+	// Buffer 0 advances per vertex, buffer 1 (instanced mode only) per instance
+	WGPUVertexBufferLayout vertexBufferLayouts[2] = {
+		getReflectedVertexBuffer(&reflection, 0, 2, WGPUVertexStepMode_Vertex),
+		getReflectedVertexBuffer(&reflection, INSTANCE_FIRST_LOCATION, INSTANCE_ATTRIBUTE_COUNT, WGPUVertexStepMode_Instance)
+	};
+	// The instance attributes are packed like t_instance_data, padding included
+	vertexBufferLayouts[1].arrayStride = sizeof(t_instance_data);
+
+	WGPUColorTargetState colorTarget = {
+		.format = swapChainFormat,
+		.blend = NULL,
+		.writeMask = WGPUColorWriteMask_All
+	};
+
+	WGPUFragmentState fragmentState = {
+		.module = shaderModule,
+		.entryPoint = "fs_main",
+		.constantCount = 0,
+		.constants = NULL,
+		.targetCount = 1,
+		.targets = &colorTarget
+	};
+
+	WGPUDepthStencilState depthStencilState = DEFAULT_DEPTH_STENCIL;
+	depthStencilState.depthCompare = WGPUCompareFunction_Less;
+	depthStencilState.depthWriteEnabled = true;
+	WGPUTextureFormat depthTextureFormat = WGPUTextureFormat_Depth24Plus;
+	depthStencilState.format = depthTextureFormat;
+	// Deactivate the stencil alltogether
+	depthStencilState.stencilReadMask = 0;
+	depthStencilState.stencilWriteMask = 0;
+
+	// Create the depth texture
+	WGPUTextureDescriptor depthTextureDesc = {
+		.dimension = WGPUTextureDimension_2D,
+		.format = depthTextureFormat,
+		.mipLevelCount = 1,
+		.sampleCount = 1,
+		.size = {640, 480, 1},
+		.usage = WGPUTextureUsage_RenderAttachment,
+		.viewFormatCount = 1,
+		.viewFormats = &depthTextureFormat
+	};
+	WGPUTexture depthTexture = wgpuDeviceCreateTexture(device, &depthTextureDesc);
+
+	// Create the view of the depth texture manipulated by the rasterizer
+	WGPUTextureViewDescriptor depthTextureViewDesc = {
+		.aspect = WGPUTextureAspect_DepthOnly,
+		.baseArrayLayer = 0,
+		.arrayLayerCount = 1,
+		.baseMipLevel = 0,
+		.mipLevelCount = 1,
+		.dimension = WGPUTextureViewDimension_2D,
+		.format = depthTextureFormat,
+	};
+	WGPUTextureView depthTextureView = wgpuTextureCreateView(depthTexture, &depthTextureViewDesc);
+
+	// Binding 0 holds what all pyramids share. In per draw mode binding 1 holds
+	// one pyramid's data, at a dynamic offset that changes between draws: the
+	// shader can't tell that, the layout has to be told.
+	WGPUBindGroupLayoutEntry *objectBinding = findReflectedBinding(&reflection, 0, 1);
+	if (objectBinding) objectBinding->buffer.hasDynamicOffset = true;
+	WGPUBindGroupLayout bindGroupLayout = getReflectedBindGroupLayout(device, &reflection, 0);
+
+	// Specializes the shader for the window when the pipeline compiles
+	WGPUConstantEntry vertexConstants[] = {
+		{.key = "aspectRatio", .value = 640.0 / 480.0}
+	};
+
+	WGPURenderPipelineDescriptor pipelineDesc = {
+		.label = instanced ? "Instanced pyramids" : "Per draw pyramids",
+		.vertex = (WGPUVertexState){
+			.bufferCount = instanced ? 2 : 1,
+			.buffers = vertexBufferLayouts,
+
+			.module = shaderModule,
+			.entryPoint = "vs_main",
+			.constantCount = 1,
+			.constants = vertexConstants
+			},
+		.primitive = (WGPUPrimitiveState){
+			.topology = WGPUPrimitiveTopology_TriangleList,
+			.stripIndexFormat = WGPUIndexFormat_Undefined,
+			.frontFace = WGPUFrontFace_CCW,
+			.cullMode = WGPUCullMode_None
+		},
+		.fragment = &fragmentState,
+		.depthStencil = &depthStencilState,
+		.multisample = (WGPUMultisampleState){
+			.count = 1,
+			.mask = ~0u,
+			.alphaToCoverageEnabled = false
+		},
+		.layout = getReflectedPipelineLayout(device, &reflection)
+	};
+
+	WGPURenderPipeline pipeline = getCachedRenderPipeline(device, &pipelineDesc);
+	printf( "Render pipeline: %p\n", pipeline);
+
+	t_geometry_buffers geometryBuffers;
+	bool success = loadGeometryBuffers(device, RESOURCE_DIR "/pyramid.txt", &vertexBufferLayouts[0], &geometryBuffers);
+		if (!success) {
+		fprintf(stderr, "Could not load geometry!\n");
+		return 1;
+	}
+
+	// Create the frame uniform buffer
+	WGPUBufferDescriptor bufferDesc = {
+		.size = sizeof(FrameUniforms),
+		.nextInChain = NULL,
+		.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+		.mappedAtCreation = false
+	};
+	WGPUBuffer uniformBuffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+	FrameUniforms uniforms = {.time = 0.0f};
+
+	// The pyramids, laid out on a grid once. In instanced mode they live in
+	// the instance buffer, in per draw mode they are pushed to the uniform ring.
+	t_instance_buffer instances;
+	if (!initInstanceBuffer(&instances, device, pyramidCount)) {
+		fprintf(stderr, "Could not create the instance buffer!\n");
+		return 1;
+	}
+	t_instance_data *pyramids = addInstances(&instances, pyramidCount);
+	if (!pyramids) return 1;
+	layoutInstanceGrid(pyramids, pyramidCount, 640.0f / 480.0f);
+
+	t_frames_in_flight frames;
+	initFramesInFlight(&frames, device, 2);
+	t_uniform_ring uniformRing = {0};
+	if (instanced) {
+		// Nothing moves on the CPU, one upload is all it takes
+		flushInstanceBuffer(&instances);
+	} else if (!initUniformRing(&uniformRing, &frames, pyramidCount * 256 * frames.maxFrames)) {
+		fprintf(stderr, "Could not create the uniform ring!\n");
+		return 1;
+	}
+
+	WGPUBindGroupEntry bindings[2] = {
+		{
+			.binding = 0,
+			.buffer = uniformBuffer,
+			.offset = 0,
+			.size = sizeof(FrameUniforms)
+		},
+		{
+			.binding = 1,
+			.buffer = uniformRing.buffer,
+			.offset = 0,
+			.size = sizeof(t_instance_data)
+		}
+	};
+
+	// Binding 1 only exists per draw, instances come from a vertex buffer
+	size_t bindingCount = instanced ? 1 : 2;
+	if (reflection.entryCounts[0] != bindingCount) {
+		fprintf(stderr, "instanced.wsl declares %zu bindings in group 0, %zu expected\n", reflection.entryCounts[0], bindingCount);
+		return 1;
+	}
+
+	// A bind group contains one or multiple bindings
+	WGPUBindGroupDescriptor bindGroupDesc = {
+		.nextInChain = NULL,
+		.layout = bindGroupLayout,
+		// There must be as many bindings as declared in the layout!
+		.entryCount = bindingCount,
+		.entries = bindings
+	};
+	WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(device, &bindGroupDesc);
+
+	printf("Drawing %zu pyramids %s\n", pyramidCount, instanced ? "with one instanced draw" : "with one draw each");
+	size_t frameCount = 0;
+	double encodeTime = 0;
+	while (!glfwWindowShouldClose(window)) {
+		glfwPollEvents();
+		uniforms.time = glfwGetTime();
+		wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniforms, sizeof(FrameUniforms));
+		beginFrame(&frames);
+
+		WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView(swapChain);
+		if (!nextTexture) {
+			fprintf(stderr, "Cannot acquire next swap chain texture\n");
+			return 1;
+		}
+
+		double encodeStart = glfwGetTime();
+		WGPUCommandEncoderDescriptor commandEncoderDesc = {.label = "Command Encoder"};
+		WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &commandEncoderDesc);
+
+		WGPURenderPassColorAttachment renderPassColorAttachment = {
+			.view = nextTexture,
+			.resolveTarget = NULL,
+			.loadOp = WGPULoadOp_Clear,
+			.storeOp = WGPUStoreOp_Store,
+			.clearValue = (WGPUColor){ 0.05, 0.05, 0.05, 1.0 }
+		};
+
+		WGPURenderPassDepthStencilAttachment depthStencilAttachment = {
+			.view = depthTextureView,
+			.depthClearValue = 1.0f,
+			.depthLoadOp = WGPULoadOp_Clear,
+			.depthStoreOp = WGPUStoreOp_Store,
+			.depthReadOnly = false,
+			// Stencil setup, mandatory but unused
+			.stencilClearValue = 0,
+			.stencilLoadOp = WGPULoadOp_Undefined,
+			.stencilStoreOp = WGPUStoreOp_Undefined,
+			.stencilReadOnly = true,
+		};
+
+		WGPURenderPassDescriptor renderPassDesc = {
+			.colorAttachmentCount = 1,
+			.colorAttachments = &renderPassColorAttachment,
+
+			.depthStencilAttachment = &depthStencilAttachment,
+			.timestampWriteCount = 0,
+			.timestampWrites = NULL
+		};
+		WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+
+		wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+		wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, geometryBuffers.vertexBuffer, 0, geometryBuffers.vertexDataSize);
+		wgpuRenderPassEncoderSetIndexBuffer(renderPass, geometryBuffers.indexBuffer, geometryBuffers.indexFormat, 0, geometryBuffers.indexDataSize);
+
+		if (instanced) {
+			wgpuRenderPassEncoderSetVertexBuffer(renderPass, 1, instances.buffer, 0, pyramidCount * sizeof(t_instance_data));
+			wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 0, NULL);
+			// Every pyramid at once: the instance index picks its attributes
+			wgpuRenderPassEncoderDrawIndexed(renderPass, geometryBuffers.indexCount, pyramidCount, 0, 0, 0);
+		} else {
+			for (size_t i = 0; i < pyramidCount; i++) {
+				uint32_t dynamicOffset = pushUniforms(&uniformRing, &pyramids[i], sizeof(t_instance_data));
+				if (dynamicOffset == UNIFORM_RING_FULL) break;
+				wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 1, &dynamicOffset);
+				wgpuRenderPassEncoderDrawIndexed(renderPass, geometryBuffers.indexCount, 1, 0, 0, 0);
+			}
+		}
+
+		wgpuRenderPassEncoderEnd(renderPass);
+
+		WGPUCommandBufferDescriptor cmdBufferDescriptor = {.label = "Command buffer"};
+		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+		if (!instanced) flushUniformRing(&uniformRing);
+		wgpuQueueSubmit(queue, 1, &command);
+		endFrame(&frames);
+		encodeTime += glfwGetTime() - encodeStart;
+		frameCount++;
+
+		wgpuSwapChainPresent(swapChain);
+	}
+
+	if (frameCount > 0) {
+		printf("Recording and submitting: %.3f ms per frame, %zu draw calls\n",
+			encodeTime / frameCount * 1e3, instanced ? (size_t)1 : pyramidCount);
+	}
+	releaseFramesInFlight(&frames);
+	if (!instanced) releaseUniformRing(&uniformRing);
+	releaseInstanceBuffer(&instances);
+
+	printPipelineRegistryStats();
+	releasePipelineRegistry();
+
+	printShaderRegistryStats();
+	releaseShaderRegistry();
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	return 0;
+}
@@ -0,0 +1,397 @@
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "helper_v3.h"
+#include "geometry_cache.h"
+#include "instance_buffer.h"
+#include "frames_in_flight.h"
+#include "uniform_ring.h"
+#include "wgsl_preprocessor.h"
+#include "shader_registry.h"
+#include "uniform_layout.h"
+
+// Draws N pyramids per frame two ways, for N from 1 up to a million: one draw
+// each with its uniforms at a dynamic offset (as dynamic_uniforms.c does), and
+// one instanced draw for all of them (as instancing.c does). Both upload every
+// pyramid's data each frame. "cpu" is the time to record and submit a frame,
+// "total" also waits for the GPU to finish it. Runs without a window or a GPU,
+// on SwiftShader or on the Null backend (which only measures the CPU side).
+// Usage: instancing_bench [swiftshader|null] [largest count] [frames]
+
+#define WIDTH 640
+#define HEIGHT 480
+// Per draw frames are split into command buffers of this many draws, so the
+// uniform ring stays a few MB whatever the count
+#define PER_DRAW_BATCH 16384
+
+#define FRAME_UNIFORMS(FIELD) \
+    FIELD(f32, time)
+UNIFORM_STRUCT(FrameUniforms, FRAME_UNIFORMS)
+
+typedef struct BenchTarget {
+    WGPUDevice device;
+    WGPUQueue queue;
+    WGPUTextureView colorView;
+    WGPUTextureView depthView;
+    t_geometry_buffers pyramid;
+    WGPUBuffer frameBuffer;
+} t_bench_target;
+
+typedef struct FrameTimes {
+    double cpu;
+    double total;
+} t_frame_times;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const WGPUVertexAttribute vertexAttribs[2] = {
+    {.shaderLocation = 0, .format = WGPUVertexFormat_Float32x3, .offset = 0},
+    {.shaderLocation = 1, .format = WGPUVertexFormat_Float32x3, .offset = 3 * sizeof(float)}
+};
+
+static const WGPUVertexBufferLayout vertexBufferLayout = {
+    .attributeCount = 2,
+    .attributes = vertexAttribs,
+    .arrayStride = 6 * sizeof(float),
+    .stepMode = WGPUVertexStepMode_Vertex
+};
+
+static WGPURenderPipeline createPipeline(WGPUDevice device, WGPUBindGroupLayout bindGroupLayout, bool instanced) {
+    static const t_wgsl_define instancedDefines[] = {{"INSTANCED", "1"}};
+    WGPUShaderModule shaderModule = loadShaderPermutation(device, RESOURCE_DIR "/instanced.wsl", instancedDefines, instanced ? 1 : 0);
+    if (!shaderModule) return NULL;
+    if (!checkShaderUniforms(RESOURCE_DIR "/instanced.wsl", instancedDefines, instanced ? 1 : 0, UNIFORM_LAYOUT(FrameUniforms)) ||
+        !checkShaderUniforms(RESOURCE_DIR "/instanced.wsl", instancedDefines, instanced ? 1 : 0, UNIFORM_LAYOUT(Instance))) {
+        return NULL;
+    }
+
+    WGPUVertexBufferLayout buffers[2] = {vertexBufferLayout, instanceBufferLayout};
+    WGPUConstantEntry vertexConstants[] = {
+        {.key = "aspectRatio", .value = (double)WIDTH / HEIGHT}
+    };
+    WGPUColorTargetState colorTarget = {
+        .format = WGPUTextureFormat_BGRA8Unorm,
+        .writeMask = WGPUColorWriteMask_All
+    };
+    WGPUFragmentState fragmentState = {
+        .module = shaderModule,
+        .entryPoint = "fs_main",
+        .targetCount = 1,
+        .targets = &colorTarget
+    };
+    WGPUDepthStencilState depthStencilState = DEFAULT_DEPTH_STENCIL;
+    depthStencilState.depthCompare = WGPUCompareFunction_Less;
+    depthStencilState.depthWriteEnabled = true;
+    depthStencilState.format = WGPUTextureFormat_Depth24Plus;
+    depthStencilState.stencilReadMask = 0;
+    depthStencilState.stencilWriteMask = 0;
+    WGPUPipelineLayoutDescriptor layoutDesc = {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = &bindGroupLayout
+    };
+    WGPUPipelineLayout layout = wgpuDeviceCreatePipelineLayout(device, &layoutDesc);
+    WGPURenderPipelineDescriptor pipelineDesc = {
+        .label = instanced ? "Instanced pyramids" : "Per draw pyramids",
+        .vertex = (WGPUVertexState){
+            .bufferCount = instanced ? 2 : 1,
+            .buffers = buffers,
+            .module = shaderModule,
+            .entryPoint = "vs_main",
+            .constantCount = 1,
+            .constants = vertexConstants
+        },
+        .primitive = (WGPUPrimitiveState){
+            .topology = WGPUPrimitiveTopology_TriangleList,
+            .stripIndexFormat = WGPUIndexFormat_Undefined,
+            .frontFace = WGPUFrontFace_CCW,
+            .cullMode = WGPUCullMode_None
+        },
+        .fragment = &fragmentState,
+        .depthStencil = &depthStencilState,
+        .multisample = (WGPUMultisampleState){
+            .count = 1,
+            .mask = ~0u,
+            .alphaToCoverageEnabled = false
+        },
+        .layout = layout
+    };
+    WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+    wgpuPipelineLayoutRelease(layout);
+    return pipeline;
+}
+
+// Frame uniforms at binding 0, and for the per draw pipeline each pyramid's
+// at binding 1 with a dynamic offset
+static WGPUBindGroupLayout createBindGroupLayout(WGPUDevice device, bool instanced) {
+    WGPUBindGroupLayoutEntry entries[2] = {BIND_GROUP_DEFAULT, BIND_GROUP_DEFAULT};
+    entries[0].binding = 0;
+    entries[0].visibility = WGPUShaderStage_Vertex;
+    entries[0].buffer.type = WGPUBufferBindingType_Uniform;
+    entries[0].buffer.minBindingSize = sizeof(FrameUniforms);
+    entries[1].binding = 1;
+    entries[1].visibility = WGPUShaderStage_Vertex;
+    entries[1].buffer.type = WGPUBufferBindingType_Uniform;
+    entries[1].buffer.minBindingSize = sizeof(t_instance_data);
+    entries[1].buffer.hasDynamicOffset = true;
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {
+        .entryCount = instanced ? 1 : 2,
+        .entries = entries
+    };
+    return wgpuDeviceCreateBindGroupLayout(device, &bindGroupLayoutDesc);
+}
+
+static WGPURenderPassEncoder beginPass(const t_bench_target * target, WGPUCommandEncoder encoder, bool clear) {
+    WGPURenderPassColorAttachment colorAttachment = {
+        .view = target->colorView,
+        .loadOp = clear ? WGPULoadOp_Clear : WGPULoadOp_Load,
+        .storeOp = WGPUStoreOp_Store,
+        .clearValue = (WGPUColor){ 0.05, 0.05, 0.05, 1.0 }
+    };
+    WGPURenderPassDepthStencilAttachment depthStencilAttachment = {
+        .view = target->depthView,
+        .depthClearValue = 1.0f,
+        .depthLoadOp = clear ? WGPULoadOp_Clear : WGPULoadOp_Load,
+        .depthStoreOp = WGPUStoreOp_Store,
+        .stencilLoadOp = WGPULoadOp_Undefined,
+        .stencilStoreOp = WGPUStoreOp_Undefined,
+        .stencilReadOnly = true
+    };
+    WGPURenderPassDescriptor renderPassDesc = {
+        .colorAttachmentCount = 1,
+        .colorAttachments = &colorAttachment,
+        .depthStencilAttachment = &depthStencilAttachment
+    };
+    WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+    wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, target->pyramid.vertexBuffer, 0, target->pyramid.vertexDataSize);
+    wgpuRenderPassEncoderSetIndexBuffer(renderPass, target->pyramid.indexBuffer, target->pyramid.indexFormat, 0, target->pyramid.indexDataSize);
+    return renderPass;
+}
+
+static void submitPass(const t_bench_target * target, WGPUCommandEncoder encoder, WGPURenderPassEncoder renderPass) {
+    wgpuRenderPassEncoderEnd(renderPass);
+    wgpuRenderPassEncoderRelease(renderPass);
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+    wgpuCommandEncoderRelease(encoder);
+    wgpuQueueSubmit(target->queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+}
+
+static void onWorkDone(WGPUQueueWorkDoneStatus status, void * userData) {
+    *(bool *)userData = true;
+}
+
+static void waitForGpu(const t_bench_target * target) {
+    bool done = false;
+    wgpuQueueOnSubmittedWorkDone(target->queue, 0, onWorkDone, &done);
+    while (!done) {
+        wgpuDeviceTick(target->device);
+        if (!done) usleep(50);
+    }
+}
+
+static void writeFrameUniforms(const t_bench_target * target, int frame) {
+    FrameUniforms frameUniforms = {.time = frame * 0.016f};
+    wgpuQueueWriteBuffer(target->queue, target->frameBuffer, 0, &frameUniforms, sizeof(frameUniforms));
+}
+
+static t_frame_times perDrawFrames(const t_bench_target * target, const t_instance_data * pyramids, size_t count, int frames) {
+    WGPUBindGroupLayout bindGroupLayout = createBindGroupLayout(target->device, false);
+    WGPURenderPipeline pipeline = createPipeline(target->device, bindGroupLayout, false);
+    // Each batch is a frame in flight of its own
+    t_frames_in_flight batches;
+    initFramesInFlight(&batches, target->device, 2);
+    t_uniform_ring ring;
+    // Slices are at most 256 bytes apart, two batches fit
+    if (!pipeline || !initUniformRing(&ring, &batches, 2 * PER_DRAW_BATCH * 256)) {
+        printf("can't set up the per draw path\n");
+        exit(1);
+    }
+    WGPUBindGroupEntry bindings[2] = {
+        {.binding = 0, .buffer = target->frameBuffer, .offset = 0, .size = sizeof(FrameUniforms)},
+        {.binding = 1, .buffer = ring.buffer, .offset = 0, .size = sizeof(t_instance_data)}
+    };
+    WGPUBindGroupDescriptor bindGroupDesc = {
+        .layout = bindGroupLayout,
+        .entryCount = 2,
+        .entries = bindings
+    };
+    WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(target->device, &bindGroupDesc);
+
+    t_frame_times times = {0};
+    // Frame 0 warms up and isn't counted
+    for (int frame = 0; frame <= frames; frame++) {
+        double start = now();
+        writeFrameUniforms(target, frame);
+        for (size_t first = 0; first < count; first += PER_DRAW_BATCH) {
+            beginFrame(&batches);
+            WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(target->device, NULL);
+            WGPURenderPassEncoder renderPass = beginPass(target, encoder, first == 0);
+            wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+            size_t last = first + PER_DRAW_BATCH < count ? first + PER_DRAW_BATCH : count;
+            for (size_t i = first; i < last; i++) {
+                uint32_t dynamicOffset = pushUniforms(&ring, &pyramids[i], sizeof(t_instance_data));
+                wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 1, &dynamicOffset);
+                wgpuRenderPassEncoderDrawIndexed(renderPass, target->pyramid.indexCount, 1, 0, 0, 0);
+            }
+            flushUniformRing(&ring);
+            submitPass(target, encoder, renderPass);
+            endFrame(&batches);
+        }
+        double submitted = now();
+        waitForGpu(target);
+        if (frame > 0) {
+            times.cpu += submitted - start;
+            times.total += now() - start;
+        }
+    }
+
+    wgpuBindGroupRelease(bindGroup);
+    releaseFramesInFlight(&batches);
+    releaseUniformRing(&ring);
+    wgpuRenderPipelineRelease(pipeline);
+    wgpuBindGroupLayoutRelease(bindGroupLayout);
+    times.cpu /= frames;
+    times.total /= frames;
+    return times;
+}
+
+static t_frame_times instancedFrames(const t_bench_target * target, const t_instance_data * pyramids, size_t count, int frames) {
+    WGPUBindGroupLayout bindGroupLayout = createBindGroupLayout(target->device, true);
+    WGPURenderPipeline pipeline = createPipeline(target->device, bindGroupLayout, true);
+    t_instance_buffer instances;
+    if (!pipeline || !initInstanceBuffer(&instances, target->device, count)) {
+        printf("can't set up the instanced path\n");
+        exit(1);
+    }
+    WGPUBindGroupEntry binding = {.binding = 0, .buffer = target->frameBuffer, .offset = 0, .size = sizeof(FrameUniforms)};
+    WGPUBindGroupDescriptor bindGroupDesc = {
+        .layout = bindGroupLayout,
+        .entryCount = 1,
+        .entries = &binding
+    };
+    WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(target->device, &bindGroupDesc);
+
+    t_frame_times times = {0};
+    for (int frame = 0; frame <= frames; frame++) {
+        double start = now();
+        writeFrameUniforms(target, frame);
+        // The same copy the per draw path makes, into one array
+        clearInstances(&instances);
+        t_instance_data *data = addInstances(&instances, count);
+        if (!data) exit(1);
+        memcpy(data, pyramids, count * sizeof(t_instance_data));
+        WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(target->device, NULL);
+        WGPURenderPassEncoder renderPass = beginPass(target, encoder, true);
+        flushInstanceBuffer(&instances);
+        wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+        wgpuRenderPassEncoderSetVertexBuffer(renderPass, 1, instances.buffer, 0, count * sizeof(t_instance_data));
+        wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroup, 0, NULL);
+        wgpuRenderPassEncoderDrawIndexed(renderPass, target->pyramid.indexCount, count, 0, 0, 0);
+        submitPass(target, encoder, renderPass);
+        double submitted = now();
+        waitForGpu(target);
+        if (frame > 0) {
+            times.cpu += submitted - start;
+            times.total += now() - start;
+        }
+    }
+
+    wgpuBindGroupRelease(bindGroup);
+    releaseInstanceBuffer(&instances);
+    wgpuRenderPipelineRelease(pipeline);
+    wgpuBindGroupLayoutRelease(bindGroupLayout);
+    times.cpu /= frames;
+    times.total /= frames;
+    return times;
+}
+
+static WGPUTextureView createTargetView(WGPUDevice device, WGPUTextureFormat format) {
+    WGPUTextureDescriptor textureDesc = {
+        .dimension = WGPUTextureDimension_2D,
+        .format = format,
+        .mipLevelCount = 1,
+        .sampleCount = 1,
+        .size = {WIDTH, HEIGHT, 1},
+        .usage = WGPUTextureUsage_RenderAttachment
+    };
+    WGPUTexture texture = wgpuDeviceCreateTexture(device, &textureDesc);
+    WGPUTextureView view = wgpuTextureCreateView(texture, NULL);
+    // The view keeps the texture alive
+    wgpuTextureRelease(texture);
+    return view;
+}
+
+int main(int argc, char *argv[]) {
+    bool swiftShader = argc < 2 || strcmp(argv[1], "null") != 0;
+    size_t largest = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    int frames = argc > 3 ? atoi(argv[3]) : 3;
+    if (frames < 1) frames = 1;
+
+    WGPUInstanceDescriptor desc = { .nextInChain = NULL};
+    WGPUInstance instance = wgpuCreateInstance(&desc);
+    // SwiftShader is Dawn's fallback Vulkan adapter
+    WGPURequestAdapterOptions adapterOpts = {
+        .backendType = swiftShader ? WGPUBackendType_Vulkan : WGPUBackendType_Null,
+        .forceFallbackAdapter = swiftShader
+    };
+    WGPUAdapter adapter = instance ? requestAdapter(instance, &adapterOpts) : NULL;
+    if (!adapter) {
+        printf("No %s adapter.\n", swiftShader ? "SwiftShader" : "Null");
+        return 1;
+    }
+    WGPUDeviceDescriptor deviceDesc = {.label = "Instancing bench device"};
+    t_bench_target target = {.device = requestDevice(adapter, &deviceDesc)};
+    wgpuDeviceSetUncapturedErrorCallback(target.device, cCallback, NULL);
+    target.queue = wgpuDeviceGetQueue(target.device);
+    target.colorView = createTargetView(target.device, WGPUTextureFormat_BGRA8Unorm);
+    target.depthView = createTargetView(target.device, WGPUTextureFormat_Depth24Plus);
+    if (!loadGeometryBuffers(target.device, RESOURCE_DIR "/pyramid.txt", &vertexBufferLayout, &target.pyramid)) {
+        printf("Could not load geometry!\n");
+        return 1;
+    }
+    WGPUBufferDescriptor bufferDesc = {
+        .size = sizeof(FrameUniforms),
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .mappedAtCreation = false
+    };
+    target.frameBuffer = wgpuDeviceCreateBuffer(target.device, &bufferDesc);
+
+    printf("%s backend, %d frames of %u indices per pyramid\n", swiftShader ? "SwiftShader" : "Null", frames, target.pyramid.indexCount);
+    printf("%9s  %25s  %25s  %13s\n", "pyramids", "per draw: cpu, total ms", "instanced: cpu, total ms", "speedup");
+    for (size_t count = 1; count <= largest; count *= 10) {
+        t_instance_data *pyramids = malloc(count * sizeof(t_instance_data));
+        if (!pyramids) {
+            printf("Memory Allocation failed.\n");
+            return 1;
+        }
+        layoutInstanceGrid(pyramids, count, (float)WIDTH / HEIGHT);
+        t_frame_times perDraw = perDrawFrames(&target, pyramids, count, frames);
+        t_frame_times instanced = instancedFrames(&target, pyramids, count, frames);
+        printf("%9zu  %12.3f %12.3f  %12.3f %12.3f  %6.1fx %6.1fx\n", count,
+            perDraw.cpu * 1e3, perDraw.total * 1e3, instanced.cpu * 1e3, instanced.total * 1e3,
+            perDraw.cpu / instanced.cpu, perDraw.total / instanced.total);
+        fflush(stdout);
+        free(pyramids);
+    }
+
+    wgpuBufferRelease(target.frameBuffer);
+    wgpuBufferRelease(target.pyramid.vertexBuffer);
+    wgpuBufferRelease(target.pyramid.indexBuffer);
+    wgpuTextureViewRelease(target.colorView);
+    wgpuTextureViewRelease(target.depthView);
+    releaseShaderRegistry();
+    wgpuDeviceRelease(target.device);
+    wgpuAdapterRelease(adapter);
+    wgpuInstanceRelease(instance);
+    return 0;
+}
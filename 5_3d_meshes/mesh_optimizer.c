@@ -0,0 +1,395 @@
+#include <webgpu/webgpu.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_optimizer.h"
+
+#define NO_VERTEX UINT32_MAX
+
+//  ------------------------------- Index access------------------------------------------------------------------
+// The passes work on a uint32_t copy of the indices, whatever the format.
+
+static size_t indexCount(const t_geometry_data * geometry_data) {
+    return geometry_data->indexDataSize / indexFormatSize(geometry_data->indexFormat);
+}
+
+static size_t vertexCount(const t_geometry_data * geometry_data, size_t vertexStride) {
+    return vertexStride ? geometry_data->pointDataSize / vertexStride : 0;
+}
+
+static void writeIndices(t_geometry_data * geometry_data, const uint32_t * indices, size_t count) {
+    if (geometry_data->indexFormat == WGPUIndexFormat_Uint32) {
+        memcpy(geometry_data->indexData, indices, count * sizeof(uint32_t));
+    } else {
+        uint16_t *narrow = geometry_data->indexData;
+        for (size_t i = 0; i < count; i++) narrow[i] = indices[i];
+    }
+}
+
+// The passes index arrays with the indices, so they have to be in range
+static bool checkIndices(const uint32_t * indices, size_t count, size_t vertices) {
+    for (size_t i = 0; i < count; i++) {
+        if (indices[i] >= vertices) {
+            printf("Index %u is out of range (%zu vertices), geometry left as is.\n", indices[i], vertices);
+            return false;
+        }
+    }
+    return true;
+}
+
+//  ------------------------------- Analysis------------------------------------------------------------------
+
+void analyzeVertexCache(const t_geometry_data * geometry_data, size_t vertexStride, size_t cacheSize, t_vertex_cache_stats * stats) {
+    *stats = (t_vertex_cache_stats){0};
+    size_t count = indexCount(geometry_data);
+    size_t vertices = vertexCount(geometry_data, vertexStride);
+    uint32_t *indices = getGeometryIndices(geometry_data, &count);
+    // cachedAt[v] is the miss count when v entered the cache, 0 if never
+    size_t *cachedAt = calloc(vertices ? vertices : 1, sizeof(size_t));
+    if (!indices || !cachedAt || !checkIndices(indices, count, vertices)) {
+        free(indices);
+        free(cachedAt);
+        return;
+    }
+
+    size_t misses = 0;
+    size_t referenced = 0;
+    size_t triangleIndices = count - count % 3;
+    for (size_t i = 0; i < triangleIndices; i++) {
+        uint32_t v = indices[i];
+        if (cachedAt[v] && misses - cachedAt[v] < cacheSize) continue;
+        if (!cachedAt[v]) referenced++;
+        cachedAt[v] = ++misses;
+    }
+
+    stats->triangleCount = triangleIndices / 3;
+    stats->vertexCount = referenced;
+    stats->transformedCount = misses;
+    stats->acmr = stats->triangleCount ? (float)misses / stats->triangleCount : 0;
+    stats->atvr = referenced ? (float)misses / referenced : 0;
+    free(indices);
+    free(cachedAt);
+}
+
+//  ------------------------------- Vertex cache------------------------------------------------------------------
+// Tipsify fans out around one vertex at a time, emitting all its remaining
+// triangles, then moves on to the neighbour that will still be in the cache
+// once its own fan is done. When there is none it falls back on recently used
+// vertices (the dead-end stack), then on the next vertex in input order.
+
+typedef struct Tipsify {
+    const uint32_t * indices;
+    size_t vertexCount;
+    size_t cacheSize;
+    uint32_t * adjacencyOffsets;    // triangles of vertex v: adjacency[adjacencyOffsets[v]..[v+1]]
+    uint32_t * adjacency;
+    uint32_t * liveTriangles;       // triangles not emitted yet, per vertex
+    size_t * cacheTime;
+    bool * emitted;
+    uint32_t * deadEnd;
+    size_t deadEndCount;
+    uint32_t * candidates;          // vertices of the current fan
+    size_t candidateCount;
+    size_t time;
+    size_t cursor;                  // next vertex in input order to restart from
+} t_tipsify;
+
+static bool buildAdjacency(t_tipsify * tipsify, size_t triangleCount) {
+    size_t vertices = tipsify->vertexCount;
+    tipsify->adjacencyOffsets = calloc(vertices + 1, sizeof(uint32_t));
+    tipsify->adjacency = malloc((triangleCount ? triangleCount : 1) * 3 * sizeof(uint32_t));
+    tipsify->liveTriangles = calloc(vertices ? vertices : 1, sizeof(uint32_t));
+    if (!tipsify->adjacencyOffsets || !tipsify->adjacency || !tipsify->liveTriangles) return false;
+
+    for (size_t i = 0; i < triangleCount * 3; i++) tipsify->liveTriangles[tipsify->indices[i]]++;
+    size_t maxDegree = 0;
+    for (size_t v = 0; v < vertices; v++) {
+        tipsify->adjacencyOffsets[v + 1] = tipsify->adjacencyOffsets[v] + tipsify->liveTriangles[v];
+        if (tipsify->liveTriangles[v] > maxDegree) maxDegree = tipsify->liveTriangles[v];
+    }
+    // Fill from the end of each range, leaving adjacencyOffsets[v] on its start
+    for (size_t v = 0; v < vertices; v++) tipsify->adjacencyOffsets[v] = tipsify->adjacencyOffsets[v + 1];
+    for (size_t t = triangleCount; t-- > 0;) {
+        for (int k = 0; k < 3; k++) {
+            tipsify->adjacency[--tipsify->adjacencyOffsets[tipsify->indices[t * 3 + k]]] = t;
+        }
+    }
+    tipsify->candidates = malloc((maxDegree ? maxDegree : 1) * 3 * sizeof(uint32_t));
+    return tipsify->candidates != NULL;
+}
+
+static uint32_t skipDeadEnd(t_tipsify * tipsify) {
+    while (tipsify->deadEndCount > 0) {
+        uint32_t v = tipsify->deadEnd[--tipsify->deadEndCount];
+        if (tipsify->liveTriangles[v] > 0) return v;
+    }
+    while (tipsify->cursor < tipsify->vertexCount) {
+        uint32_t v = tipsify->cursor++;
+        if (tipsify->liveTriangles[v] > 0) return v;
+    }
+    return NO_VERTEX;
+}
+
+static uint32_t nextFanVertex(t_tipsify * tipsify) {
+    uint32_t best = NO_VERTEX;
+    size_t bestPriority = 0;
+    for (size_t i = 0; i < tipsify->candidateCount; i++) {
+        uint32_t v = tipsify->candidates[i];
+        if (tipsify->liveTriangles[v] == 0) continue;
+        // Oldest vertex that survives its own fan, else any live one
+        size_t age = tipsify->time - tipsify->cacheTime[v];
+        size_t priority = age + 2 * tipsify->liveTriangles[v] <= tipsify->cacheSize ? age : 0;
+        if (best == NO_VERTEX || priority > bestPriority) {
+            best = v;
+            bestPriority = priority;
+        }
+    }
+    return best != NO_VERTEX ? best : skipDeadEnd(tipsify);
+}
+
+static void emitFan(t_tipsify * tipsify, uint32_t fan, uint32_t * out, size_t * outCount) {
+    tipsify->candidateCount = 0;
+    for (uint32_t a = tipsify->adjacencyOffsets[fan]; a < tipsify->adjacencyOffsets[fan + 1]; a++) {
+        uint32_t t = tipsify->adjacency[a];
+        if (tipsify->emitted[t]) continue;
+        tipsify->emitted[t] = true;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = tipsify->indices[t * 3 + k];
+            out[(*outCount)++] = v;
+            tipsify->deadEnd[tipsify->deadEndCount++] = v;
+            tipsify->candidates[tipsify->candidateCount++] = v;
+            tipsify->liveTriangles[v]--;
+            if (tipsify->time - tipsify->cacheTime[v] > tipsify->cacheSize) {
+                tipsify->cacheTime[v] = tipsify->time++;
+            }
+        }
+    }
+}
+
+static void freeTipsify(t_tipsify * tipsify) {
+    free(tipsify->adjacencyOffsets);
+    free(tipsify->adjacency);
+    free(tipsify->liveTriangles);
+    free(tipsify->cacheTime);
+    free(tipsify->emitted);
+    free(tipsify->deadEnd);
+    free(tipsify->candidates);
+}
+
+bool optimizeVertexCache(t_geometry_data * geometry_data, size_t vertexStride, size_t cacheSize) {
+    size_t count = indexCount(geometry_data);
+    size_t triangleCount = count / 3;
+    size_t vertices = vertexCount(geometry_data, vertexStride);
+    if (triangleCount < 2) return true;
+    if (triangleCount > UINT32_MAX / 3 || vertices >= NO_VERTEX) {
+        printf("Mesh too large to optimize, geometry left as is.\n");
+        return false;
+    }
+    uint32_t *indices = getGeometryIndices(geometry_data, &count);
+    if (!indices) return false;
+    if (!checkIndices(indices, count, vertices)) {
+        free(indices);
+        return false;
+    }
+
+    t_tipsify tipsify = {
+        .indices = indices,
+        .vertexCount = vertices,
+        .cacheSize = cacheSize,
+        .cacheTime = calloc(vertices, sizeof(size_t)),
+        .emitted = calloc(triangleCount, sizeof(bool)),
+        .deadEnd = malloc(triangleCount * 3 * sizeof(uint32_t)),
+        // cacheTime 0 must read as "not cached"
+        .time = cacheSize + 1
+    };
+    uint32_t *out = malloc(count * sizeof(uint32_t));
+    if (!out || !tipsify.cacheTime || !tipsify.emitted || !tipsify.deadEnd || !buildAdjacency(&tipsify, triangleCount)) {
+        printf("Memory Allocation failed.\n");
+        freeTipsify(&tipsify);
+        free(indices);
+        free(out);
+        return false;
+    }
+
+    size_t outCount = 0;
+    for (uint32_t fan = skipDeadEnd(&tipsify); fan != NO_VERTEX; fan = nextFanVertex(&tipsify)) {
+        emitFan(&tipsify, fan, out, &outCount);
+    }
+    // A trailing incomplete triangle stays where it was
+    memcpy(out + outCount, indices + outCount, (count - outCount) * sizeof(uint32_t));
+    writeIndices(geometry_data, out, count);
+
+    freeTipsify(&tipsify);
+    free(indices);
+    free(out);
+    return true;
+}
+
+//  ------------------------------- Vertex fetch------------------------------------------------------------------
+
+bool optimizeVertexFetch(t_geometry_data * geometry_data, size_t vertexStride) {
+    size_t count = indexCount(geometry_data);
+    size_t vertices = vertexCount(geometry_data, vertexStride);
+    if (vertices == 0) return true;
+    if (vertices >= NO_VERTEX) {
+        printf("Mesh too large to optimize, geometry left as is.\n");
+        return false;
+    }
+    uint32_t *indices = getGeometryIndices(geometry_data, &count);
+    uint32_t *remap = malloc(vertices * sizeof(uint32_t));
+    char *points = malloc(geometry_data->pointDataSize);
+    bool allocated = indices && remap && points;
+    if (!allocated) printf("Memory Allocation failed.\n");
+    if (!allocated || !checkIndices(indices, count, vertices)) {
+        free(indices);
+        free(remap);
+        free(points);
+        return false;
+    }
+
+    memset(remap, 0xff, vertices * sizeof(uint32_t));
+    uint32_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (remap[indices[i]] == NO_VERTEX) remap[indices[i]] = next++;
+        indices[i] = remap[indices[i]];
+    }
+    for (size_t v = 0; v < vertices; v++) {
+        if (remap[v] == NO_VERTEX) remap[v] = next++;
+    }
+
+    const char *oldPoints = (const char *)geometry_data->pointData;
+    for (size_t v = 0; v < vertices; v++) {
+        memcpy(points + remap[v] * vertexStride, oldPoints + v * vertexStride, vertexStride);
+    }
+    // Bytes past the last whole vertex, if any, stay put
+    size_t vertexBytes = vertices * vertexStride;
+    memcpy(points + vertexBytes, oldPoints + vertexBytes, geometry_data->pointDataSize - vertexBytes);
+    free(geometry_data->pointData);
+    geometry_data->pointData = (float *)points;
+    writeIndices(geometry_data, indices, count);
+
+    free(indices);
+    free(remap);
+    return true;
+}
+
+//  ------------------------------- Welding------------------------------------------------------------------
+// Open addressing hash table of vertex ids, keyed on the vertex contents.
+
+typedef struct WeldTable {
+    const float * points;
+    size_t componentCount;  // floats per vertex
+    float epsilon;
+    int64_t * key;          // scratch keys of the vertex being looked up...
+    int64_t * otherKey;     // ...and of the one it is compared to
+    uint32_t * slots;
+    size_t mask;
+} t_weld_table;
+
+// Exact keys are the float bits, with -0 folded into +0.
+// Otherwise the component rounded to a multiple of epsilon.
+static void vertexKey(const t_weld_table * table, uint32_t vertex, int64_t * key) {
+    const float *p = table->points + vertex * table->componentCount;
+    for (size_t i = 0; i < table->componentCount; i++) {
+        if (table->epsilon > 0) {
+            key[i] = llroundf(p[i] / table->epsilon);
+        } else {
+            float value = p[i] == 0 ? 0 : p[i];
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            key[i] = bits;
+        }
+    }
+}
+
+// Returns the id already in the table for an equal vertex, or inserts id and returns it
+static uint32_t findOrInsert(t_weld_table * table, uint32_t vertex, uint32_t id) {
+    size_t keySize = table->componentCount * sizeof(int64_t);
+    vertexKey(table, vertex, table->key);
+    for (size_t slot = hashBytes(table->key, keySize, 0) & table->mask;; slot = (slot + 1) & table->mask) {
+        if (table->slots[slot] == NO_VERTEX) {
+            table->slots[slot] = id;
+            return id;
+        }
+        // Stored ids are positions in the compacted points, already written
+        vertexKey(table, table->slots[slot], table->otherKey);
+        if (memcmp(table->key, table->otherKey, keySize) == 0) return table->slots[slot];
+    }
+}
+
+bool weldVertices(t_geometry_data * geometry_data, size_t vertexStride, float epsilon, size_t * uniqueCount) {
+    size_t vertices = vertexCount(geometry_data, vertexStride);
+    if (vertexStride == 0 || vertexStride % sizeof(float) != 0 || geometry_data->pointDataSize % vertexStride != 0) {
+        printf("Points don't split into %zu byte vertices, geometry left as is.\n", vertexStride);
+        return false;
+    }
+    if (vertices >= NO_VERTEX / 2) {
+        printf("Mesh too large to optimize, geometry left as is.\n");
+        return false;
+    }
+    // No indices: every vertex is used once, in order
+    bool soup = geometry_data->indexDataSize == 0;
+    size_t count = soup ? vertices : indexCount(geometry_data);
+    uint32_t *indices = soup ? malloc((count ? count : 1) * sizeof(uint32_t)) : getGeometryIndices(geometry_data, &count);
+    if (!indices) return false;
+    if (soup) {
+        for (size_t i = 0; i < count; i++) indices[i] = i;
+    } else if (!checkIndices(indices, count, vertices)) {
+        free(indices);
+        return false;
+    }
+
+    size_t capacity = 16;
+    while (capacity < vertices * 2) capacity *= 2;
+    size_t componentCount = vertexStride / sizeof(float);
+    t_weld_table table = {
+        .points = geometry_data->pointData,
+        .componentCount = componentCount,
+        .epsilon = epsilon,
+        .key = malloc(componentCount * sizeof(int64_t)),
+        .otherKey = malloc(componentCount * sizeof(int64_t)),
+        .slots = malloc(capacity * sizeof(uint32_t)),
+        .mask = capacity - 1
+    };
+    uint32_t *remap = malloc((vertices ? vertices : 1) * sizeof(uint32_t));
+    bool success = table.key && table.otherKey && table.slots && remap;
+    if (!success) printf("Memory Allocation failed.\n");
+
+    // Compact the unique vertices to the front of pointData as we go. A
+    // vertex only ever moves down, over one that was already looked up.
+    uint32_t unique = 0;
+    if (success) {
+        memset(table.slots, 0xff, capacity * sizeof(uint32_t));
+        char *points = (char *)geometry_data->pointData;
+        for (uint32_t v = 0; v < vertices; v++) {
+            if (unique != v) memcpy(points + unique * vertexStride, points + v * vertexStride, vertexStride);
+            remap[v] = findOrInsert(&table, unique, unique);
+            if (remap[v] == unique) unique++;
+        }
+        for (size_t i = 0; i < count; i++) indices[i] = remap[indices[i]];
+        success = setGeometryIndices(geometry_data, indices, count);
+    }
+    if (success) {
+        geometry_data->pointDataSize = unique * vertexStride;
+        float *points = realloc(geometry_data->pointData, geometry_data->pointDataSize ? geometry_data->pointDataSize : 1);
+        if (points) geometry_data->pointData = points;
+        if (uniqueCount) *uniqueCount = unique;
+    }
+
+    free(table.key);
+    free(table.otherKey);
+    free(table.slots);
+    free(remap);
+    free(indices);
+    return success;
+}
+
+bool optimizeGeometry(t_geometry_data * geometry_data, size_t vertexStride, t_vertex_cache_stats * before, t_vertex_cache_stats * after) {
+    if (before) analyzeVertexCache(geometry_data, vertexStride, MESH_OPTIMIZER_CACHE_SIZE, before);
+    bool success = optimizeVertexCache(geometry_data, vertexStride, MESH_OPTIMIZER_CACHE_SIZE) &&
+        optimizeVertexFetch(geometry_data, vertexStride);
+    if (after) analyzeVertexCache(geometry_data, vertexStride, MESH_OPTIMIZER_CACHE_SIZE, after);
+    return success;
+}
@@ -0,0 +1,49 @@
+#ifndef MESH_OPTIMIZER_HEADER_FILE
+#define MESH_OPTIMIZER_HEADER_FILE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "helper_v3.h"
+
+//  ------------------------------- Mesh optimizer------------------------------------------------------------------
+// Passes run on a loaded t_geometry_data before it goes to the GPU.
+// They draw exactly the same triangles after, except weldVertices with an
+// epsilon, which may move vertices by less than epsilon per component: a
+// vertex snaps to the first one of its cell, anywhere in that cell.
+//
+// vertexStride is the size of one vertex in pointData, in bytes (the
+// arrayStride of the vertex buffer layout).
+
+// Post-transform cache size the passes optimize for and measure with.
+// Real GPUs behave roughly like a FIFO of 16-32 entries.
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+
+typedef struct VertexCacheStats {
+    size_t triangleCount;
+    size_t vertexCount;         // vertices referenced by the indices
+    size_t transformedCount;    // cache misses, i.e. vertex shader invocations
+    float acmr;                 // misses per triangle: 0.5 at best, 3 at worst
+    float atvr;                 // misses per vertex: 1 at best
+} t_vertex_cache_stats;
+
+// Simulates a FIFO post-transform cache of cacheSize entries over the index buffer
+void analyzeVertexCache(const t_geometry_data * geometry_data, size_t vertexStride, size_t cacheSize, t_vertex_cache_stats * stats);
+
+// Reorders triangles for post-transform cache hits (Tipsify, Sander et al. 2007)
+bool optimizeVertexCache(t_geometry_data * geometry_data, size_t vertexStride, size_t cacheSize);
+
+// Reorders vertices in the order the indices first use them, so fetches walk
+// pointData forward, and remaps indexData to match. Unused vertices go last.
+bool optimizeVertexFetch(t_geometry_data * geometry_data, size_t vertexStride);
+
+// Both of the above, with the cache stats before and after (either may be NULL)
+bool optimizeGeometry(t_geometry_data * geometry_data, size_t vertexStride, t_vertex_cache_stats * before, t_vertex_cache_stats * after);
+
+// Merges vertices whose records are equal, bit for bit (epsilon = 0) or once
+// every component is rounded to a multiple of epsilon, and remaps the indices.
+// The first of each set of duplicates is kept. A geometry without indices is
+// taken as a triangle soup and gets an index buffer, so it can be drawn with
+// DrawIndexed. uniqueCount (may be NULL) receives the vertices left.
+bool weldVertices(t_geometry_data * geometry_data, size_t vertexStride, float epsilon, size_t * uniqueCount);
+
+#endif
@@ -0,0 +1,451 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_simplifier.h"
+
+#define REMOVED UINT32_MAX
+
+//  ------------------------------- Quadrics------------------------------------------------------------------
+// Symmetric 4x4 matrix of the sum of squared distances to a set of planes,
+// weighted by triangle area. Dividing by the total weight makes it an average
+// squared distance: the cost collapses are ordered by. Being an average, a
+// single plane may be much farther, so the error levels report is measured on
+// the result instead (see maxVertexDistance()).
+
+typedef struct Quadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+} t_quadric;
+
+static void addPlane(t_quadric * q, const double * n, double d, double weight) {
+    q->a2 += weight * n[0] * n[0];
+    q->ab += weight * n[0] * n[1];
+    q->ac += weight * n[0] * n[2];
+    q->ad += weight * n[0] * d;
+    q->b2 += weight * n[1] * n[1];
+    q->bc += weight * n[1] * n[2];
+    q->bd += weight * n[1] * d;
+    q->c2 += weight * n[2] * n[2];
+    q->cd += weight * n[2] * d;
+    q->d2 += weight * d * d;
+    q->weight += weight;
+}
+
+static void addQuadric(t_quadric * q, const t_quadric * other) {
+    q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+    q->c2 += other->c2; q->cd += other->cd;
+    q->d2 += other->d2;
+    q->weight += other->weight;
+}
+
+static double quadricError(const t_quadric * q, const float * p) {
+    double x = p[0], y = p[1], z = p[2];
+    double error = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z + q->d2 +
+        2 * (q->ab * x * y + q->ac * x * z + q->ad * x + q->bc * y * z + q->bd * y + q->cd * z);
+    return q->weight > 0 && error > 0 ? error / q->weight : 0;
+}
+
+//  ------------------------------- Simplification------------------------------------------------------------------
+
+typedef struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double error;
+} t_collapse;
+
+typedef struct Simplifier {
+    const t_geometry_data * geometry_data;
+    size_t vertexStride;
+    size_t vertexCount;
+    uint32_t * triangles;       // 3 indices per triangle, REMOVED once degenerate
+    size_t triangleCount;       // including the removed ones, until compacted
+    t_quadric * quadrics;
+    bool * locked;              // border vertices
+    uint32_t * adjacencyOffsets;
+    uint32_t * adjacency;       // triangles around each vertex
+    uint32_t * touched;         // pass that last changed the neighbourhood of a vertex
+    t_collapse * collapses;
+    uint32_t * representatives; // vertex each one was collapsed onto, itself if none
+} t_simplifier;
+
+static const float * position(const t_simplifier * s, uint32_t vertex) {
+    return (const float *)((const char *)s->geometry_data->pointData + vertex * s->vertexStride);
+}
+
+static void triangleNormal(const float * p0, const float * p1, const float * p2, double * n) {
+    double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static void buildAdjacency(t_simplifier * s) {
+    memset(s->adjacencyOffsets, 0, (s->vertexCount + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < s->triangleCount * 3; i++) s->adjacencyOffsets[s->triangles[i] + 1]++;
+    for (size_t v = 0; v < s->vertexCount; v++) s->adjacencyOffsets[v + 1] += s->adjacencyOffsets[v];
+    for (size_t t = 0; t < s->triangleCount; t++) {
+        for (int k = 0; k < 3; k++) s->adjacency[s->adjacencyOffsets[s->triangles[t * 3 + k]]++] = t;
+    }
+    // The fill moved every offset to the start of the next vertex
+    memmove(s->adjacencyOffsets + 1, s->adjacencyOffsets, s->vertexCount * sizeof(uint32_t));
+    s->adjacencyOffsets[0] = 0;
+}
+
+static void computeQuadrics(t_simplifier * s) {
+    for (size_t t = 0; t < s->triangleCount; t++) {
+        const uint32_t *triangle = &s->triangles[t * 3];
+        const float *p0 = position(s, triangle[0]);
+        double n[3];
+        triangleNormal(p0, position(s, triangle[1]), position(s, triangle[2]), n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0) continue;
+        for (int k = 0; k < 3; k++) n[k] /= length;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        // length is twice the area
+        for (int k = 0; k < 3; k++) addPlane(&s->quadrics[triangle[k]], n, d, length / 2);
+    }
+}
+
+// An edge used by a single triangle is on the border
+static void findBorders(t_simplifier * s) {
+    for (uint32_t v = 0; v < s->vertexCount; v++) {
+        for (uint32_t a = s->adjacencyOffsets[v]; !s->locked[v] && a < s->adjacencyOffsets[v + 1]; a++) {
+            const uint32_t *triangle = &s->triangles[s->adjacency[a] * 3];
+            for (int k = 0; k < 3; k++) {
+                uint32_t w = triangle[k];
+                if (w == v) continue;
+                int shared = 0;
+                for (uint32_t b = s->adjacencyOffsets[v]; b < s->adjacencyOffsets[v + 1]; b++) {
+                    const uint32_t *other = &s->triangles[s->adjacency[b] * 3];
+                    shared += other[0] == w || other[1] == w || other[2] == w;
+                }
+                if (shared == 1) s->locked[v] = true;
+            }
+        }
+    }
+}
+
+// Cheapest neighbour to collapse vertex onto
+static bool bestCollapse(const t_simplifier * s, uint32_t vertex, t_collapse * collapse) {
+    bool found = false;
+    for (uint32_t a = s->adjacencyOffsets[vertex]; a < s->adjacencyOffsets[vertex + 1]; a++) {
+        const uint32_t *triangle = &s->triangles[s->adjacency[a] * 3];
+        for (int k = 0; k < 3; k++) {
+            uint32_t to = triangle[k];
+            if (to == vertex) continue;
+            t_quadric q = s->quadrics[vertex];
+            addQuadric(&q, &s->quadrics[to]);
+            double error = quadricError(&q, position(s, to));
+            if (!found || error < collapse->error) {
+                *collapse = (t_collapse){vertex, to, error};
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+// Moving from onto to must not turn any remaining triangle around
+static bool flipsTriangle(const t_simplifier * s, uint32_t from, uint32_t to) {
+    for (uint32_t a = s->adjacencyOffsets[from]; a < s->adjacencyOffsets[from + 1]; a++) {
+        const uint32_t *triangle = &s->triangles[s->adjacency[a] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+        const float *before[3], *after[3];
+        for (int k = 0; k < 3; k++) {
+            before[k] = position(s, triangle[k]);
+            after[k] = triangle[k] == from ? position(s, to) : before[k];
+        }
+        double n0[3], n1[3];
+        triangleNormal(before[0], before[1], before[2], n0);
+        triangleNormal(after[0], after[1], after[2], n1);
+        // (a triangle that was already flat has no side to flip to)
+        if (n0[0] == 0 && n0[1] == 0 && n0[2] == 0) continue;
+        if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0) return true;
+    }
+    return false;
+}
+
+// Returns the number of triangles the collapse removed
+static size_t applyCollapse(t_simplifier * s, const t_collapse * collapse, uint32_t pass) {
+    size_t removed = 0;
+    for (uint32_t a = s->adjacencyOffsets[collapse->from]; a < s->adjacencyOffsets[collapse->from + 1]; a++) {
+        uint32_t *triangle = &s->triangles[s->adjacency[a] * 3];
+        bool degenerate = triangle[0] == collapse->to || triangle[1] == collapse->to || triangle[2] == collapse->to;
+        for (int k = 0; k < 3; k++) {
+            s->touched[triangle[k]] = pass;
+            if (triangle[k] == collapse->from) triangle[k] = collapse->to;
+        }
+        if (degenerate) {
+            triangle[0] = triangle[1] = triangle[2] = REMOVED;
+            removed++;
+        }
+    }
+    addQuadric(&s->quadrics[collapse->to], &s->quadrics[collapse->from]);
+    return removed;
+}
+
+// The vertex that vertex ended up merged into, shortening the path on the way
+static uint32_t findRepresentative(uint32_t * representatives, uint32_t vertex) {
+    uint32_t root = vertex;
+    while (representatives[root] != root) root = representatives[root];
+    while (representatives[vertex] != root) {
+        uint32_t next = representatives[vertex];
+        representatives[vertex] = root;
+        vertex = next;
+    }
+    return root;
+}
+
+static double dot(const double * a, const double * b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Distance from p to the closest point of triangle abc (Ericson, Real-Time
+// Collision Detection 5.1.5)
+static double pointTriangleDistance(const float * point, const float * pa, const float * pb, const float * pc) {
+    double p[3] = {point[0], point[1], point[2]};
+    double a[3] = {pa[0], pa[1], pa[2]}, b[3] = {pb[0], pb[1], pb[2]}, c[3] = {pc[0], pc[1], pc[2]};
+    double ab[3], ac[3], ap[3], bp[3], cp[3], closest[3];
+    for (int k = 0; k < 3; k++) {
+        ab[k] = b[k] - a[k];
+        ac[k] = c[k] - a[k];
+        ap[k] = p[k] - a[k];
+        bp[k] = p[k] - b[k];
+        cp[k] = p[k] - c[k];
+    }
+    double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    double va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+    if (d1 <= 0 && d2 <= 0) {
+        memcpy(closest, a, sizeof(closest));
+    } else if (d3 >= 0 && d4 <= d3) {
+        memcpy(closest, b, sizeof(closest));
+    } else if (d6 >= 0 && d5 <= d6) {
+        memcpy(closest, c, sizeof(closest));
+    } else if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        double v = d1 / (d1 - d3);
+        for (int k = 0; k < 3; k++) closest[k] = a[k] + v * ab[k];
+    } else if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        double w = d2 / (d2 - d6);
+        for (int k = 0; k < 3; k++) closest[k] = a[k] + w * ac[k];
+    } else if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+        double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        for (int k = 0; k < 3; k++) closest[k] = b[k] + w * (c[k] - b[k]);
+    } else {
+        // Inside: barycentric coordinates (a flat triangle never gets here)
+        double denominator = 1 / (va + vb + vc);
+        double v = vb * denominator, w = vc * denominator;
+        for (int k = 0; k < 3; k++) closest[k] = a[k] + v * ab[k] + w * ac[k];
+    }
+    double d[3] = {p[0] - closest[0], p[1] - closest[1], p[2] - closest[2]};
+    return sqrt(dot(d, d));
+}
+
+// Largest distance from a vertex of measured to the simplified triangles, each
+// taken to the triangles around the vertex it was merged into. That is at
+// least its distance to the whole surface, so the result bounds how far any
+// of those vertices lies from it. Needs the adjacency of the result.
+static double maxVertexDistance(t_simplifier * s, const uint32_t * measured, size_t measuredCount) {
+    double maxDistance = 0;
+    for (size_t i = 0; i < measuredCount; i++) {
+        uint32_t vertex = measured[i];
+        uint32_t representative = findRepresentative(s->representatives, vertex);
+        if (representative == vertex) continue;
+        const float *p = position(s, vertex);
+        // Without triangles left around it, the vertex it moved to
+        const float *r = position(s, representative);
+        double d[3] = {p[0] - r[0], p[1] - r[1], p[2] - r[2]};
+        double distance = sqrt(dot(d, d));
+        for (uint32_t a = s->adjacencyOffsets[representative]; a < s->adjacencyOffsets[representative + 1]; a++) {
+            const uint32_t *triangle = &s->triangles[s->adjacency[a] * 3];
+            double toTriangle = pointTriangleDistance(p, position(s, triangle[0]), position(s, triangle[1]), position(s, triangle[2]));
+            if (toTriangle < distance) distance = toTriangle;
+        }
+        if (distance > maxDistance) maxDistance = distance;
+    }
+    return maxDistance;
+}
+
+static int compareCollapses(const void * a, const void * b) {
+    double ea = ((const t_collapse *)a)->error, eb = ((const t_collapse *)b)->error;
+    return (ea > eb) - (ea < eb);
+}
+
+static void compactTriangles(t_simplifier * s) {
+    size_t kept = 0;
+    for (size_t t = 0; t < s->triangleCount; t++) {
+        if (s->triangles[t * 3] == REMOVED) continue;
+        memmove(&s->triangles[kept * 3], &s->triangles[t * 3], 3 * sizeof(uint32_t));
+        kept++;
+    }
+    s->triangleCount = kept;
+}
+
+static void freeSimplifier(t_simplifier * s) {
+    free(s->quadrics);
+    free(s->locked);
+    free(s->adjacencyOffsets);
+    free(s->adjacency);
+    free(s->touched);
+    free(s->collapses);
+}
+
+static size_t simplifiableVertexCount(const t_geometry_data * geometry_data, size_t vertexStride) {
+    return vertexStride >= 3 * sizeof(float) ? geometry_data->pointDataSize / vertexStride : 0;
+}
+
+// simplifyIndices(), with the collapses recorded in representatives (one per
+// vertex of the buffer) and the error measured on the vertices of measured
+static bool simplify(const t_geometry_data * geometry_data, size_t vertexStride, const uint32_t * indices, size_t indexCount,
+    size_t targetIndexCount, uint32_t * out, size_t * outCount, uint32_t * representatives,
+    const uint32_t * measured, size_t measuredCount, float * error) {
+    size_t vertexCount = simplifiableVertexCount(geometry_data, vertexStride);
+    for (size_t i = 0; i < indexCount; i++) {
+        if (indices[i] >= vertexCount) {
+            printf("Index %u is out of range (%zu vertices), can't simplify.\n", indices[i], vertexCount);
+            return false;
+        }
+    }
+    size_t triangleCount = indexCount / 3;
+    t_simplifier s = {
+        .geometry_data = geometry_data,
+        .vertexStride = vertexStride,
+        .vertexCount = vertexCount,
+        .triangles = out,
+        .triangleCount = triangleCount,
+        .quadrics = calloc(vertexCount ? vertexCount : 1, sizeof(t_quadric)),
+        .locked = calloc(vertexCount ? vertexCount : 1, sizeof(bool)),
+        .adjacencyOffsets = malloc((vertexCount + 1) * sizeof(uint32_t)),
+        .adjacency = malloc((triangleCount ? triangleCount : 1) * 3 * sizeof(uint32_t)),
+        .touched = calloc(vertexCount ? vertexCount : 1, sizeof(uint32_t)),
+        .collapses = malloc((vertexCount ? vertexCount : 1) * sizeof(t_collapse)),
+        .representatives = representatives
+    };
+    if (!s.quadrics || !s.locked || !s.adjacencyOffsets || !s.adjacency || !s.touched || !s.collapses) {
+        printf("Memory Allocation failed.\n");
+        freeSimplifier(&s);
+        return false;
+    }
+    memcpy(out, indices, triangleCount * 3 * sizeof(uint32_t));
+    computeQuadrics(&s);
+    buildAdjacency(&s);
+    findBorders(&s);
+
+    // Each pass collapses the cheapest edges whose neighbourhoods don't
+    // overlap, then rebuilds the adjacency for the next one
+    size_t targetTriangles = targetIndexCount / 3;
+    for (uint32_t pass = 1; s.triangleCount > targetTriangles; pass++) {
+        size_t collapseCount = 0;
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            if (!s.locked[v] && bestCollapse(&s, v, &s.collapses[collapseCount])) collapseCount++;
+        }
+        qsort(s.collapses, collapseCount, sizeof(t_collapse), compareCollapses);
+
+        size_t remaining = s.triangleCount;
+        size_t applied = 0;
+        for (size_t i = 0; i < collapseCount && remaining > targetTriangles; i++) {
+            const t_collapse *collapse = &s.collapses[i];
+            if (s.touched[collapse->from] == pass || s.touched[collapse->to] == pass) continue;
+            if (flipsTriangle(&s, collapse->from, collapse->to)) continue;
+            remaining -= applyCollapse(&s, collapse, pass);
+            representatives[collapse->from] = collapse->to;
+            applied++;
+        }
+        compactTriangles(&s);
+        if (applied == 0) break;
+        buildAdjacency(&s);
+    }
+
+    // An incomplete last triangle is dropped
+    *outCount = s.triangleCount * 3;
+    // The last pass may have compacted triangles without rebuilding
+    buildAdjacency(&s);
+    *error = maxVertexDistance(&s, measured, measuredCount);
+    freeSimplifier(&s);
+    return true;
+}
+
+static uint32_t * identityRepresentatives(size_t vertexCount) {
+    uint32_t *representatives = malloc((vertexCount ? vertexCount : 1) * sizeof(uint32_t));
+    if (!representatives) {
+        printf("Memory Allocation failed.\n");
+        return NULL;
+    }
+    for (size_t v = 0; v < vertexCount; v++) representatives[v] = v;
+    return representatives;
+}
+
+bool simplifyIndices(const t_geometry_data * geometry_data, size_t vertexStride, const uint32_t * indices, size_t indexCount,
+    size_t targetIndexCount, uint32_t * out, size_t * outCount, float * error) {
+    uint32_t *representatives = identityRepresentatives(simplifiableVertexCount(geometry_data, vertexStride));
+    if (!representatives) return false;
+    bool success = simplify(geometry_data, vertexStride, indices, indexCount, targetIndexCount, out, outCount,
+        representatives, indices, indexCount, error);
+    free(representatives);
+    return success;
+}
+
+//  ------------------------------- Levels of detail------------------------------------------------------------------
+
+bool buildLodChain(t_geometry_data * geometry_data, size_t vertexStride, const float * ratios, size_t ratioCount, t_lod_chain * chain) {
+    size_t indexCount;
+    uint32_t *indices = getGeometryIndices(geometry_data, &indexCount);
+    if (!indices) return false;
+    size_t triangleIndices = indexCount - indexCount % 3;
+    // Each level is at most as large as the full mesh
+    uint32_t *packed = realloc(indices, (indexCount + (MAX_LODS - 1) * triangleIndices + 1) * sizeof(uint32_t));
+    if (!packed) {
+        printf("Memory Re-allocation failed.\n");
+        free(indices);
+        return false;
+    }
+
+    // Collapses carry over from level to level, so every level is measured
+    // against the vertices of the full mesh
+    uint32_t *representatives = identityRepresentatives(simplifiableVertexCount(geometry_data, vertexStride));
+    if (!representatives) {
+        free(packed);
+        return false;
+    }
+
+    *chain = (t_lod_chain){0};
+    chain->lods[chain->count++] = (t_geometry_lod){0, indexCount, 0};
+    size_t packedCount = indexCount;
+    for (size_t i = 0; i < ratioCount && chain->count < MAX_LODS; i++) {
+        const t_geometry_lod *previous = &chain->lods[chain->count - 1];
+        size_t target = (size_t)(triangleIndices / 3 * ratios[i]) * 3;
+        size_t count;
+        float error;
+        if (!simplify(geometry_data, vertexStride, packed + previous->firstIndex, previous->indexCount - previous->indexCount % 3,
+                target, packed + packedCount, &count, representatives, packed, triangleIndices, &error)) {
+            free(representatives);
+            free(packed);
+            return false;
+        }
+        // No smaller, or nothing left to draw
+        if (count == 0 || count >= previous->indexCount - previous->indexCount % 3) break;
+        chain->lods[chain->count++] = (t_geometry_lod){
+            .firstIndex = packedCount,
+            .indexCount = count,
+            .error = error
+        };
+        packedCount += count;
+    }
+
+    free(representatives);
+    bool success = setGeometryIndices(geometry_data, packed, packedCount);
+    free(packed);
+    return success;
+}
+
+size_t selectLod(const t_lod_chain * chain, float pixelsPerUnit, float maxPixelError) {
+    size_t selected = 0;
+    for (size_t i = 1; i < chain->count; i++) {
+        if (chain->lods[i].error * pixelsPerUnit <= maxPixelError) selected = i;
+    }
+    return selected;
+}
@@ -0,0 +1,49 @@
+#ifndef MESH_SIMPLIFIER_HEADER_FILE
+#define MESH_SIMPLIFIER_HEADER_FILE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "helper_v3.h"
+
+//  ------------------------------- Mesh simplifier------------------------------------------------------------------
+// Quadric error metric simplification (Garland & Heckbert 1997) by edge
+// collapse. Vertices are only ever collapsed onto one of their neighbours, so
+// the simplified meshes are index buffers over the original vertex buffer and
+// every level of detail can share it. Border vertices never move.
+// Positions are the first 3 floats of each vertex.
+
+#define MAX_LODS 8
+
+// Collapses edges of the triangles in indices until at most targetIndexCount
+// indices are left, or nothing can collapse without flipping a triangle.
+// out must hold indexCount entries. error receives, in mesh units, the
+// largest distance from a vertex of the input to the simplified surface (an
+// upper bound of it, measured at the vertices).
+bool simplifyIndices(const t_geometry_data * geometry_data, size_t vertexStride, const uint32_t * indices, size_t indexCount,
+    size_t targetIndexCount, uint32_t * out, size_t * outCount, float * error);
+
+typedef struct GeometryLod {
+    uint32_t firstIndex;    // where the level starts in the index buffer
+    uint32_t indexCount;
+    float error;            // farthest a vertex of lods[0] lies from the level, in mesh units
+} t_geometry_lod;
+
+typedef struct LodChain {
+    size_t count;
+    t_geometry_lod lods[MAX_LODS];  // lods[0] is the full mesh
+} t_lod_chain;
+
+// Builds one level per ratio of the original triangle count (e.g. 0.5, 0.25,
+// 0.125), each simplified from the previous one, and replaces indexData with
+// all levels packed one after the other. Stops early once a level can't get
+// any smaller. Draw level i with DrawIndexed(lods[i].indexCount, 1, lods[i].firstIndex, 0, 0).
+bool buildLodChain(t_geometry_data * geometry_data, size_t vertexStride, const float * ratios, size_t ratioCount, t_lod_chain * chain);
+
+// Coarsest level whose error covers at most maxPixelError pixels on screen:
+// no vertex of the full mesh is farther than that from what is drawn.
+// pixelsPerUnit is how many pixels one mesh unit covers where the mesh is:
+// screenHeight / (2 * distance * tan(fovY / 2)) with a perspective projection.
+size_t selectLod(const t_lod_chain * chain, float pixelsPerUnit, float maxPixelError);
+
+#endif
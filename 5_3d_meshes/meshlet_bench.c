@@ -0,0 +1,126 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "helper_v3.h"
+#include "mesh_optimizer.h"
+#include "meshlets.h"
+
+// Builds meshlets for wavy grids of growing size and reports the build time
+// against the mesh size, along with how full the meshlets are. Every result is
+// checked: the meshlets must give back the input triangles, and each bounding
+// sphere must hold its vertices.
+// Usage: meshlet_bench [largest grid side]
+
+#define VERTEX_FLOATS 6
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool generateGrid(size_t side, t_geometry_data * geometry_data) {
+    size_t vertexCount = side * side;
+    size_t triangleCount = 2 * (side - 1) * (side - 1);
+    float *points = malloc(vertexCount * VERTEX_FLOATS * sizeof(float));
+    uint32_t *indices = malloc(triangleCount * 3 * sizeof(uint32_t));
+    if (!points || !indices) {
+        free(points);
+        free(indices);
+        return false;
+    }
+    for (size_t y = 0; y < side; y++) {
+        for (size_t x = 0; x < side; x++) {
+            float *p = &points[(y * side + x) * VERTEX_FLOATS];
+            p[0] = x;
+            p[1] = y;
+            p[2] = 4 * sinf(x * 0.1f) * cosf(y * 0.1f);
+            p[3] = p[4] = p[5] = 0.5f;
+        }
+    }
+    size_t i = 0;
+    for (size_t y = 0; y + 1 < side; y++) {
+        for (size_t x = 0; x + 1 < side; x++) {
+            uint32_t a = y * side + x;
+            indices[i++] = a; indices[i++] = a + 1; indices[i++] = a + side;
+            indices[i++] = a + 1; indices[i++] = a + side + 1; indices[i++] = a + side;
+        }
+    }
+    *geometry_data = (t_geometry_data){points, vertexCount * VERTEX_FLOATS * sizeof(float), NULL, 0};
+    bool success = setGeometryIndices(geometry_data, indices, triangleCount * 3);
+    free(indices);
+    return success;
+}
+
+static bool checkMeshlets(const t_geometry_data * geometry_data, const t_meshlets * meshlets) {
+    size_t indexCount;
+    uint32_t *indices = getGeometryIndices(geometry_data, &indexCount);
+    if (!indices) return false;
+    bool valid = meshlets->triangleCount == indexCount / 3;
+    size_t triangle = 0;
+    for (size_t m = 0; valid && m < meshlets->count; m++) {
+        const uint32_t *vertices = meshlets->vertices + meshlets->vertexOffsets[m];
+        const float *sphere = &meshlets->spheres[m * 4];
+        for (uint32_t t = 0; valid && t < meshlets->triangleCounts[m]; t++, triangle++) {
+            uint32_t packed = meshlets->triangles[meshlets->triangleOffsets[m] + t];
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = vertices[(packed >> (k * 8)) & 0xff];
+                const float *p = &geometry_data->pointData[v * VERTEX_FLOATS];
+                float dx = p[0] - sphere[0], dy = p[1] - sphere[1], dz = p[2] - sphere[2];
+                valid = valid && v == indices[triangle * 3 + k] &&
+                    sqrtf(dx * dx + dy * dy + dz * dz) <= sphere[3] * 1.0001f + 1e-5f;
+            }
+        }
+    }
+    free(indices);
+    return valid;
+}
+
+static void benchmark(size_t side) {
+    t_geometry_data geometrydata;
+    if (!generateGrid(side, &geometrydata)) {
+        printf("Memory Allocation failed.\n");
+        return;
+    }
+    optimizeVertexCache(&geometrydata, VERTEX_FLOATS * sizeof(float), MESH_OPTIMIZER_CACHE_SIZE);
+
+    double best = 0;
+    t_meshlets meshlets = {0};
+    for (int run = 0; run < 3; run++) {
+        freeMeshlets(&meshlets);
+        double start = now();
+        bool success = buildMeshlets(&geometrydata, VERTEX_FLOATS * sizeof(float), MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, &meshlets);
+        double elapsed = now() - start;
+        if (!success) {
+            free(geometrydata.pointData);
+            free(geometrydata.indexData);
+            return;
+        }
+        if (best == 0 || elapsed < best) best = elapsed;
+    }
+
+    t_meshlet_buffer_offsets offsets;
+    size_t blobSize = 0;
+    free(packMeshlets(&meshlets, &offsets, &blobSize));
+    size_t triangleCount = meshlets.triangleCount;
+    printf("%9zu triangles %7zu meshlets  %5.1f verts %5.1f tris each  %8.3f ms %7.1f Mtris/s  %7.1f KB  %s\n",
+        triangleCount, meshlets.count,
+        (double)meshlets.vertexCount / meshlets.count, (double)triangleCount / meshlets.count,
+        best * 1e3, triangleCount / best * 1e-6, blobSize / 1024.0,
+        checkMeshlets(&geometrydata, &meshlets) ? "ok" : "MISMATCH");
+
+    freeMeshlets(&meshlets);
+    free(geometrydata.pointData);
+    free(geometrydata.indexData);
+}
+
+int main(int argc, char *argv[]) {
+    size_t largest = argc > 1 ? strtoul(argv[1], NULL, 10) : 1024;
+    printf("meshlets of up to %d vertices and %d triangles\n", MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    for (size_t side = 32; side <= largest; side *= 2) benchmark(side);
+    return 0;
+}
@@ -0,0 +1,314 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "meshlets.h"
+
+//  ------------------------------- Bounds------------------------------------------------------------------
+
+static const float * vertexPosition(const t_geometry_data * geometry_data, size_t vertexStride, uint32_t vertex) {
+    return (const float *)((const char *)geometry_data->pointData + vertex * vertexStride);
+}
+
+static float distance3(const float * a, const float * b) {
+    float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// Ritter's sphere: start from the most distant pair of axis extremes, then
+// grow the sphere to take in every point left outside
+static void boundingSphere(const float ** points, size_t count, float * sphere) {
+    size_t extremes[6] = {0};
+    for (size_t i = 0; i < count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (points[i][axis] < points[extremes[axis * 2]][axis]) extremes[axis * 2] = i;
+            if (points[i][axis] > points[extremes[axis * 2 + 1]][axis]) extremes[axis * 2 + 1] = i;
+        }
+    }
+    const float *a = points[0], *b = points[0];
+    float span = -1;
+    for (int axis = 0; axis < 3; axis++) {
+        float d = distance3(points[extremes[axis * 2]], points[extremes[axis * 2 + 1]]);
+        if (d > span) {
+            span = d;
+            a = points[extremes[axis * 2]];
+            b = points[extremes[axis * 2 + 1]];
+        }
+    }
+    float center[3] = {(a[0] + b[0]) / 2, (a[1] + b[1]) / 2, (a[2] + b[2]) / 2};
+    float radius = span / 2;
+    for (size_t i = 0; i < count; i++) {
+        float d = distance3(points[i], center);
+        if (d <= radius) continue;
+        float grown = (radius + d) / 2;
+        float k = (grown - radius) / d;
+        for (int axis = 0; axis < 3; axis++) center[axis] += (points[i][axis] - center[axis]) * k;
+        radius = grown;
+    }
+    sphere[0] = center[0];
+    sphere[1] = center[1];
+    sphere[2] = center[2];
+    sphere[3] = radius;
+}
+
+// Axis: average of the triangle normals. The cutoff is the sine of the
+// widest angle between the axis and a normal, and the apex sits far enough
+// behind the sphere center to be behind every triangle plane.
+static void normalCone(const float (*normals)[3], const float (*corners)[3], size_t count, const float * center, float * cone, float * apex) {
+    float axis[3] = {0, 0, 0};
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) axis[k] += normals[i][k];
+    }
+    float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float minDot = 1;
+    if (length > 0) {
+        for (int k = 0; k < 3; k++) axis[k] /= length;
+        for (size_t i = 0; i < count; i++) {
+            float dot = axis[0] * normals[i][0] + axis[1] * normals[i][1] + axis[2] * normals[i][2];
+            if (dot < minDot) minDot = dot;
+        }
+    }
+    apex[0] = center[0];
+    apex[1] = center[1];
+    apex[2] = center[2];
+    apex[3] = 0;
+    cone[0] = axis[0];
+    cone[1] = axis[1];
+    cone[2] = axis[2];
+    if (count == 0 || length == 0 || minDot <= 0) {
+        cone[3] = 1;
+        return;
+    }
+    cone[3] = sqrtf(1 - minDot * minDot);
+
+    float behind = 0;
+    for (size_t i = 0; i < count; i++) {
+        const float *n = normals[i];
+        float toCenter = (center[0] - corners[i][0]) * n[0] + (center[1] - corners[i][1]) * n[1] + (center[2] - corners[i][2]) * n[2];
+        float t = toCenter / (axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2]);
+        if (t > behind) behind = t;
+    }
+    for (int k = 0; k < 3; k++) apex[k] = center[k] - axis[k] * behind;
+}
+
+//  ------------------------------- Building------------------------------------------------------------------
+
+typedef struct MeshletBuilder {
+    const t_geometry_data * geometry_data;
+    size_t vertexStride;
+    t_meshlets * meshlets;
+    size_t capacity;
+    uint32_t * owner;           // per mesh vertex: 1 + the meshlet it was last added to
+    uint8_t * local;            // per mesh vertex: its index in that meshlet
+    const float ** points;      // scratch, per meshlet vertex
+    float (*normals)[3];        // scratch, per meshlet triangle
+    float (*corners)[3];
+} t_meshlet_builder;
+
+static bool reserveMeshlets(t_meshlet_builder * builder) {
+    t_meshlets *meshlets = builder->meshlets;
+    if (meshlets->count < builder->capacity) return true;
+    size_t capacity = builder->capacity ? builder->capacity * 2 : 64;
+    uint32_t **uintArrays[] = {&meshlets->vertexOffsets, &meshlets->vertexCounts, &meshlets->triangleOffsets, &meshlets->triangleCounts};
+    float **floatArrays[] = {&meshlets->spheres, &meshlets->cones, &meshlets->coneApexes};
+    for (size_t i = 0; i < 4; i++) {
+        uint32_t *grown = realloc(*uintArrays[i], capacity * sizeof(uint32_t));
+        if (!grown) return false;
+        *uintArrays[i] = grown;
+    }
+    for (size_t i = 0; i < 3; i++) {
+        float *grown = realloc(*floatArrays[i], capacity * 4 * sizeof(float));
+        if (!grown) return false;
+        *floatArrays[i] = grown;
+    }
+    builder->capacity = capacity;
+    return true;
+}
+
+// Computes the bounds of the meshlet being built and makes it count
+static void finishMeshlet(t_meshlet_builder * builder) {
+    t_meshlets *meshlets = builder->meshlets;
+    size_t m = meshlets->count;
+    uint32_t vertexCount = meshlets->vertexCount - meshlets->vertexOffsets[m];
+    uint32_t triangleCount = meshlets->triangleCount - meshlets->triangleOffsets[m];
+    meshlets->vertexCounts[m] = vertexCount;
+    meshlets->triangleCounts[m] = triangleCount;
+
+    const uint32_t *vertices = meshlets->vertices + meshlets->vertexOffsets[m];
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        builder->points[i] = vertexPosition(builder->geometry_data, builder->vertexStride, vertices[i]);
+    }
+    boundingSphere(builder->points, vertexCount, &meshlets->spheres[m * 4]);
+
+    size_t normalCount = 0;
+    const uint32_t *triangles = meshlets->triangles + meshlets->triangleOffsets[m];
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const float *p0 = builder->points[triangles[t] & 0xff];
+        const float *p1 = builder->points[(triangles[t] >> 8) & 0xff];
+        const float *p2 = builder->points[(triangles[t] >> 16) & 0xff];
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        // Degenerate triangles don't face anywhere
+        if (length == 0) continue;
+        for (int k = 0; k < 3; k++) {
+            builder->normals[normalCount][k] = n[k] / length;
+            builder->corners[normalCount][k] = p0[k];
+        }
+        normalCount++;
+    }
+    normalCone((const float (*)[3])builder->normals, (const float (*)[3])builder->corners, normalCount,
+        &meshlets->spheres[m * 4], &meshlets->cones[m * 4], &meshlets->coneApexes[m * 4]);
+    meshlets->count++;
+}
+
+static bool startMeshlet(t_meshlet_builder * builder) {
+    if (!reserveMeshlets(builder)) return false;
+    t_meshlets *meshlets = builder->meshlets;
+    meshlets->vertexOffsets[meshlets->count] = meshlets->vertexCount;
+    meshlets->triangleOffsets[meshlets->count] = meshlets->triangleCount;
+    return true;
+}
+
+static void freeBuilder(t_meshlet_builder * builder) {
+    free(builder->owner);
+    free(builder->local);
+    free(builder->points);
+    free(builder->normals);
+    free(builder->corners);
+}
+
+bool buildMeshlets(const t_geometry_data * geometry_data, size_t vertexStride, size_t maxVertices, size_t maxTriangles, t_meshlets * meshlets) {
+    *meshlets = (t_meshlets){0};
+    // Local indices are 8 bits
+    if (maxVertices < 3 || maxVertices > 256 || maxTriangles < 1 || vertexStride < 3 * sizeof(float)) {
+        printf("Meshlets need 3 to 256 vertices, 1 triangle or more and 3 float positions.\n");
+        return false;
+    }
+    size_t indexCount;
+    uint32_t *indices = getGeometryIndices(geometry_data, &indexCount);
+    if (!indices) return false;
+    size_t vertexCount = geometry_data->pointDataSize / vertexStride;
+    size_t triangleCount = indexCount / 3;
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        if (indices[i] >= vertexCount) {
+            printf("Index %u is out of range (%zu vertices), no meshlets built.\n", indices[i], vertexCount);
+            free(indices);
+            return false;
+        }
+    }
+
+    t_meshlet_builder builder = {
+        .geometry_data = geometry_data,
+        .vertexStride = vertexStride,
+        .meshlets = meshlets,
+        .owner = calloc(vertexCount ? vertexCount : 1, sizeof(uint32_t)),
+        .local = malloc(vertexCount ? vertexCount : 1),
+        .points = malloc(maxVertices * sizeof(const float *)),
+        .normals = malloc(maxTriangles * sizeof(float[3])),
+        .corners = malloc(maxTriangles * sizeof(float[3]))
+    };
+    // Every triangle brings at most 3 vertices
+    meshlets->vertices = malloc((triangleCount ? triangleCount : 1) * 3 * sizeof(uint32_t));
+    meshlets->triangles = malloc((triangleCount ? triangleCount : 1) * sizeof(uint32_t));
+    bool success = builder.owner && builder.local && builder.points && builder.normals && builder.corners &&
+        meshlets->vertices && meshlets->triangles && startMeshlet(&builder);
+
+    uint32_t meshletVertices = 0;
+    uint32_t meshletTriangles = 0;
+    for (size_t t = 0; success && t < triangleCount; t++) {
+        const uint32_t *triangle = &indices[t * 3];
+        uint32_t id = meshlets->count + 1;
+        uint32_t added = (builder.owner[triangle[0]] != id) +
+            (builder.owner[triangle[1]] != id && triangle[1] != triangle[0]) +
+            (builder.owner[triangle[2]] != id && triangle[2] != triangle[0] && triangle[2] != triangle[1]);
+        if (meshletVertices + added > maxVertices || meshletTriangles + 1 > maxTriangles) {
+            finishMeshlet(&builder);
+            success = startMeshlet(&builder);
+            meshletVertices = 0;
+            meshletTriangles = 0;
+            id = meshlets->count + 1;
+        }
+        uint32_t packed = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            if (builder.owner[v] != id) {
+                builder.owner[v] = id;
+                builder.local[v] = meshletVertices++;
+                meshlets->vertices[meshlets->vertexCount++] = v;
+            }
+            packed |= (uint32_t)builder.local[v] << (k * 8);
+        }
+        meshlets->triangles[meshlets->triangleCount++] = packed;
+        meshletTriangles++;
+    }
+    if (success && meshletTriangles > 0) finishMeshlet(&builder);
+
+    freeBuilder(&builder);
+    free(indices);
+    if (!success) {
+        printf("Memory Allocation failed.\n");
+        freeMeshlets(meshlets);
+        return false;
+    }
+    // Give back what the worst case estimate didn't need
+    uint32_t *vertices = realloc(meshlets->vertices, (meshlets->vertexCount ? meshlets->vertexCount : 1) * sizeof(uint32_t));
+    if (vertices) meshlets->vertices = vertices;
+    return true;
+}
+
+void freeMeshlets(t_meshlets * meshlets) {
+    free(meshlets->vertexOffsets);
+    free(meshlets->vertexCounts);
+    free(meshlets->triangleOffsets);
+    free(meshlets->triangleCounts);
+    free(meshlets->spheres);
+    free(meshlets->cones);
+    free(meshlets->coneApexes);
+    free(meshlets->vertices);
+    free(meshlets->triangles);
+    *meshlets = (t_meshlets){0};
+}
+
+//  ------------------------------- GPU blob------------------------------------------------------------------
+
+static size_t appendArray(size_t * size, size_t arraySize) {
+    size_t offset = (*size + 255) & ~(size_t)255;
+    *size = offset + arraySize;
+    return offset;
+}
+
+void * packMeshlets(const t_meshlets * meshlets, t_meshlet_buffer_offsets * offsets, size_t * size) {
+    size_t count = meshlets->count;
+    size_t total = 0;
+    *offsets = (t_meshlet_buffer_offsets){
+        .vertexOffsets = appendArray(&total, count * sizeof(uint32_t)),
+        .vertexCounts = appendArray(&total, count * sizeof(uint32_t)),
+        .triangleOffsets = appendArray(&total, count * sizeof(uint32_t)),
+        .triangleCounts = appendArray(&total, count * sizeof(uint32_t)),
+        .spheres = appendArray(&total, count * 4 * sizeof(float)),
+        .cones = appendArray(&total, count * 4 * sizeof(float)),
+        .coneApexes = appendArray(&total, count * 4 * sizeof(float)),
+        .vertices = appendArray(&total, meshlets->vertexCount * sizeof(uint32_t)),
+        .triangles = appendArray(&total, meshlets->triangleCount * sizeof(uint32_t))
+    };
+    char *blob = calloc(total ? total : 1, 1);
+    if (!blob) {
+        printf("Memory Allocation failed.\n");
+        return NULL;
+    }
+    if (count > 0) {
+        memcpy(blob + offsets->vertexOffsets, meshlets->vertexOffsets, count * sizeof(uint32_t));
+        memcpy(blob + offsets->vertexCounts, meshlets->vertexCounts, count * sizeof(uint32_t));
+        memcpy(blob + offsets->triangleOffsets, meshlets->triangleOffsets, count * sizeof(uint32_t));
+        memcpy(blob + offsets->triangleCounts, meshlets->triangleCounts, count * sizeof(uint32_t));
+        memcpy(blob + offsets->spheres, meshlets->spheres, count * 4 * sizeof(float));
+        memcpy(blob + offsets->cones, meshlets->cones, count * 4 * sizeof(float));
+        memcpy(blob + offsets->coneApexes, meshlets->coneApexes, count * 4 * sizeof(float));
+        memcpy(blob + offsets->vertices, meshlets->vertices, meshlets->vertexCount * sizeof(uint32_t));
+        memcpy(blob + offsets->triangles, meshlets->triangles, meshlets->triangleCount * sizeof(uint32_t));
+    }
+    *size = total;
+    return blob;
+}
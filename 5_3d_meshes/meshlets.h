@@ -0,0 +1,65 @@
+#ifndef MESHLETS_HEADER_FILE
+#define MESHLETS_HEADER_FILE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "helper_v3.h"
+
+//  ------------------------------- Meshlets------------------------------------------------------------------
+// Splits an indexed triangle list into small clusters (meshlets) that can be
+// culled and streamed on their own. Each meshlet lists the vertices it uses
+// and its triangles as indices into that list, so they fit in 8 bits.
+//
+// Triangles are taken in index buffer order, so run optimizeVertexCache
+// (mesh_optimizer.h) first: a cache friendly order makes for compact meshlets.
+// Positions are the first 3 floats of each vertex.
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Structure of arrays, every element 4 byte aligned so the arrays can go to
+// storage buffers as they are (see packMeshlets).
+typedef struct Meshlets {
+    size_t count;
+    // Per meshlet
+    uint32_t * vertexOffsets;   // first entry in vertices
+    uint32_t * vertexCounts;
+    uint32_t * triangleOffsets; // first entry in triangles
+    uint32_t * triangleCounts;
+    float * spheres;            // bounding sphere: center xyz, radius
+    float * cones;              // normal cone: axis xyz, cutoff
+    float * coneApexes;         // normal cone apex xyz, 0
+    // Shared by all meshlets
+    uint32_t * vertices;        // index into the vertex buffer
+    size_t vertexCount;
+    uint32_t * triangles;       // 3 local vertex indices, 8 bits each (bits 0-7, 8-15, 16-23)
+    size_t triangleCount;
+} t_meshlets;
+
+// The whole meshlet is back facing, and can be skipped, when
+//   dot(normalize(apex - cameraPosition), axis) >= cutoff
+// A cutoff of 1 or more means the triangles face too many ways to ever cull.
+
+bool buildMeshlets(const t_geometry_data * geometry_data, size_t vertexStride, size_t maxVertices, size_t maxTriangles, t_meshlets * meshlets);
+void freeMeshlets(t_meshlets * meshlets);
+
+// Where each array starts in the blob made by packMeshlets, in bytes.
+// Offsets are 256 byte aligned, the minimum storage buffer offset alignment.
+typedef struct MeshletBufferOffsets {
+    size_t vertexOffsets;
+    size_t vertexCounts;
+    size_t triangleOffsets;
+    size_t triangleCounts;
+    size_t spheres;
+    size_t cones;
+    size_t coneApexes;
+    size_t vertices;
+    size_t triangles;
+} t_meshlet_buffer_offsets;
+
+// All the arrays in one malloc'd blob, ready for createBufferWithData with
+// WGPUBufferUsage_Storage. Bind each array with its offset.
+void * packMeshlets(const t_meshlets * meshlets, t_meshlet_buffer_offsets * offsets, size_t * size);
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "helper_v3.h"
+#include "fast_parse.h"
+
+// Compares the geometry parsers of fast_parse.h against the strtof reference:
+//  - on random float tokens (throughput + bit exactness)
+//  - on whole geometry files (parseGeometry throughput + identical output)
+// and parseGeometry with 1, 2, 4... threads against the single threaded parse.
+// Usage: parse_bench [geometry files...]
+// Without arguments the resource files are used; geometry_bench generates a
+// large file that can be passed here.
+
+static const t_geometry_parser parsers[] = {
+    GeometryParser_Strtof, GeometryParser_Scalar, GeometryParser_SSE2, GeometryParser_AVX2
+};
+#define PARSER_COUNT (sizeof(parsers) / sizeof(parsers[0]))
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool selectParser(t_geometry_parser parser) {
+    setGeometryParser(parser);
+    return getGeometryParser() == parser;
+}
+
+// Newline separated random floats in the formats people actually write
+static char * generateTokens(size_t count, size_t * size) {
+    size_t capacity = count * 32 + FAST_PARSE_PADDING;
+    char *text = calloc(capacity, 1);
+    size_t length = 0;
+    srand(7);
+    for (size_t i = 0; i < count; i++) {
+        double x = (rand() / (double)RAND_MAX - 0.5) * 2;
+        switch (i % 5) {
+        case 0: length += sprintf(text + length, "%+.4f\n", x); break;
+        case 1: length += sprintf(text + length, "%.3f\n", x * 1000); break;
+        case 2: length += sprintf(text + length, "%.9g\n", x); break;
+        case 3: length += sprintf(text + length, "%.6e\n", x * 1e-20); break;
+        default: length += sprintf(text + length, "%d\n", rand() % 100000); break;
+        }
+    }
+    *size = length;
+    return text;
+}
+
+static size_t parseAllTokens(const char * text, size_t size, float * out) {
+    size_t count = 0;
+    const char *end = text + size;
+    for (const char *p = text; p < end; p++) {
+        const char *eon = parseFloatToken(p, &out[count]);
+        if (eon == p) break;
+        count++;
+        p = eon;
+    }
+    return count;
+}
+
+static void benchmarkTokens(size_t tokenCount) {
+    size_t size;
+    char *text = generateTokens(tokenCount, &size);
+    float *reference = malloc(tokenCount * sizeof(float));
+    float *values = malloc(tokenCount * sizeof(float));
+    double megabytes = size / (1024.0 * 1024.0);
+
+    printf("%zu random float tokens (%.1f MB)\n", tokenCount, megabytes);
+    selectParser(GeometryParser_Strtof);
+    parseAllTokens(text, size, reference);
+    for (size_t i = 0; i < PARSER_COUNT; i++) {
+        if (!selectParser(parsers[i])) continue;
+        double best = 0;
+        size_t count = 0;
+        for (int run = 0; run < 5; run++) {
+            double start = now();
+            count = parseAllTokens(text, size, values);
+            double elapsed = now() - start;
+            if (best == 0 || elapsed < best) best = elapsed;
+        }
+        bool exact = count == tokenCount && memcmp(values, reference, count * sizeof(float)) == 0;
+        printf("  %-7s %8.1f MB/s %8.1f Mtokens/s  %s\n", geometryParserName(parsers[i]),
+            megabytes / best, count / best * 1e-6, exact ? "bit-exact" : "MISMATCH");
+    }
+    free(text);
+    free(reference);
+    free(values);
+}
+
+static void benchmarkFile(const char * path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        printf("can't open file:\n %s\n", path);
+        return;
+    }
+    double megabytes = st.st_size / (1024.0 * 1024.0);
+    printf("%s (%.2f MB)\n", path, megabytes);
+
+    struct GeometryData reference = {NULL, 0, NULL, 0};
+    selectParser(GeometryParser_Strtof);
+    parseGeometry(path, &reference);
+    for (size_t i = 0; i < PARSER_COUNT; i++) {
+        if (!selectParser(parsers[i])) continue;
+        double best = 0;
+        bool exact = true;
+        // Small files need many runs to be measurable
+        int runs = megabytes < 1 ? 1000 : 3;
+        for (int run = 0; run < runs; run++) {
+            struct GeometryData geometrydata = {NULL, 0, NULL, 0};
+            double start = now();
+            parseGeometry(path, &geometrydata);
+            double elapsed = now() - start;
+            if (best == 0 || elapsed < best) best = elapsed;
+            exact = exact &&
+                geometrydata.pointDataSize == reference.pointDataSize &&
+                geometrydata.indexDataSize == reference.indexDataSize &&
+                geometrydata.indexFormat == reference.indexFormat &&
+                memcmp(geometrydata.pointData, reference.pointData, reference.pointDataSize) == 0 &&
+                memcmp(geometrydata.indexData, reference.indexData, reference.indexDataSize) == 0;
+            free(geometrydata.pointData);
+            free(geometrydata.indexData);
+        }
+        printf("  %-7s %8.1f MB/s %10.3f ms  %s\n", geometryParserName(parsers[i]),
+            megabytes / best, best * 1e3, exact ? "identical" : "MISMATCH");
+    }
+    free(reference.pointData);
+    free(reference.indexData);
+}
+
+static void benchmarkThreads(const char * path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+    double megabytes = st.st_size / (1024.0 * 1024.0);
+    size_t maxThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (maxThreads < 4) maxThreads = 4;
+    printf("%s (%.2f MB), %s parser\n", path, megabytes, geometryParserName(getGeometryParser()));
+
+    struct GeometryData reference = {NULL, 0, NULL, 0};
+    setGeometryThreads(1);
+    parseGeometry(path, &reference);
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        setGeometryThreads(threads);
+        double best = 0;
+        bool identical = true;
+        for (int run = 0; run < 3; run++) {
+            struct GeometryData geometrydata = {NULL, 0, NULL, 0};
+            double start = now();
+            parseGeometry(path, &geometrydata);
+            double elapsed = now() - start;
+            if (best == 0 || elapsed < best) best = elapsed;
+            identical = identical &&
+                geometrydata.pointDataSize == reference.pointDataSize &&
+                geometrydata.indexDataSize == reference.indexDataSize &&
+                geometrydata.indexFormat == reference.indexFormat &&
+                memcmp(geometrydata.pointData, reference.pointData, reference.pointDataSize) == 0 &&
+                memcmp(geometrydata.indexData, reference.indexData, reference.indexDataSize) == 0;
+            free(geometrydata.pointData);
+            free(geometrydata.indexData);
+        }
+        printf("  %2zu threads %8.1f MB/s %10.3f ms  %s\n", threads,
+            megabytes / best, best * 1e3, identical ? "identical" : "MISMATCH");
+    }
+    free(reference.pointData);
+    free(reference.indexData);
+    setGeometryThreads(0);
+}
+
+int main(int argc, char *argv[]) {
+    benchmarkTokens(4 * 1000 * 1000);
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) benchmarkFile(argv[i]);
+        setGeometryParser(GeometryParser_Auto);
+        for (int i = 1; i < argc; i++) benchmarkThreads(argv[i]);
+    } else {
+        benchmarkFile(RESOURCE_DIR "/pyramid.txt");
+        benchmarkFile(RESOURCE_DIR "/webgpu.txt");
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "pipeline_manager.h"
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void initPipelineManager(t_pipeline_manager * manager, WGPUDevice device) {
+    *manager = (t_pipeline_manager){.device = device};
+}
+
+static void onPipelineCreated(WGPUCreatePipelineAsyncStatus status, WGPURenderPipeline pipeline, char const * message, void * userData) {
+    t_pipeline_slot *slot = (t_pipeline_slot *)userData;
+    if (slot->appliedSerial > 0) {
+        // Replaced before the first version was even done
+        if (status == WGPUCreatePipelineAsyncStatus_Success) wgpuRenderPipelineRelease(pipeline);
+    } else if (status == WGPUCreatePipelineAsyncStatus_Success) {
+        slot->compileTime = now() - slot->requestTime;
+        slot->pipeline = pipeline;
+        slot->state = PipelineReady;
+    } else {
+        slot->compileTime = now() - slot->requestTime;
+        printf("Could not create render pipeline %s: %s\n", slot->label ? slot->label : "", message ? message : "");
+        slot->state = PipelineFailed;
+    }
+    slot->manager->pendingCount--;
+}
+
+int requestRenderPipeline(t_pipeline_manager * manager, const WGPURenderPipelineDescriptor * descriptor, WGPURenderPipeline fallback) {
+    if (manager->count == PIPELINE_MANAGER_MAX_PIPELINES) {
+        printf("Too many pipelines, the manager holds %d.\n", PIPELINE_MANAGER_MAX_PIPELINES);
+        return -1;
+    }
+    t_pipeline_slot *slot = &manager->slots[manager->count];
+    *slot = (t_pipeline_slot){
+        .manager = manager,
+        .state = PipelinePending,
+        .fallback = fallback,
+        .label = descriptor->label,
+        .requestTime = now()
+    };
+    manager->pendingCount++;
+    // Dawn may call back right away, e.g. when the pipeline is in its cache
+    wgpuDeviceCreateRenderPipelineAsync(manager->device, descriptor, onPipelineCreated, slot);
+    return (int)manager->count++;
+}
+
+typedef struct PipelineReplacement {
+    t_pipeline_slot * slot;
+    unsigned serial;
+    double requestTime;
+} t_pipeline_replacement;
+
+static void onPipelineReplaced(WGPUCreatePipelineAsyncStatus status, WGPURenderPipeline pipeline, char const * message, void * userData) {
+    t_pipeline_replacement *replacement = (t_pipeline_replacement *)userData;
+    t_pipeline_slot *slot = replacement->slot;
+    if (status != WGPUCreatePipelineAsyncStatus_Success) {
+        printf("Could not rebuild render pipeline %s, keeping the previous one: %s\n", slot->label ? slot->label : "", message ? message : "");
+    } else if (replacement->serial < slot->appliedSerial) {
+        // A newer replacement got there first
+        wgpuRenderPipelineRelease(pipeline);
+    } else {
+        if (slot->state == PipelineReady) wgpuRenderPipelineRelease(slot->pipeline);
+        slot->pipeline = pipeline;
+        slot->state = PipelineReady;
+        slot->appliedSerial = replacement->serial;
+        slot->compileTime = now() - replacement->requestTime;
+    }
+    slot->manager->pendingCount--;
+    free(replacement);
+}
+
+bool replaceRenderPipeline(t_pipeline_manager * manager, int handle, const WGPURenderPipelineDescriptor * descriptor) {
+    if (handle < 0 || (size_t)handle >= manager->count) return false;
+    t_pipeline_replacement *replacement = malloc(sizeof(t_pipeline_replacement));
+    if (!replacement) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    t_pipeline_slot *slot = &manager->slots[handle];
+    *replacement = (t_pipeline_replacement){
+        .slot = slot,
+        .serial = ++slot->requestSerial,
+        .requestTime = now()
+    };
+    manager->pendingCount++;
+    wgpuDeviceCreateRenderPipelineAsync(manager->device, descriptor, onPipelineReplaced, replacement);
+    return true;
+}
+
+size_t pollPipelineManager(t_pipeline_manager * manager) {
+    if (manager->pendingCount > 0) wgpuDeviceTick(manager->device);
+    return manager->pendingCount;
+}
+
+WGPURenderPipeline getRenderPipeline(const t_pipeline_manager * manager, int handle) {
+    if (handle < 0 || (size_t)handle >= manager->count) return NULL;
+    const t_pipeline_slot *slot = &manager->slots[handle];
+    return slot->state == PipelineReady ? slot->pipeline : slot->fallback;
+}
+
+void waitPipelineManager(t_pipeline_manager * manager) {
+    while (pollPipelineManager(manager) > 0) usleep(1000);
+}
+
+void releasePipelineManager(t_pipeline_manager * manager) {
+    // A pending callback would write into the slots
+    waitPipelineManager(manager);
+    for (size_t i = 0; i < manager->count; i++) {
+        if (manager->slots[i].state == PipelineReady) wgpuRenderPipelineRelease(manager->slots[i].pipeline);
+    }
+    manager->count = 0;
+}
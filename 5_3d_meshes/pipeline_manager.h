@@ -0,0 +1,73 @@
+#ifndef PIPELINE_MANAGER_HEADER_FILE
+#define PIPELINE_MANAGER_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//  ------------------------------- Pipeline manager------------------------------------------------------------------
+// Render pipelines built with wgpuDeviceCreateRenderPipelineAsync, so the frame
+// loop can run while the backend compiles them. Request every pipeline up
+// front, poll once per frame, and draw with whatever getRenderPipeline() gives:
+// the compiled pipeline once its callback fired, until then the fallback
+// (which may be NULL, e.g. to only clear the frame).
+//
+// A pipeline can be rebuilt later, e.g. after a shader edit: the replacement
+// compiles in the background too and takes the slot's place only once it has
+// compiled, while the old one keeps drawing. A failed replacement is dropped.
+
+#define PIPELINE_MANAGER_MAX_PIPELINES 16
+
+typedef enum PipelineState {
+    PipelinePending,
+    PipelineReady,
+    PipelineFailed,
+} t_pipeline_state;
+
+typedef struct PipelineSlot {
+    struct PipelineManager * manager;
+    t_pipeline_state state;
+    WGPURenderPipeline pipeline;
+    WGPURenderPipeline fallback;
+    const char * label;
+    double requestTime;         // seconds, CLOCK_MONOTONIC
+    double compileTime;         // seconds from request to callback
+    unsigned requestSerial;     // replacements requested
+    unsigned appliedSerial;     // newest one in place, older ones finishing late are dropped
+} t_pipeline_slot;
+
+// The callbacks point into slots: don't move a manager with pending pipelines
+typedef struct PipelineManager {
+    WGPUDevice device;
+    size_t count;
+    size_t pendingCount;
+    t_pipeline_slot slots[PIPELINE_MANAGER_MAX_PIPELINES];
+} t_pipeline_manager;
+
+void initPipelineManager(t_pipeline_manager * manager, WGPUDevice device);
+
+// Starts compiling a pipeline and returns its handle, or -1 when the manager
+// is full. The descriptor only needs to live through the call, its label as
+// long as the manager.
+int requestRenderPipeline(t_pipeline_manager * manager, const WGPURenderPipelineDescriptor * descriptor, WGPURenderPipeline fallback);
+
+// Compiles a new pipeline for the handle. Until it is ready (and for good if
+// it fails) getRenderPipeline() keeps returning the current one. The swap
+// happens inside pollPipelineManager() (or this call, when Dawn calls back
+// right away): call both between frames.
+bool replaceRenderPipeline(t_pipeline_manager * manager, int handle, const WGPURenderPipelineDescriptor * descriptor);
+
+// Lets Dawn run the callbacks of the pipelines that finished compiling.
+// Returns the number of pipelines still pending.
+size_t pollPipelineManager(t_pipeline_manager * manager);
+
+// The compiled pipeline, or the fallback while it isn't (or failed to be)
+WGPURenderPipeline getRenderPipeline(const t_pipeline_manager * manager, int handle);
+
+// Waits for every pending pipeline, e.g. before a benchmark
+void waitPipelineManager(t_pipeline_manager * manager);
+
+// Releases the compiled pipelines (not the fallbacks)
+void releasePipelineManager(t_pipeline_manager * manager);
+
+#endif
@@ -0,0 +1,439 @@
+#include <webgpu/webgpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pipeline_registry.h"
+#include "hash.h"
+
+typedef enum ObjectKind {
+    RenderPipelineObject,
+    BindGroupLayoutObject,
+    PipelineLayoutObject,
+    SamplerObject,
+} t_object_kind;
+
+typedef struct CachedObject {
+    t_object_kind kind;
+    uint64_t hash;
+    uint8_t * key;              // canonical descriptor, NULL for uncached ones
+    size_t keyLength;
+    void * object;
+} t_cached_object;
+
+// Scenes with many materials make hundreds of entries: an open addressing
+// index over the object array keeps lookups at one or two probes.
+static struct {
+    t_cached_object * objects;
+    size_t count;
+    size_t capacity;
+    uint32_t * index;           // object index + 1, 0 for an empty slot
+    size_t indexSize;           // power of two, at least twice count
+    t_pipeline_registry_stats stats;
+} registry;
+
+// Canonical form of the descriptor being looked up, reused across calls
+static struct {
+    uint8_t * data;
+    size_t length;
+    size_t capacity;
+    bool failed;                // out of memory
+    bool chained;               // met a nextInChain
+} key;
+
+//  ------------------------------- Canonical form------------------------------------------------------------------
+
+static void putBytes(const void * bytes, size_t size) {
+    if (key.failed) return;
+    if (key.length + size > key.capacity) {
+        size_t grownCapacity = key.capacity ? key.capacity : 256;
+        while (grownCapacity < key.length + size) grownCapacity *= 2;
+        uint8_t *tmp = realloc(key.data, grownCapacity);
+        if (!tmp) {
+            printf("Memory Re-allocation failed.\n");
+            key.failed = true;
+            return;
+        }
+        key.data = tmp;
+        key.capacity = grownCapacity;
+    }
+    memcpy(key.data + key.length, bytes, size);
+    key.length += size;
+}
+
+static void putU32(uint32_t value) {
+    putBytes(&value, sizeof(value));
+}
+
+static void putU64(uint64_t value) {
+    putBytes(&value, sizeof(value));
+}
+
+static void putFloat(float value) {
+    putBytes(&value, sizeof(value));
+}
+
+static void putHandle(const void * handle) {
+    putBytes(&handle, sizeof(handle));
+}
+
+// Length first, so "ab" + "c" and "a" + "bc" differ
+static void putString(const char * string) {
+    if (!string) {
+        putU64(UINT64_MAX);
+        return;
+    }
+    size_t length = strlen(string);
+    putU64(length);
+    putBytes(string, length);
+}
+
+static void checkChain(const WGPUChainedStruct * chain) {
+    if (chain) key.chained = true;
+}
+
+static void beginKey(void) {
+    key.length = 0;
+    key.failed = false;
+    key.chained = false;
+}
+
+static int compareConstants(const void * a, const void * b) {
+    const WGPUConstantEntry *constantA = a;
+    const WGPUConstantEntry *constantB = b;
+    return strcmp(constantA->key, constantB->key);
+}
+
+// Constants by key: their order in the descriptor doesn't matter to Dawn
+static void putConstants(const WGPUConstantEntry * constants, size_t count) {
+    putU64(count);
+    if (count == 0) return;
+    WGPUConstantEntry *sorted = malloc(count * sizeof(WGPUConstantEntry));
+    if (!sorted) {
+        printf("Memory Allocation failed.\n");
+        key.failed = true;
+        return;
+    }
+    memcpy(sorted, constants, count * sizeof(WGPUConstantEntry));
+    qsort(sorted, count, sizeof(WGPUConstantEntry), compareConstants);
+    for (size_t i = 0; i < count; i++) {
+        checkChain(sorted[i].nextInChain);
+        putString(sorted[i].key);
+        putBytes(&sorted[i].value, sizeof(sorted[i].value));
+    }
+    free(sorted);
+}
+
+static void putStencilFace(const WGPUStencilFaceState * face) {
+    putU32(face->compare);
+    putU32(face->failOp);
+    putU32(face->depthFailOp);
+    putU32(face->passOp);
+}
+
+static void putBlendComponent(const WGPUBlendComponent * component) {
+    putU32(component->operation);
+    putU32(component->srcFactor);
+    putU32(component->dstFactor);
+}
+
+static void putRenderPipeline(const WGPURenderPipelineDescriptor * descriptor) {
+    checkChain(descriptor->nextInChain);
+    putHandle(descriptor->layout);
+
+    const WGPUVertexState *vertex = &descriptor->vertex;
+    checkChain(vertex->nextInChain);
+    putHandle(vertex->module);
+    putString(vertex->entryPoint);
+    putConstants(vertex->constants, vertex->constantCount);
+    putU64(vertex->bufferCount);
+    for (size_t i = 0; i < vertex->bufferCount; i++) {
+        const WGPUVertexBufferLayout *buffer = &vertex->buffers[i];
+        putU64(buffer->arrayStride);
+        putU32(buffer->stepMode);
+        putU64(buffer->attributeCount);
+        for (size_t j = 0; j < buffer->attributeCount; j++) {
+            putU32(buffer->attributes[j].format);
+            putU64(buffer->attributes[j].offset);
+            putU32(buffer->attributes[j].shaderLocation);
+        }
+    }
+
+    const WGPUPrimitiveState *primitive = &descriptor->primitive;
+    checkChain(primitive->nextInChain);
+    putU32(primitive->topology);
+    putU32(primitive->stripIndexFormat);
+    putU32(primitive->frontFace);
+    putU32(primitive->cullMode);
+
+    const WGPUDepthStencilState *depthStencil = descriptor->depthStencil;
+    putU32(depthStencil != NULL);
+    if (depthStencil) {
+        checkChain(depthStencil->nextInChain);
+        putU32(depthStencil->format);
+        putU32(depthStencil->depthWriteEnabled);
+        putU32(depthStencil->depthCompare);
+        putStencilFace(&depthStencil->stencilFront);
+        putStencilFace(&depthStencil->stencilBack);
+        putU32(depthStencil->stencilReadMask);
+        putU32(depthStencil->stencilWriteMask);
+        putU32((uint32_t)depthStencil->depthBias);
+        putFloat(depthStencil->depthBiasSlopeScale);
+        putFloat(depthStencil->depthBiasClamp);
+    }
+
+    const WGPUMultisampleState *multisample = &descriptor->multisample;
+    checkChain(multisample->nextInChain);
+    putU32(multisample->count);
+    putU32(multisample->mask);
+    putU32(multisample->alphaToCoverageEnabled);
+
+    const WGPUFragmentState *fragment = descriptor->fragment;
+    putU32(fragment != NULL);
+    if (fragment) {
+        checkChain(fragment->nextInChain);
+        putHandle(fragment->module);
+        putString(fragment->entryPoint);
+        putConstants(fragment->constants, fragment->constantCount);
+        putU64(fragment->targetCount);
+        for (size_t i = 0; i < fragment->targetCount; i++) {
+            const WGPUColorTargetState *target = &fragment->targets[i];
+            checkChain(target->nextInChain);
+            putU32(target->format);
+            putU32(target->writeMask);
+            putU32(target->blend != NULL);
+            if (target->blend) {
+                putBlendComponent(&target->blend->color);
+                putBlendComponent(&target->blend->alpha);
+            }
+        }
+    }
+}
+
+static int compareBindings(const void * a, const void * b) {
+    const WGPUBindGroupLayoutEntry *entryA = a;
+    const WGPUBindGroupLayoutEntry *entryB = b;
+    return (entryA->binding > entryB->binding) - (entryA->binding < entryB->binding);
+}
+
+static void putBindGroupLayout(const WGPUBindGroupLayoutDescriptor * descriptor) {
+    checkChain(descriptor->nextInChain);
+    putU64(descriptor->entryCount);
+    if (descriptor->entryCount == 0) return;
+    WGPUBindGroupLayoutEntry *entries = malloc(descriptor->entryCount * sizeof(WGPUBindGroupLayoutEntry));
+    if (!entries) {
+        printf("Memory Allocation failed.\n");
+        key.failed = true;
+        return;
+    }
+    memcpy(entries, descriptor->entries, descriptor->entryCount * sizeof(WGPUBindGroupLayoutEntry));
+    qsort(entries, descriptor->entryCount, sizeof(WGPUBindGroupLayoutEntry), compareBindings);
+    for (size_t i = 0; i < descriptor->entryCount; i++) {
+        const WGPUBindGroupLayoutEntry *entry = &entries[i];
+        checkChain(entry->nextInChain);
+        checkChain(entry->buffer.nextInChain);
+        checkChain(entry->sampler.nextInChain);
+        checkChain(entry->texture.nextInChain);
+        checkChain(entry->storageTexture.nextInChain);
+        putU32(entry->binding);
+        putU32(entry->visibility);
+        putU32(entry->buffer.type);
+        putU32(entry->buffer.hasDynamicOffset);
+        putU64(entry->buffer.minBindingSize);
+        putU32(entry->sampler.type);
+        putU32(entry->texture.sampleType);
+        putU32(entry->texture.viewDimension);
+        putU32(entry->texture.multisampled);
+        putU32(entry->storageTexture.access);
+        putU32(entry->storageTexture.format);
+        putU32(entry->storageTexture.viewDimension);
+    }
+    free(entries);
+}
+
+static void putPipelineLayout(const WGPUPipelineLayoutDescriptor * descriptor) {
+    checkChain(descriptor->nextInChain);
+    putU64(descriptor->bindGroupLayoutCount);
+    for (size_t i = 0; i < descriptor->bindGroupLayoutCount; i++) putHandle(descriptor->bindGroupLayouts[i]);
+}
+
+static void putSampler(const WGPUSamplerDescriptor * descriptor) {
+    checkChain(descriptor->nextInChain);
+    putU32(descriptor->addressModeU);
+    putU32(descriptor->addressModeV);
+    putU32(descriptor->addressModeW);
+    putU32(descriptor->magFilter);
+    putU32(descriptor->minFilter);
+    putU32(descriptor->mipmapFilter);
+    putFloat(descriptor->lodMinClamp);
+    putFloat(descriptor->lodMaxClamp);
+    putU32(descriptor->compare);
+    putU32(descriptor->maxAnisotropy);
+}
+
+//  ------------------------------- Lookup------------------------------------------------------------------
+
+static bool growIndex(void) {
+    size_t indexSize = registry.indexSize ? registry.indexSize * 2 : 64;
+    uint32_t *index = calloc(indexSize, sizeof(uint32_t));
+    if (!index) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    for (size_t i = 0; i < registry.count; i++) {
+        if (!registry.objects[i].key) continue;
+        size_t slot = registry.objects[i].hash & (indexSize - 1);
+        while (index[slot]) slot = (slot + 1) & (indexSize - 1);
+        index[slot] = (uint32_t)i + 1;
+    }
+    free(registry.index);
+    registry.index = index;
+    registry.indexSize = indexSize;
+    return true;
+}
+
+static t_cached_object * findObject(t_object_kind kind, uint64_t hash) {
+    if (registry.indexSize == 0) return NULL;
+    size_t i = hash & (registry.indexSize - 1);
+    for (; registry.index[i]; i = (i + 1) & (registry.indexSize - 1)) {
+        t_cached_object *entry = &registry.objects[registry.index[i] - 1];
+        if (entry->hash == hash && entry->kind == kind && entry->keyLength == key.length &&
+            memcmp(entry->key, key.data, key.length) == 0) return entry;
+    }
+    return NULL;
+}
+
+// Takes ownership of object, remembering it under the current key if there is one
+static void addObject(t_object_kind kind, uint64_t hash, void * object) {
+    if (registry.count == registry.capacity) {
+        size_t grownCapacity = registry.capacity ? registry.capacity * 2 : 32;
+        t_cached_object *tmp = realloc(registry.objects, grownCapacity * sizeof(t_cached_object));
+        if (!tmp) {
+            // Not remembering it only costs a creation next time, but it leaks
+            printf("Memory Re-allocation failed.\n");
+            return;
+        }
+        registry.objects = tmp;
+        registry.capacity = grownCapacity;
+    }
+    t_cached_object *entry = &registry.objects[registry.count];
+    *entry = (t_cached_object){.kind = kind, .hash = hash, .object = object};
+    bool keyed = !key.failed && !key.chained;
+    if (keyed && (entry->key = malloc(key.length))) {
+        memcpy(entry->key, key.data, key.length);
+        entry->keyLength = key.length;
+    }
+    registry.count++;
+    if (!entry->key) return;
+    // Growing places every keyed object, this one included
+    if (2 * registry.count > registry.indexSize) {
+        growIndex();
+        return;
+    }
+    size_t slot = hash & (registry.indexSize - 1);
+    while (registry.index[slot]) slot = (slot + 1) & (registry.indexSize - 1);
+    registry.index[slot] = (uint32_t)registry.count;
+}
+
+// Finds the object for the key built since beginKey(), or NULL on a miss
+static void * lookup(t_object_kind kind, uint64_t * hash) {
+    *hash = hashBytes(key.data, key.length, kind);
+    if (key.failed || key.chained) {
+        registry.stats.uncached++;
+        return NULL;
+    }
+    t_cached_object *entry = findObject(kind, *hash);
+    if (!entry) {
+        registry.stats.misses++;
+        return NULL;
+    }
+    registry.stats.hits++;
+    return entry->object;
+}
+
+//  ------------------------------- Public------------------------------------------------------------------
+
+WGPURenderPipeline getCachedRenderPipeline(WGPUDevice device, const WGPURenderPipelineDescriptor * descriptor) {
+    beginKey();
+    putHandle(device);
+    putRenderPipeline(descriptor);
+    uint64_t hash;
+    WGPURenderPipeline pipeline = lookup(RenderPipelineObject, &hash);
+    if (pipeline) return pipeline;
+    pipeline = wgpuDeviceCreateRenderPipeline(device, descriptor);
+    if (pipeline) addObject(RenderPipelineObject, hash, pipeline);
+    return pipeline;
+}
+
+WGPUBindGroupLayout getCachedBindGroupLayout(WGPUDevice device, const WGPUBindGroupLayoutDescriptor * descriptor) {
+    beginKey();
+    putHandle(device);
+    putBindGroupLayout(descriptor);
+    uint64_t hash;
+    WGPUBindGroupLayout layout = lookup(BindGroupLayoutObject, &hash);
+    if (layout) return layout;
+    layout = wgpuDeviceCreateBindGroupLayout(device, descriptor);
+    if (layout) addObject(BindGroupLayoutObject, hash, layout);
+    return layout;
+}
+
+WGPUPipelineLayout getCachedPipelineLayout(WGPUDevice device, const WGPUPipelineLayoutDescriptor * descriptor) {
+    beginKey();
+    putHandle(device);
+    putPipelineLayout(descriptor);
+    uint64_t hash;
+    WGPUPipelineLayout layout = lookup(PipelineLayoutObject, &hash);
+    if (layout) return layout;
+    layout = wgpuDeviceCreatePipelineLayout(device, descriptor);
+    if (layout) addObject(PipelineLayoutObject, hash, layout);
+    return layout;
+}
+
+WGPUSampler getCachedSampler(WGPUDevice device, const WGPUSamplerDescriptor * descriptor) {
+    beginKey();
+    putHandle(device);
+    putSampler(descriptor);
+    uint64_t hash;
+    WGPUSampler sampler = lookup(SamplerObject, &hash);
+    if (sampler) return sampler;
+    sampler = wgpuDeviceCreateSampler(device, descriptor);
+    if (sampler) addObject(SamplerObject, hash, sampler);
+    return sampler;
+}
+
+uint64_t hashRenderPipelineDescriptor(const WGPURenderPipelineDescriptor * descriptor) {
+    beginKey();
+    putRenderPipeline(descriptor);
+    if (key.failed || key.chained) return 0;
+    return hashBytes(key.data, key.length, RenderPipelineObject);
+}
+
+t_pipeline_registry_stats getPipelineRegistryStats(void) {
+    return registry.stats;
+}
+
+void printPipelineRegistryStats(void) {
+    printf("Pipeline registry: %zu hits, %zu misses, %zu uncached\n", registry.stats.hits, registry.stats.misses, registry.stats.uncached);
+}
+
+void releasePipelineRegistry(void) {
+    // Pipelines before the layouts they were made with
+    for (size_t i = registry.count; i-- > 0;) {
+        t_cached_object *entry = &registry.objects[i];
+        switch (entry->kind) {
+        case RenderPipelineObject: wgpuRenderPipelineRelease(entry->object); break;
+        case BindGroupLayoutObject: wgpuBindGroupLayoutRelease(entry->object); break;
+        case PipelineLayoutObject: wgpuPipelineLayoutRelease(entry->object); break;
+        case SamplerObject: wgpuSamplerRelease(entry->object); break;
+        }
+        free(entry->key);
+    }
+    free(registry.objects);
+    free(registry.index);
+    free(key.data);
+    registry.objects = NULL;
+    registry.index = NULL;
+    registry.count = registry.capacity = registry.indexSize = 0;
+    key.data = NULL;
+    key.length = key.capacity = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef PIPELINE_REGISTRY_HEADER_FILE
+#define PIPELINE_REGISTRY_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//  ------------------------------- Pipeline registry------------------------------------------------------------------
+// One render pipeline, bind group layout, pipeline layout and sampler per
+// distinct descriptor and device, for the whole process. Each descriptor is
+// written out in a canonical form (every nested state in a fixed order, bind
+// group layout entries sorted by binding, constants sorted by key, labels
+// left out), which is hashed with hashBytes() and compared in full on a hit.
+// Materials that end up with the same state then share one compiled pipeline.
+//
+// Objects are keyed by the handles they refer to (shader modules, layouts),
+// so get those from the registries too: modules from the shader registry,
+// layouts from here. Descriptors with extension chains (nextInChain) can't
+// be compared: they are created every time, and still owned by the registry.
+//
+// The registry owns the objects: don't release them, call
+// releasePipelineRegistry() once done with the device. Not thread safe.
+
+typedef struct PipelineRegistryStats {
+    size_t hits;        // descriptors that matched an existing object
+    size_t misses;      // objects created
+    size_t uncached;    // objects created from chained descriptors
+} t_pipeline_registry_stats;
+
+WGPURenderPipeline getCachedRenderPipeline(WGPUDevice device, const WGPURenderPipelineDescriptor * descriptor);
+WGPUBindGroupLayout getCachedBindGroupLayout(WGPUDevice device, const WGPUBindGroupLayoutDescriptor * descriptor);
+WGPUPipelineLayout getCachedPipelineLayout(WGPUDevice device, const WGPUPipelineLayoutDescriptor * descriptor);
+WGPUSampler getCachedSampler(WGPUDevice device, const WGPUSamplerDescriptor * descriptor);
+
+// Hash of the canonical form, e.g. to sort draws by pipeline state.
+// Returns 0 for a chained descriptor.
+uint64_t hashRenderPipelineDescriptor(const WGPURenderPipelineDescriptor * descriptor);
+
+t_pipeline_registry_stats getPipelineRegistryStats(void);
+// Prints them on one line
+void printPipelineRegistryStats(void);
+
+// Releases every object and forgets every descriptor
+void releasePipelineRegistry(void);
+
+#endif
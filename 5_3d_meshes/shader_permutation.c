@@ -0,0 +1,41 @@
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wgsl_preprocessor.h"
+#include "shader_registry.h"
+
+//  ------------------------------- Permutations------------------------------------------------------------------
+
+typedef struct Permutation {
+    const char * path;
+    const t_wgsl_define * defines;
+    size_t defineCount;
+} t_permutation;
+
+static char * preprocessPermutation(const char * source, size_t length, void * userData, size_t * variantLength) {
+    t_permutation *permutation = userData;
+    return preprocessWgsl(permutation->path, source, length, permutation->defines, permutation->defineCount, variantLength);
+}
+
+WGPUShaderModule loadShaderPermutation(WGPUDevice device, const char * path, const t_wgsl_define * defines, size_t defineCount) {
+    // The registry's variant name: "#NAME=value;..." ('#' so that no defines
+    // still differs from the file as is)
+    size_t keyLength = 2;
+    for (size_t i = 0; i < defineCount; i++) {
+        keyLength += strlen(defines[i].name) + (defines[i].value ? strlen(defines[i].value) : 0) + 2;
+    }
+    char *key = malloc(keyLength);
+    if (!key) {
+        printf("Memory Allocation failed.\n");
+        return NULL;
+    }
+    size_t used = snprintf(key, keyLength, "#");
+    for (size_t i = 0; i < defineCount; i++) {
+        used += snprintf(key + used, keyLength - used, "%s=%s;", defines[i].name, defines[i].value ? defines[i].value : "");
+    }
+    t_permutation permutation = {path, defines, defineCount};
+    WGPUShaderModule module = loadShaderVariant(device, path, key, preprocessPermutation, &permutation);
+    free(key);
+    return module;
+}
@@ -0,0 +1,336 @@
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "tint/tint.h"
+extern "C" {
+#include "wgsl_preprocessor.h"
+#include "embedded_shaders.h"
+#include "pipeline_registry.h"
+}
+#include "shader_reflection.h"
+
+using tint::inspector::ComponentType;
+using tint::inspector::CompositionType;
+using tint::inspector::EntryPoint;
+using tint::inspector::PipelineStage;
+using tint::inspector::ResourceBinding;
+
+//  ------------------------------- Tint to WebGPU------------------------------------------------------------------
+
+static WGPUTextureViewDimension viewDimension(ResourceBinding::TextureDimension dimension) {
+    switch (dimension) {
+        case ResourceBinding::TextureDimension::k1d: return WGPUTextureViewDimension_1D;
+        case ResourceBinding::TextureDimension::k2d: return WGPUTextureViewDimension_2D;
+        case ResourceBinding::TextureDimension::k2dArray: return WGPUTextureViewDimension_2DArray;
+        case ResourceBinding::TextureDimension::k3d: return WGPUTextureViewDimension_3D;
+        case ResourceBinding::TextureDimension::kCube: return WGPUTextureViewDimension_Cube;
+        case ResourceBinding::TextureDimension::kCubeArray: return WGPUTextureViewDimension_CubeArray;
+        default: return WGPUTextureViewDimension_Undefined;
+    }
+}
+
+static WGPUTextureSampleType sampleType(ResourceBinding::SampledKind kind) {
+    switch (kind) {
+        // Filterable: the shader may sample it with a filtering sampler
+        case ResourceBinding::SampledKind::kFloat: return WGPUTextureSampleType_Float;
+        case ResourceBinding::SampledKind::kSInt: return WGPUTextureSampleType_Sint;
+        case ResourceBinding::SampledKind::kUInt: return WGPUTextureSampleType_Uint;
+        default: return WGPUTextureSampleType_Undefined;
+    }
+}
+
+static WGPUTextureFormat storageFormat(ResourceBinding::TexelFormat format) {
+    switch (format) {
+        case ResourceBinding::TexelFormat::kBgra8Unorm: return WGPUTextureFormat_BGRA8Unorm;
+        case ResourceBinding::TexelFormat::kRgba8Unorm: return WGPUTextureFormat_RGBA8Unorm;
+        case ResourceBinding::TexelFormat::kRgba8Snorm: return WGPUTextureFormat_RGBA8Snorm;
+        case ResourceBinding::TexelFormat::kRgba8Uint: return WGPUTextureFormat_RGBA8Uint;
+        case ResourceBinding::TexelFormat::kRgba8Sint: return WGPUTextureFormat_RGBA8Sint;
+        case ResourceBinding::TexelFormat::kRgba16Uint: return WGPUTextureFormat_RGBA16Uint;
+        case ResourceBinding::TexelFormat::kRgba16Sint: return WGPUTextureFormat_RGBA16Sint;
+        case ResourceBinding::TexelFormat::kRgba16Float: return WGPUTextureFormat_RGBA16Float;
+        case ResourceBinding::TexelFormat::kR32Uint: return WGPUTextureFormat_R32Uint;
+        case ResourceBinding::TexelFormat::kR32Sint: return WGPUTextureFormat_R32Sint;
+        case ResourceBinding::TexelFormat::kR32Float: return WGPUTextureFormat_R32Float;
+        case ResourceBinding::TexelFormat::kRg32Uint: return WGPUTextureFormat_RG32Uint;
+        case ResourceBinding::TexelFormat::kRg32Sint: return WGPUTextureFormat_RG32Sint;
+        case ResourceBinding::TexelFormat::kRg32Float: return WGPUTextureFormat_RG32Float;
+        case ResourceBinding::TexelFormat::kRgba32Uint: return WGPUTextureFormat_RGBA32Uint;
+        case ResourceBinding::TexelFormat::kRgba32Sint: return WGPUTextureFormat_RGBA32Sint;
+        case ResourceBinding::TexelFormat::kRgba32Float: return WGPUTextureFormat_RGBA32Float;
+        default: return WGPUTextureFormat_Undefined;
+    }
+}
+
+static WGPUShaderStageFlags stageFlag(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::kVertex: return WGPUShaderStage_Vertex;
+        case PipelineStage::kFragment: return WGPUShaderStage_Fragment;
+        default: return WGPUShaderStage_Compute;
+    }
+}
+
+// Undefined for the types vertex buffers can't feed (f16 needs a feature)
+static WGPUVertexFormat vertexFormat(ComponentType component, CompositionType composition) {
+    static const WGPUVertexFormat floats[] = {WGPUVertexFormat_Float32, WGPUVertexFormat_Float32x2, WGPUVertexFormat_Float32x3, WGPUVertexFormat_Float32x4};
+    static const WGPUVertexFormat uints[] = {WGPUVertexFormat_Uint32, WGPUVertexFormat_Uint32x2, WGPUVertexFormat_Uint32x3, WGPUVertexFormat_Uint32x4};
+    static const WGPUVertexFormat sints[] = {WGPUVertexFormat_Sint32, WGPUVertexFormat_Sint32x2, WGPUVertexFormat_Sint32x3, WGPUVertexFormat_Sint32x4};
+    int components;
+    switch (composition) {
+        case CompositionType::kScalar: components = 0; break;
+        case CompositionType::kVec2: components = 1; break;
+        case CompositionType::kVec3: components = 2; break;
+        case CompositionType::kVec4: components = 3; break;
+        default: return WGPUVertexFormat_Undefined;
+    }
+    switch (component) {
+        case ComponentType::kF32: return floats[components];
+        case ComponentType::kU32: return uints[components];
+        case ComponentType::kI32: return sints[components];
+        default: return WGPUVertexFormat_Undefined;
+    }
+}
+
+static uint64_t vertexFormatSize(WGPUVertexFormat format) {
+    switch (format) {
+        case WGPUVertexFormat_Float32: case WGPUVertexFormat_Uint32: case WGPUVertexFormat_Sint32: return 4;
+        case WGPUVertexFormat_Float32x2: case WGPUVertexFormat_Uint32x2: case WGPUVertexFormat_Sint32x2: return 8;
+        case WGPUVertexFormat_Float32x3: case WGPUVertexFormat_Uint32x3: case WGPUVertexFormat_Sint32x3: return 12;
+        default: return 16;
+    }
+}
+
+//  ------------------------------- Reflection------------------------------------------------------------------
+
+static bool makeEntry(const ResourceBinding & resource, WGPUShaderStageFlags stage, const char * path, WGPUBindGroupLayoutEntry * entry) {
+    *entry = WGPUBindGroupLayoutEntry{};
+    entry->binding = resource.binding;
+    entry->visibility = stage;
+    switch (resource.resource_type) {
+        case ResourceBinding::ResourceType::kUniformBuffer:
+            entry->buffer.type = WGPUBufferBindingType_Uniform;
+            entry->buffer.minBindingSize = resource.size;
+            return true;
+        case ResourceBinding::ResourceType::kStorageBuffer:
+            entry->buffer.type = WGPUBufferBindingType_Storage;
+            entry->buffer.minBindingSize = resource.size;
+            return true;
+        case ResourceBinding::ResourceType::kReadOnlyStorageBuffer:
+            entry->buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+            entry->buffer.minBindingSize = resource.size;
+            return true;
+        case ResourceBinding::ResourceType::kSampler:
+            // WGSL has one sampler type for both: markNonFilteringSamplers()
+            // downgrades the ones a texture needs non-filtering
+            entry->sampler.type = WGPUSamplerBindingType_Filtering;
+            return true;
+        case ResourceBinding::ResourceType::kComparisonSampler:
+            entry->sampler.type = WGPUSamplerBindingType_Comparison;
+            return true;
+        case ResourceBinding::ResourceType::kSampledTexture:
+        case ResourceBinding::ResourceType::kMultisampledTexture:
+            entry->texture.sampleType = sampleType(resource.sampled_kind);
+            entry->texture.viewDimension = viewDimension(resource.dim);
+            entry->texture.multisampled = resource.resource_type == ResourceBinding::ResourceType::kMultisampledTexture;
+            return true;
+        case ResourceBinding::ResourceType::kDepthTexture:
+        case ResourceBinding::ResourceType::kDepthMultisampledTexture:
+            entry->texture.sampleType = WGPUTextureSampleType_Depth;
+            entry->texture.viewDimension = viewDimension(resource.dim);
+            entry->texture.multisampled = resource.resource_type == ResourceBinding::ResourceType::kDepthMultisampledTexture;
+            return true;
+        case ResourceBinding::ResourceType::kWriteOnlyStorageTexture:
+            entry->storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+            entry->storageTexture.format = storageFormat(resource.image_format);
+            entry->storageTexture.viewDimension = viewDimension(resource.dim);
+            return true;
+        default:
+            // External textures go in a chained struct, the registry can't key those
+            printf("%s: @group(%u) @binding(%u) can't be described by a bind group layout entry\n", path, resource.bind_group, resource.binding);
+            return false;
+    }
+}
+
+static bool addBinding(t_shader_reflection * reflection, const ResourceBinding & resource, WGPUShaderStageFlags stage, const char * path) {
+    if (resource.bind_group >= SHADER_REFLECTION_MAX_GROUPS) {
+        printf("%s: @group(%u), only %d groups are reflected\n", path, resource.bind_group, SHADER_REFLECTION_MAX_GROUPS);
+        return false;
+    }
+    WGPUBindGroupLayoutEntry entry;
+    if (!makeEntry(resource, stage, path, &entry)) return false;
+    WGPUBindGroupLayoutEntry *existing = findReflectedBinding(reflection, resource.bind_group, resource.binding);
+    if (existing) {
+        // Another entry point uses it too
+        WGPUShaderStageFlags visibility = existing->visibility | stage;
+        existing->visibility = entry.visibility = visibility;
+        if (memcmp(existing, &entry, sizeof(entry)) != 0) {
+            printf("%s: entry points disagree on @group(%u) @binding(%u)\n", path, resource.bind_group, resource.binding);
+            return false;
+        }
+        return true;
+    }
+    size_t *count = &reflection->entryCounts[resource.bind_group];
+    if (*count == SHADER_REFLECTION_MAX_BINDINGS) {
+        printf("%s: more than %d bindings in @group(%u)\n", path, SHADER_REFLECTION_MAX_BINDINGS, resource.bind_group);
+        return false;
+    }
+    // Kept sorted by binding
+    WGPUBindGroupLayoutEntry *entries = reflection->entries[resource.bind_group];
+    size_t i = *count;
+    while (i > 0 && entries[i - 1].binding > entry.binding) {
+        entries[i] = entries[i - 1];
+        i--;
+    }
+    entries[i] = entry;
+    (*count)++;
+    if (resource.bind_group + 1 > reflection->groupCount) reflection->groupCount = resource.bind_group + 1;
+    return true;
+}
+
+static bool addVertexInputs(t_shader_reflection * reflection, const EntryPoint & entryPoint, const char * path) {
+    for (const auto & input : entryPoint.input_variables) {
+        // Builtins such as @builtin(instance_index) aren't fed by buffers
+        if (!input.has_location_attribute) continue;
+        WGPUVertexFormat format = vertexFormat(input.component_type, input.composition_type);
+        if (format == WGPUVertexFormat_Undefined) {
+            printf("%s: vertex input %s has a type vertex buffers can't provide\n", path, input.name.c_str());
+            return false;
+        }
+        if (reflection->vertexAttributeCount == SHADER_REFLECTION_MAX_INPUTS) {
+            printf("%s: more than %d vertex inputs\n", path, SHADER_REFLECTION_MAX_INPUTS);
+            return false;
+        }
+        WGPUVertexAttribute *attributes = reflection->vertexAttributes;
+        size_t i = reflection->vertexAttributeCount++;
+        while (i > 0 && attributes[i - 1].shaderLocation > input.location_attribute) {
+            attributes[i] = attributes[i - 1];
+            i--;
+        }
+        attributes[i] = WGPUVertexAttribute{format, 0, input.location_attribute};
+    }
+    return true;
+}
+
+// A filtering sampler may only sample Float textures. Depth textures read with
+// textureSample() rather than a comparison need a NonFiltering one.
+// UnfilterableFloat textures would too, but WGSL can't tell those apart.
+template <typename Pairs>
+static void markNonFilteringSamplers(t_shader_reflection * reflection, const Pairs & pairs) {
+    for (const auto & pair : pairs) {
+        WGPUBindGroupLayoutEntry *texture = findReflectedBinding(reflection, pair.texture_binding_point.group, pair.texture_binding_point.binding);
+        WGPUBindGroupLayoutEntry *sampler = findReflectedBinding(reflection, pair.sampler_binding_point.group, pair.sampler_binding_point.binding);
+        if (!texture || !sampler || sampler->sampler.type != WGPUSamplerBindingType_Filtering) continue;
+        if (texture->texture.sampleType == WGPUTextureSampleType_Depth) sampler->sampler.type = WGPUSamplerBindingType_NonFiltering;
+    }
+}
+
+static bool isListed(const std::string & name, const char * const * entryPoints, size_t entryPointCount) {
+    for (size_t i = 0; i < entryPointCount; i++) {
+        if (name == entryPoints[i]) return true;
+    }
+    return entryPoints == NULL;
+}
+
+bool reflectWgsl(const char * source, const char * path, const char * const * entryPoints, size_t entryPointCount,
+    t_shader_reflection * reflection) {
+    *reflection = t_shader_reflection{};
+    tint::Source::File file(path, source);
+    tint::Program program = tint::reader::wgsl::Parse(&file);
+    if (!program.IsValid()) {
+        printf("can't reflect shader:\n %s\n%s\n", path, program.Diagnostics().str().c_str());
+        return false;
+    }
+    tint::inspector::Inspector inspector(&program);
+    std::vector<EntryPoint> shaderEntryPoints = inspector.GetEntryPoints();
+    size_t found = 0;
+    bool haveVertexInputs = false;
+    std::vector<decltype(inspector.GetSamplerTextureUses(""))> samplerTextureUses;
+    for (const EntryPoint & entryPoint : shaderEntryPoints) {
+        if (!isListed(entryPoint.name, entryPoints, entryPointCount)) continue;
+        found++;
+        WGPUShaderStageFlags stage = stageFlag(entryPoint.stage);
+        for (const ResourceBinding & resource : inspector.GetResourceBindings(entryPoint.name)) {
+            if (!addBinding(reflection, resource, stage, path)) return false;
+        }
+        // Once every entry point is in, their entries compare as Filtering
+        samplerTextureUses.push_back(inspector.GetSamplerTextureUses(entryPoint.name));
+        // One vertex stage per pipeline: the first one listed
+        if (entryPoint.stage == PipelineStage::kVertex && !haveVertexInputs) {
+            if (!addVertexInputs(reflection, entryPoint, path)) return false;
+            haveVertexInputs = true;
+        }
+    }
+    if (inspector.has_error()) {
+        printf("can't reflect shader:\n %s\n%s\n", path, inspector.error().c_str());
+        return false;
+    }
+    if (entryPoints && found != entryPointCount) {
+        printf("%s lacks some of the %zu entry points asked for\n", path, entryPointCount);
+        return false;
+    }
+    for (const auto & pairs : samplerTextureUses) markNonFilteringSamplers(reflection, pairs);
+    return true;
+}
+
+bool reflectShader(const char * path, const t_wgsl_define * defines, size_t defineCount,
+    const char * const * entryPoints, size_t entryPointCount, t_shader_reflection * reflection) {
+    size_t length;
+    char *text = readShaderSource(path, &length);
+    if (!text) return false;
+    size_t sourceLength;
+    char *source = preprocessWgsl(path, text, length, defines, defineCount, &sourceLength);
+    free(text);
+    if (!source) return false;
+    bool reflected = reflectWgsl(source, path, entryPoints, entryPointCount, reflection);
+    free(source);
+    return reflected;
+}
+
+WGPUBindGroupLayoutEntry * findReflectedBinding(t_shader_reflection * reflection, uint32_t group, uint32_t binding) {
+    if (group >= SHADER_REFLECTION_MAX_GROUPS) return NULL;
+    for (size_t i = 0; i < reflection->entryCounts[group]; i++) {
+        if (reflection->entries[group][i].binding == binding) return &reflection->entries[group][i];
+    }
+    return NULL;
+}
+
+//  ------------------------------- Layouts------------------------------------------------------------------
+
+WGPUBindGroupLayout getReflectedBindGroupLayout(WGPUDevice device, const t_shader_reflection * reflection, uint32_t group) {
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+    if (group < SHADER_REFLECTION_MAX_GROUPS) {
+        bindGroupLayoutDesc.entryCount = reflection->entryCounts[group];
+        bindGroupLayoutDesc.entries = reflection->entries[group];
+    }
+    return getCachedBindGroupLayout(device, &bindGroupLayoutDesc);
+}
+
+WGPUPipelineLayout getReflectedPipelineLayout(WGPUDevice device, const t_shader_reflection * reflection) {
+    // Groups the shader skips still need a (empty) layout
+    WGPUBindGroupLayout bindGroupLayouts[SHADER_REFLECTION_MAX_GROUPS];
+    for (size_t group = 0; group < reflection->groupCount; group++) {
+        bindGroupLayouts[group] = getReflectedBindGroupLayout(device, reflection, group);
+    }
+    WGPUPipelineLayoutDescriptor layoutDesc = {};
+    layoutDesc.bindGroupLayoutCount = reflection->groupCount;
+    layoutDesc.bindGroupLayouts = bindGroupLayouts;
+    return getCachedPipelineLayout(device, &layoutDesc);
+}
+
+WGPUVertexBufferLayout getReflectedVertexBuffer(t_shader_reflection * reflection, uint32_t firstLocation, uint32_t locationCount,
+    WGPUVertexStepMode stepMode) {
+    WGPUVertexBufferLayout layout = {};
+    layout.stepMode = stepMode;
+    // Sorted by location, so the inputs in range are next to each other
+    for (size_t i = 0; i < reflection->vertexAttributeCount; i++) {
+        WGPUVertexAttribute *attribute = &reflection->vertexAttributes[i];
+        if (attribute->shaderLocation < firstLocation || attribute->shaderLocation - firstLocation >= locationCount) continue;
+        if (layout.attributeCount == 0) layout.attributes = attribute;
+        attribute->offset = layout.arrayStride;
+        layout.arrayStride += vertexFormatSize(attribute->format);
+        layout.attributeCount++;
+    }
+    return layout;
+}
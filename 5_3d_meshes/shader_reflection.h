@@ -0,0 +1,73 @@
+#ifndef SHADER_REFLECTION_HEADER_FILE
+#define SHADER_REFLECTION_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wgsl_preprocessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  ------------------------------- Shader reflection------------------------------------------------------------------
+// What a WGSL shader expects from the pipeline, read by Tint's inspector (from
+// the dawn tree): every binding with its type, the stages that use it and its
+// exact minBindingSize, and the vertex inputs with their formats. Layouts made
+// from it are neither wrong nor larger than the shader needs, and with exact
+// minBindingSize values Dawn checks buffer sizes once at bind group creation
+// instead of at every draw.
+//
+// Samplers are Filtering, NonFiltering when they sample a depth texture
+// without comparing, Comparison for sampler_comparison.
+//
+// Only the entry points given are looked at (all of them for NULL), so that
+// the visibility of a binding is the stages that actually read it.
+
+#define SHADER_REFLECTION_MAX_GROUPS 4
+#define SHADER_REFLECTION_MAX_BINDINGS 16
+#define SHADER_REFLECTION_MAX_INPUTS 16
+
+typedef struct ShaderReflection {
+    // Group g's entries, sorted by binding, ready for a WGPUBindGroupLayoutDescriptor
+    WGPUBindGroupLayoutEntry entries[SHADER_REFLECTION_MAX_GROUPS][SHADER_REFLECTION_MAX_BINDINGS];
+    size_t entryCounts[SHADER_REFLECTION_MAX_GROUPS];
+    size_t groupCount;          // highest group used + 1
+    // @location inputs of the vertex entry point, sorted by location.
+    // getReflectedVertexBuffer() fills in the offsets.
+    WGPUVertexAttribute vertexAttributes[SHADER_REFLECTION_MAX_INPUTS];
+    size_t vertexAttributeCount;
+} t_shader_reflection;
+
+// Reflects WGSL source (path is for messages). entryPoints may be NULL.
+// Returns false after printing why, e.g. a binding type layouts can't express.
+bool reflectWgsl(const char * source, const char * path, const char * const * entryPoints, size_t entryPointCount,
+    t_shader_reflection * reflection);
+
+// The same for a shader file, preprocessed with the given defines
+bool reflectShader(const char * path, const t_wgsl_define * defines, size_t defineCount,
+    const char * const * entryPoints, size_t entryPointCount, t_shader_reflection * reflection);
+
+// The entry of a binding, NULL if the shader has none. For what the shader
+// can't tell: hasDynamicOffset, or an UnfilterableFloat texture (whose
+// samplers must then be made NonFiltering too).
+WGPUBindGroupLayoutEntry * findReflectedBinding(t_shader_reflection * reflection, uint32_t group, uint32_t binding);
+
+// The layout of one group, or of all groups, through the pipeline registry
+// (which owns them, see pipeline_registry.h)
+WGPUBindGroupLayout getReflectedBindGroupLayout(WGPUDevice device, const t_shader_reflection * reflection, uint32_t group);
+WGPUPipelineLayout getReflectedPipelineLayout(WGPUDevice device, const t_shader_reflection * reflection);
+
+// A vertex buffer template holding the inputs at locations
+// [firstLocation, firstLocation + locationCount), packed in location order.
+// arrayStride is their total size: set it when the buffer's elements are
+// larger. attributes points into reflection, keep it until the pipeline exists.
+WGPUVertexBufferLayout getReflectedVertexBuffer(t_shader_reflection * reflection, uint32_t firstLocation, uint32_t locationCount,
+    WGPUVertexStepMode stepMode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
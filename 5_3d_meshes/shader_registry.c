@@ -0,0 +1,207 @@
+#include <webgpu/webgpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "shader_registry.h"
+#include "hash.h"
+#include "embedded_shaders.h"
+
+// A handful of shaders per program: plain arrays searched by hash are plenty.
+typedef struct ShaderSource {
+    WGPUDevice device;
+    uint64_t hash;
+    char * source;
+    size_t length;
+    WGPUShaderModule module;
+} t_shader_source;
+
+typedef struct ShaderFile {
+    WGPUDevice device;
+    const t_embedded_shader * embedded;    // NULL for a file on disk
+    char * path;            // NULL when embedded
+    char * variant;         // "" for the file as is
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint64_t size;
+    WGPUShaderModule module;
+} t_shader_file;
+
+static struct {
+    t_shader_source * sources;
+    size_t sourceCount;
+    size_t sourceCapacity;
+    t_shader_file * files;
+    size_t fileCount;
+    size_t fileCapacity;
+    t_shader_registry_stats stats;
+} registry;
+
+static bool reserve(void ** array, size_t count, size_t * capacity, size_t elementSize) {
+    if (count < *capacity) return true;
+    size_t grownCapacity = *capacity ? *capacity * 2 : 8;
+    void *tmp = realloc(*array, grownCapacity * elementSize);
+    if (!tmp) {
+        printf("Memory Re-allocation failed.\n");
+        return false;
+    }
+    *array = tmp;
+    *capacity = grownCapacity;
+    return true;
+}
+
+static char * copyString(const char * string, size_t length) {
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        printf("Memory Allocation failed.\n");
+        return NULL;
+    }
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+WGPUShaderModule getShaderModule(WGPUDevice device, const char * source, size_t length) {
+    uint64_t hash = hashBytes(source, length, 0);
+    for (size_t i = 0; i < registry.sourceCount; i++) {
+        t_shader_source *entry = &registry.sources[i];
+        if (entry->hash == hash && entry->device == device && entry->length == length &&
+            memcmp(entry->source, source, length) == 0) {
+            registry.stats.hits++;
+            return entry->module;
+        }
+    }
+
+    WGPUShaderModuleWGSLDescriptor shaderCodeDesc = {
+        .chain = (WGPUChainedStruct){
+            .next = NULL,
+            .sType = WGPUSType_ShaderModuleWGSLDescriptor
+        },
+        .source = source
+    };
+    WGPUShaderModuleDescriptor shaderDesc = {
+        .nextInChain = &shaderCodeDesc.chain
+    };
+    WGPUShaderModule module = wgpuDeviceCreateShaderModule(device, &shaderDesc);
+    registry.stats.misses++;
+
+    // Not remembering it only costs a compilation next time
+    char *copy;
+    if (!module || !reserve((void **)&registry.sources, registry.sourceCount, &registry.sourceCapacity, sizeof(t_shader_source)) ||
+        !(copy = copyString(source, length))) return module;
+    registry.sources[registry.sourceCount++] = (t_shader_source){device, hash, copy, length, module};
+    return module;
+}
+
+static t_shader_file * findFile(WGPUDevice device, const char * path, const t_embedded_shader * embedded, const char * variant) {
+    for (size_t i = 0; i < registry.fileCount; i++) {
+        t_shader_file *entry = &registry.files[i];
+        if (entry->device != device || entry->embedded != embedded || strcmp(entry->variant, variant) != 0) continue;
+        if (embedded || strcmp(entry->path, path) == 0) return entry;
+    }
+    return NULL;
+}
+
+// NULL if it can't be remembered, which only costs a preprocessing next time
+static t_shader_file * rememberFile(WGPUDevice device, const char * path, const t_embedded_shader * embedded, const char * variant) {
+    char *pathCopy = embedded ? NULL : copyString(path, strlen(path));
+    char *variantCopy = copyString(variant, strlen(variant));
+    if ((!embedded && !pathCopy) || !variantCopy ||
+        !reserve((void **)&registry.files, registry.fileCount, &registry.fileCapacity, sizeof(t_shader_file))) {
+        free(pathCopy);
+        free(variantCopy);
+        return NULL;
+    }
+    t_shader_file *file = &registry.files[registry.fileCount++];
+    *file = (t_shader_file){.device = device, .embedded = embedded, .path = pathCopy, .variant = variantCopy};
+    return file;
+}
+
+// Embedded sources never change: a variant made once is the variant for good
+static WGPUShaderModule loadEmbeddedVariant(WGPUDevice device, const t_embedded_shader * embedded, const char * variant, t_shader_transform transform, void * userData) {
+    t_shader_file *file = findFile(device, NULL, embedded, variant);
+    if (file) {
+        registry.stats.fileHits++;
+        return file->module;
+    }
+
+    WGPUShaderModule module;
+    if (!transform) {
+        module = getShaderModule(device, embedded->source, embedded->length);
+    } else {
+        size_t variantLength;
+        char *variantText = transform(embedded->source, embedded->length, userData, &variantLength);
+        if (!variantText) return NULL;
+        module = getShaderModule(device, variantText, variantLength);
+        free(variantText);
+    }
+    if (module && (file = rememberFile(device, NULL, embedded, variant))) file->module = module;
+    return module;
+}
+
+WGPUShaderModule loadShaderVariant(WGPUDevice device, const char * path, const char * variant, t_shader_transform transform, void * userData) {
+    if (!variant) variant = "";
+    const t_embedded_shader *embedded = findEmbeddedShader(path);
+    if (embedded) return loadEmbeddedVariant(device, embedded, variant, transform, userData);
+
+    struct stat source;
+    if (stat(path, &source) != 0) {
+        printf("can't open shader file:\n %s\n", path);
+        return NULL;
+    }
+    t_shader_file *file = findFile(device, path, NULL, variant);
+    if (file && file->mtimeSec == source.st_mtim.tv_sec && file->mtimeNsec == source.st_mtim.tv_nsec &&
+        file->size == (uint64_t)source.st_size) {
+        registry.stats.fileHits++;
+        return file->module;
+    }
+
+    size_t length;
+    char *text = readShaderSource(path, &length);
+    if (!text) return NULL;
+    if (transform) {
+        size_t variantLength;
+        char *variantText = transform(text, length, userData, &variantLength);
+        free(text);
+        if (!variantText) return NULL;
+        text = variantText;
+        length = variantLength;
+    }
+    WGPUShaderModule module = getShaderModule(device, text, length);
+    free(text);
+    if (!module) return NULL;
+
+    if (!file && !(file = rememberFile(device, path, NULL, variant))) return module;
+    // A changed file keeps its old module registered: the old source may come back
+    file->mtimeSec = source.st_mtim.tv_sec;
+    file->mtimeNsec = source.st_mtim.tv_nsec;
+    file->size = source.st_size;
+    file->module = module;
+    return module;
+}
+
+t_shader_registry_stats getShaderRegistryStats(void) {
+    return registry.stats;
+}
+
+void printShaderRegistryStats(void) {
+    printf("Shader registry: %zu file hits, %zu hits, %zu misses\n", registry.stats.fileHits, registry.stats.hits, registry.stats.misses);
+}
+
+void releaseShaderRegistry(void) {
+    for (size_t i = 0; i < registry.sourceCount; i++) {
+        wgpuShaderModuleRelease(registry.sources[i].module);
+        free(registry.sources[i].source);
+    }
+    for (size_t i = 0; i < registry.fileCount; i++) {
+        free(registry.files[i].path);
+        free(registry.files[i].variant);
+    }
+    free(registry.sources);
+    free(registry.files);
+    registry.sources = NULL;
+    registry.files = NULL;
+    registry.sourceCount = registry.sourceCapacity = 0;
+    registry.fileCount = registry.fileCapacity = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef SHADER_REGISTRY_HEADER_FILE
+#define SHADER_REGISTRY_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//  ------------------------------- Shader registry------------------------------------------------------------------
+// One WGPUShaderModule per distinct WGSL source and device, for the whole
+// process. Sources are looked up by hashBytes() of their text (then compared in
+// full), so the same shader loaded twice, from one file or from several, is
+// only compiled once. Files are also remembered by path and variant for as
+// long as their mtime and size stay the same, so loading one again doesn't
+// even read it. Shaders embedded at build time (see embedded_shaders.h) are
+// taken from memory instead of the file, and remembered by name and variant
+// for good since they can't change.
+//
+// The registry owns the modules: don't release them, call
+// releaseShaderRegistry() once done with the device. Not thread safe.
+
+typedef struct ShaderRegistryStats {
+    size_t fileHits;    // loads answered without reading or preprocessing the source
+    size_t hits;        // sources that matched an existing module
+    size_t misses;      // modules created
+} t_shader_registry_stats;
+
+// Makes a variant of a file's WGSL (e.g. with defines applied). Returns a
+// malloc'd, NUL terminated source, or NULL on failure.
+typedef char * (*t_shader_transform)(const char * source, size_t length, void * userData, size_t * variantLength);
+
+// Module for source[0..length), which must be followed by a NUL
+WGPUShaderModule getShaderModule(WGPUDevice device, const char * source, size_t length);
+
+// Module for a WGSL file, run through transform when it isn't NULL. variant
+// names what transform does with userData, files are remembered per path and
+// variant. Returns NULL if the file can't be read or transformed.
+WGPUShaderModule loadShaderVariant(WGPUDevice device, const char * path, const char * variant, t_shader_transform transform, void * userData);
+
+t_shader_registry_stats getShaderRegistryStats(void);
+// Prints them on one line
+void printShaderRegistryStats(void);
+
+// Releases every module and forgets every source and file
+void releaseShaderRegistry(void);
+
+#endif
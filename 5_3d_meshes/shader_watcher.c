@@ -0,0 +1,321 @@
+#include <webgpu/webgpu.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "shader_watcher.h"
+#include "hash.h"
+#include "embedded_shaders.h"
+
+typedef struct WatchedShader {
+    // Set once by watchShader()
+    char * path;
+    int watch;                  // inotify descriptor of the directory
+    t_wgsl_define * defines;
+    size_t defineCount;
+    t_shader_reload onReload;
+    void * userData;
+    // Watcher thread only
+    uint64_t sourceHash;
+    // Protected by the mutex: latest source not yet picked up by a poll
+    char * pendingSource;
+} t_watched_shader;
+
+struct ShaderWatcher {
+    WGPUDevice device;
+    int inotifyFd;
+    int stopPipe[2];
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    t_watched_shader shaders[SHADER_WATCHER_MAX_SHADERS];
+    size_t count;
+    // Error scopes whose callback hasn't run yet (polling thread only)
+    size_t pendingScopes;
+};
+
+typedef struct ShaderCompilation {
+    t_shader_watcher * watcher;
+    t_watched_shader * shader;
+    WGPUShaderModule module;
+} t_shader_compilation;
+
+// read() rather than mapFile(): an editor may truncate the file while we read
+static char * readSource(const char * path, size_t * length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("can't open file:\n %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        printf("can't stat file:\n %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    char *source = malloc(st.st_size + 1);
+    if (!source) {
+        printf("Memory Allocation failed.\n");
+        close(fd);
+        return NULL;
+    }
+    size_t done = 0;
+    ssize_t got;
+    while (done < (size_t)st.st_size && (got = read(fd, source + done, st.st_size - done)) != 0) {
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) {
+            printf("can't read file:\n %s\n", path);
+            free(source);
+            close(fd);
+            return NULL;
+        }
+        done += got;
+    }
+    close(fd);
+    source[done] = '\0';
+    *length = done;
+    return source;
+}
+
+// Watcher thread: preprocesses the shader and queues it if it changed
+static void reloadShader(t_shader_watcher * watcher, t_watched_shader * shader) {
+    size_t length;
+    char *text = readSource(shader->path, &length);
+    if (!text) return;
+    size_t sourceLength;
+    char *source = preprocessWgsl(shader->path, text, length, shader->defines, shader->defineCount, &sourceLength);
+    free(text);
+    if (!source) return;
+    uint64_t hash = hashBytes(source, sourceLength, 0);
+    if (hash == shader->sourceHash) {
+        free(source);
+        return;
+    }
+    shader->sourceHash = hash;
+    pthread_mutex_lock(&watcher->mutex);
+    // Only the newest edit matters
+    free(shader->pendingSource);
+    shader->pendingSource = source;
+    pthread_mutex_unlock(&watcher->mutex);
+}
+
+static bool isShaderFile(const char * name) {
+    size_t length = strlen(name);
+    return length > 4 && strcmp(name + length - 4, ".wsl") == 0;
+}
+
+static void * watcherMain(void * pWatcher) {
+    t_shader_watcher *watcher = pWatcher;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        {.fd = watcher->inotifyFd, .events = POLLIN},
+        {.fd = watcher->stopPipe[0], .events = POLLIN}
+    };
+    for (;;) {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) break;
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+        ssize_t got = read(watcher->inotifyFd, buffer, sizeof(buffer));
+        if (got <= 0) continue;
+
+        // Saving a file often comes as several events: reload each shader once
+        bool changed[SHADER_WATCHER_MAX_SHADERS] = {false};
+        pthread_mutex_lock(&watcher->mutex);
+        size_t count = watcher->count;
+        pthread_mutex_unlock(&watcher->mutex);
+        for (char *p = buffer; p < buffer + got;) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->len > 0 && isShaderFile(event->name)) {
+                for (size_t i = 0; i < count; i++) {
+                    if (watcher->shaders[i].watch == event->wd) changed[i] = true;
+                }
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (changed[i]) reloadShader(watcher, &watcher->shaders[i]);
+        }
+    }
+    return NULL;
+}
+
+t_shader_watcher * createShaderWatcher(WGPUDevice device) {
+    t_shader_watcher *watcher = calloc(1, sizeof(t_shader_watcher));
+    if (!watcher) {
+        printf("Memory Allocation failed.\n");
+        return NULL;
+    }
+    watcher->device = device;
+    // Edits are on disk, the embedded copies are from the last build
+    useEmbeddedShaders(false);
+    watcher->inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (watcher->inotifyFd < 0) {
+        printf("can't watch shaders: inotify unavailable\n");
+        free(watcher);
+        return NULL;
+    }
+    if (pipe(watcher->stopPipe) < 0) {
+        printf("can't watch shaders: no pipe\n");
+        close(watcher->inotifyFd);
+        free(watcher);
+        return NULL;
+    }
+    pthread_mutex_init(&watcher->mutex, NULL);
+    if (pthread_create(&watcher->thread, NULL, watcherMain, watcher) != 0) {
+        printf("can't watch shaders: no thread\n");
+        pthread_mutex_destroy(&watcher->mutex);
+        close(watcher->stopPipe[0]);
+        close(watcher->stopPipe[1]);
+        close(watcher->inotifyFd);
+        free(watcher);
+        return NULL;
+    }
+    return watcher;
+}
+
+static char * copyOptional(const char * string) {
+    return string ? strdup(string) : NULL;
+}
+
+bool watchShader(t_shader_watcher * watcher, const char * path, const t_wgsl_define * defines, size_t defineCount,
+    t_shader_reload onReload, void * userData) {
+    if (watcher->count == SHADER_WATCHER_MAX_SHADERS) {
+        printf("Too many shaders, the watcher holds %d.\n", SHADER_WATCHER_MAX_SHADERS);
+        return false;
+    }
+    // inotify reports a file by its name in the watched directory
+    const char *slash = strrchr(path, '/');
+    char *directory = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    if (!directory) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    // Adding a directory twice gives back the same descriptor
+    int watch = inotify_add_watch(watcher->inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    free(directory);
+    if (watch < 0) {
+        printf("can't watch file:\n %s\n", path);
+        return false;
+    }
+
+    t_watched_shader shader = {
+        .path = strdup(path),
+        .watch = watch,
+        .defines = defineCount ? calloc(defineCount, sizeof(t_wgsl_define)) : NULL,
+        .defineCount = defineCount,
+        .onReload = onReload,
+        .userData = userData
+    };
+    bool allocated = shader.path && (shader.defines || !defineCount);
+    for (size_t i = 0; allocated && i < defineCount; i++) {
+        shader.defines[i].name = strdup(defines[i].name);
+        shader.defines[i].value = copyOptional(defines[i].value);
+        allocated = shader.defines[i].name && (shader.defines[i].value || !defines[i].value);
+    }
+    if (!allocated) {
+        printf("Memory Allocation failed.\n");
+        for (size_t i = 0; shader.defines && i < defineCount; i++) {
+            free((char *)shader.defines[i].name);
+            free((char *)shader.defines[i].value);
+        }
+        free(shader.defines);
+        free(shader.path);
+        return false;
+    }
+    pthread_mutex_lock(&watcher->mutex);
+    watcher->shaders[watcher->count++] = shader;
+    pthread_mutex_unlock(&watcher->mutex);
+    return true;
+}
+
+static void onShaderCompiled(WGPUErrorType type, char const * message, void * userData) {
+    t_shader_compilation *compilation = (t_shader_compilation *)userData;
+    t_watched_shader *shader = compilation->shader;
+    if (type == WGPUErrorType_NoError) {
+        printf("Reloaded shader %s\n", shader->path);
+        shader->onReload(compilation->module, shader->path, shader->userData);
+    } else {
+        printf("Could not reload shader %s, keeping the previous one:\n%s\n", shader->path, message ? message : "");
+    }
+    wgpuShaderModuleRelease(compilation->module);
+    compilation->watcher->pendingScopes--;
+    free(compilation);
+}
+
+size_t pollShaderWatcher(t_shader_watcher * watcher) {
+    // Dawn may hold back error scope callbacks until the device ticks
+    if (watcher->pendingScopes > 0) wgpuDeviceTick(watcher->device);
+
+    // The watcher thread only holds the lock to swap a pointer, but a frame
+    // shouldn't wait even for that: try again next frame
+    if (pthread_mutex_trylock(&watcher->mutex) != 0) return 0;
+    size_t count = watcher->count;
+    char *sources[SHADER_WATCHER_MAX_SHADERS];
+    for (size_t i = 0; i < count; i++) {
+        sources[i] = watcher->shaders[i].pendingSource;
+        watcher->shaders[i].pendingSource = NULL;
+    }
+    pthread_mutex_unlock(&watcher->mutex);
+
+    size_t reloaded = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!sources[i]) continue;
+        t_shader_compilation *compilation = malloc(sizeof(t_shader_compilation));
+        if (!compilation) {
+            printf("Memory Allocation failed.\n");
+            free(sources[i]);
+            continue;
+        }
+        WGPUShaderModuleWGSLDescriptor shaderCodeDesc = {
+            .chain = (WGPUChainedStruct){
+                .next = NULL,
+                .sType = WGPUSType_ShaderModuleWGSLDescriptor
+            },
+            .source = sources[i]
+        };
+        WGPUShaderModuleDescriptor shaderDesc = {
+            .nextInChain = &shaderCodeDesc.chain,
+            .label = watcher->shaders[i].path
+        };
+        // Invalid WGSL still gives a module, the scope tells whether it is usable
+        wgpuDevicePushErrorScope(watcher->device, WGPUErrorFilter_Validation);
+        WGPUShaderModule module = wgpuDeviceCreateShaderModule(watcher->device, &shaderDesc);
+        free(sources[i]);
+        *compilation = (t_shader_compilation){watcher, &watcher->shaders[i], module};
+        watcher->pendingScopes++;
+        wgpuDevicePopErrorScope(watcher->device, onShaderCompiled, compilation);
+        reloaded++;
+    }
+    return reloaded;
+}
+
+void destroyShaderWatcher(t_shader_watcher * watcher) {
+    if (!watcher) return;
+    if (write(watcher->stopPipe[1], "", 1) < 0) printf("can't stop the shader watcher\n");
+    pthread_join(watcher->thread, NULL);
+    while (watcher->pendingScopes > 0) {
+        wgpuDeviceTick(watcher->device);
+        usleep(1000);
+    }
+    for (size_t i = 0; i < watcher->count; i++) {
+        t_watched_shader *shader = &watcher->shaders[i];
+        for (size_t j = 0; j < shader->defineCount; j++) {
+            free((char *)shader->defines[j].name);
+            free((char *)shader->defines[j].value);
+        }
+        free(shader->defines);
+        free(shader->pendingSource);
+        free(shader->path);
+    }
+    pthread_mutex_destroy(&watcher->mutex);
+    close(watcher->stopPipe[0]);
+    close(watcher->stopPipe[1]);
+    close(watcher->inotifyFd);
+    free(watcher);
+}
@@ -0,0 +1,50 @@
+#ifndef SHADER_WATCHER_HEADER_FILE
+#define SHADER_WATCHER_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "wgsl_preprocessor.h"
+
+//  ------------------------------- Shader watcher------------------------------------------------------------------
+// Hot reload for shaders under development. A thread waits on inotify for
+// .wsl files to be written in the directories of the watched shaders, then
+// reads and preprocesses them (includes from the same directory count too).
+// Sources that come out the same as before are ignored, e.g. when an editor
+// writes twice.
+//
+// pollShaderWatcher(), called between frames, creates the modules inside a
+// validation error scope. A module that compiles is handed to the reload
+// callback, which typically rebuilds its pipeline with
+// replaceRenderPipeline(): Dawn compiles it on its own threads and the old
+// pipeline draws until the new one is in place. A module that doesn't compile
+// is dropped with its error message, and the old pipeline stays.
+//
+// Creating a watcher turns embedded shaders off (see embedded_shaders.h): from
+// then on shaders and their includes come from disk.
+//
+// Dawn devices aren't thread safe, so WebGPU is only called from the thread
+// that polls; the watcher thread never touches the device.
+
+#define SHADER_WATCHER_MAX_SHADERS 16
+
+typedef struct ShaderWatcher t_shader_watcher;
+
+// Runs on the polling thread. The module is released after the call: keep a
+// reference (wgpuShaderModuleReference) to use it later; pipelines hold their own.
+typedef void (*t_shader_reload)(WGPUShaderModule module, const char * path, void * userData);
+
+// Starts the watcher thread. Returns NULL when inotify can't be used.
+t_shader_watcher * createShaderWatcher(WGPUDevice device);
+void destroyShaderWatcher(t_shader_watcher * watcher);
+
+// Reloads path with the given defines (copied) each time it or a .wsl file
+// next to it changes.
+bool watchShader(t_shader_watcher * watcher, const char * path, const t_wgsl_define * defines, size_t defineCount,
+    t_shader_reload onReload, void * userData);
+
+// Creates modules for the shaders that changed and calls their callbacks.
+// Returns how many modules it created. Never waits on the watcher thread or disk.
+size_t pollShaderWatcher(t_shader_watcher * watcher);
+
+#endif
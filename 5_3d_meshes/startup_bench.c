@@ -0,0 +1,137 @@
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "helper_v3.h"
+#include "blob_cache.h"
+#include "shader_registry.h"
+
+// Times a headless startup (instance, adapter, device, shader module and render
+// pipeline) once with an empty blob cache and then with the cache it left
+// behind. Each startup runs in its own process so nothing carries over in
+// memory. Runs without a GPU on the Null backend or on SwiftShader.
+// Usage: startup_bench [swiftshader|null] [cache directory] [warm runs]
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static WGPURenderPipeline createPipeline(WGPUDevice device, WGPUShaderModule shaderModule) {
+    WGPUVertexAttribute vertexAttribs[2] = {
+        {.shaderLocation = 0, .format = WGPUVertexFormat_Float32x3, .offset = 0},
+        {.shaderLocation = 1, .format = WGPUVertexFormat_Float32x3, .offset = 3 * sizeof(float)}
+    };
+    WGPUVertexBufferLayout vertexBufferLayout = {
+        .attributeCount = 2,
+        .attributes = vertexAttribs,
+        .arrayStride = 6 * sizeof(float),
+        .stepMode = WGPUVertexStepMode_Vertex
+    };
+    WGPUColorTargetState colorTarget = {
+        .format = WGPUTextureFormat_BGRA8Unorm,
+        .writeMask = WGPUColorWriteMask_All
+    };
+    WGPUFragmentState fragmentState = {
+        .module = shaderModule,
+        .entryPoint = "fs_main",
+        .targetCount = 1,
+        .targets = &colorTarget
+    };
+    WGPURenderPipelineDescriptor pipelineDesc = {
+        .vertex = (WGPUVertexState){
+            .bufferCount = 1,
+            .buffers = &vertexBufferLayout,
+            .module = shaderModule,
+            .entryPoint = "vs_main"
+        },
+        .primitive = (WGPUPrimitiveState){
+            .topology = WGPUPrimitiveTopology_TriangleList,
+            .stripIndexFormat = WGPUIndexFormat_Undefined,
+            .frontFace = WGPUFrontFace_CCW,
+            .cullMode = WGPUCullMode_None
+        },
+        .fragment = &fragmentState,
+        .multisample = (WGPUMultisampleState){
+            .count = 1,
+            .mask = ~0u,
+            .alphaToCoverageEnabled = false
+        },
+        // Layout derived from the shader
+        .layout = NULL
+    };
+    return wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+}
+
+static int startup(const char * label, bool swiftShader, const char * directory, bool cold) {
+    double start = now();
+    t_blob_cache *cache = openBlobCache(directory, BLOB_CACHE_DEFAULT_SIZE);
+    if (!cache) return 1;
+    if (cold) clearBlobCache(cache);
+    WGPUInstance instance = createCachedInstance(cache);
+
+    // SwiftShader is Dawn's fallback Vulkan adapter
+    WGPURequestAdapterOptions adapterOpts = {
+        .backendType = swiftShader ? WGPUBackendType_Vulkan : WGPUBackendType_Null,
+        .forceFallbackAdapter = swiftShader
+    };
+    WGPUAdapter adapter = instance ? requestAdapter(instance, &adapterOpts) : NULL;
+    if (!adapter) {
+        printf("No %s adapter.\n", swiftShader ? "SwiftShader" : "Null");
+        closeBlobCache(cache);
+        return 1;
+    }
+    WGPUDeviceDescriptor deviceDesc = {.label = "Startup bench device"};
+    WGPUDevice device = requestDevice(adapter, &deviceDesc);
+    wgpuDeviceSetUncapturedErrorCallback(device, cCallback, NULL);
+    double deviceTime = now();
+
+    WGPUShaderModule shaderModule = loadShaderModule(RESOURCE_DIR "/shader.wsl", device);
+    double shaderTime = now();
+    WGPURenderPipeline pipeline = createPipeline(device, shaderModule);
+    double pipelineTime = now();
+
+    t_blob_cache_stats stats = getBlobCacheStats(cache);
+    printf("%-5s device %7.2f ms  shader %7.2f ms  pipeline %7.2f ms  total %7.2f ms   blobs: %zu hits %zu misses %zu stores, %.1f KB\n",
+        label, (deviceTime - start) * 1e3, (shaderTime - deviceTime) * 1e3, (pipelineTime - shaderTime) * 1e3,
+        (pipelineTime - start) * 1e3, stats.hits, stats.misses, stats.stores, stats.size / 1024.0);
+    fflush(stdout);
+
+    wgpuRenderPipelineRelease(pipeline);
+    releaseShaderRegistry();
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(adapter);
+    wgpuInstanceRelease(instance);
+    closeBlobCache(cache);
+    return 0;
+}
+
+static bool runStartup(const char * label, bool swiftShader, const char * directory, bool cold) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        printf("can't fork:\n %s\n", label);
+        return false;
+    }
+    if (pid == 0) exit(startup(label, swiftShader, directory, cold));
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool swiftShader = argc < 2 || strcmp(argv[1], "null") != 0;
+    const char *directory = argc > 2 ? argv[2] : "startup_bench_cache";
+    int warmRuns = argc > 3 ? atoi(argv[3]) : 3;
+    printf("%s backend, blob cache in %s\n", swiftShader ? "SwiftShader" : "Null", directory);
+    if (!runStartup("cold", swiftShader, directory, true)) return 1;
+    for (int i = 0; i < warmRuns; i++) {
+        if (!runStartup("warm", swiftShader, directory, false)) return 1;
+    }
+    return 0;
+}
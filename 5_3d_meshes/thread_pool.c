@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "thread_pool.h"
+
+struct ThreadPool {
+    pthread_t * threads;
+    size_t threadCount;
+    pthread_mutex_t mutex;
+    pthread_cond_t workReady;
+    pthread_cond_t workDone;
+    // Current job, protected by mutex (nextIndex is claimed lock-free)
+    t_thread_task task;
+    void * userData;
+    size_t taskCount;
+    atomic_size_t nextIndex;
+    size_t finished;
+    // Workers inside runTasks; a new job must not start before they leave,
+    // or a late one could claim its indices with the old task
+    size_t activeWorkers;
+    unsigned long generation;
+    bool quit;
+};
+
+// Claims and runs tasks of the current job until none are left.
+// Returns how many it ran.
+static size_t runTasks(t_thread_pool * pool, t_thread_task task, void * userData, size_t taskCount) {
+    size_t done = 0;
+    size_t index;
+    while ((index = atomic_fetch_add(&pool->nextIndex, 1)) < taskCount) {
+        task(index, userData);
+        done++;
+    }
+    return done;
+}
+
+static void * workerMain(void * pPool) {
+    t_thread_pool *pool = pPool;
+    unsigned long seenGeneration = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->quit && pool->generation == seenGeneration) {
+            pthread_cond_wait(&pool->workReady, &pool->mutex);
+        }
+        if (pool->quit) break;
+        seenGeneration = pool->generation;
+        t_thread_task task = pool->task;
+        void *userData = pool->userData;
+        size_t taskCount = pool->taskCount;
+        pool->activeWorkers++;
+        pthread_mutex_unlock(&pool->mutex);
+        size_t done = runTasks(pool, task, userData, taskCount);
+        pthread_mutex_lock(&pool->mutex);
+        pool->finished += done;
+        pool->activeWorkers--;
+        pthread_cond_broadcast(&pool->workDone);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+t_thread_pool * createThreadPool(size_t threadCount) {
+    t_thread_pool *pool = calloc(1, sizeof(t_thread_pool));
+    if (!pool) return NULL;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->workReady, NULL);
+    pthread_cond_init(&pool->workDone, NULL);
+    atomic_init(&pool->nextIndex, 0);
+    pool->threadCount = 1;
+    if (threadCount > 1) {
+        pool->threads = malloc((threadCount - 1) * sizeof(pthread_t));
+        for (size_t i = 0; pool->threads && i < threadCount - 1; i++) {
+            if (pthread_create(&pool->threads[i], NULL, workerMain, pool) != 0) break;
+            pool->threadCount++;
+        }
+    }
+    return pool;
+}
+
+void destroyThreadPool(t_thread_pool * pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 0; i < pool->threadCount - 1; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->workDone);
+    pthread_cond_destroy(&pool->workReady);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool);
+}
+
+size_t threadPoolSize(const t_thread_pool * pool) {
+    return pool ? pool->threadCount : 1;
+}
+
+void threadPoolParallelFor(t_thread_pool * pool, size_t taskCount, t_thread_task task, void * userData) {
+    if (!pool || pool->threadCount == 1 || taskCount <= 1) {
+        for (size_t i = 0; i < taskCount; i++) task(i, userData);
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    // A worker that woke late for the last job may still be in runTasks with
+    // its task: let it leave before nextIndex goes back to 0
+    while (pool->activeWorkers > 0) {
+        pthread_cond_wait(&pool->workDone, &pool->mutex);
+    }
+    pool->task = task;
+    pool->userData = userData;
+    pool->taskCount = taskCount;
+    pool->finished = 0;
+    atomic_store(&pool->nextIndex, 0);
+    pool->generation++;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->mutex);
+
+    size_t done = runTasks(pool, task, userData, taskCount);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->finished += done;
+    while (pool->finished < taskCount || pool->activeWorkers > 0) {
+        pthread_cond_wait(&pool->workDone, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
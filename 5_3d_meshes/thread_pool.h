@@ -0,0 +1,23 @@
+#ifndef THREAD_POOL_HEADER_FILE
+#define THREAD_POOL_HEADER_FILE
+
+#include <stddef.h>
+
+//  ------------------------------- Thread pool------------------------------------------------------------------
+// A fixed set of worker threads running parallel-for style jobs.
+
+typedef struct ThreadPool t_thread_pool;
+
+typedef void (*t_thread_task)(size_t index, void * userData);
+
+// threadCount includes the calling thread, so 1 means no extra threads
+t_thread_pool * createThreadPool(size_t threadCount);
+void destroyThreadPool(t_thread_pool * pool);
+size_t threadPoolSize(const t_thread_pool * pool);
+
+// Runs task(i, userData) for every i in [0, taskCount) on the workers and the
+// calling thread, and returns once all of them are done. A NULL pool runs
+// everything on the calling thread.
+void threadPoolParallelFor(t_thread_pool * pool, size_t taskCount, t_thread_task task, void * userData);
+
+#endif
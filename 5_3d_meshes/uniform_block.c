@@ -0,0 +1,139 @@
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uniform_block.h"
+
+bool initUniformBlock(t_uniform_block * block, WGPUQueue queue, WGPUBuffer buffer, uint64_t offset, const void * data, size_t size) {
+    if (size % 4 != 0) {
+        printf("Uniform block of %zu bytes, not a multiple of 4\n", size);
+        return false;
+    }
+    *block = (t_uniform_block){
+        .queue = queue,
+        .buffer = buffer,
+        .offset = offset,
+        .size = (uint32_t)size,
+        .shadow = malloc(size)
+    };
+    if (!block->shadow) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    memcpy(block->shadow, data, size);
+    wgpuQueueWriteBuffer(queue, buffer, offset, data, size);
+    return true;
+}
+
+void releaseUniformBlock(t_uniform_block * block) {
+    free(block->shadow);
+    block->shadow = NULL;
+}
+
+// Adds [begin, end) to the sorted dirty ranges, merging what is close enough
+static void markDirty(t_uniform_block * block, uint32_t begin, uint32_t end) {
+    // wgpuQueueWriteBuffer offsets and sizes are multiples of 4
+    begin &= ~3u;
+    end = (end + 3) & ~3u;
+    if (end > block->size) end = block->size;
+
+    size_t i = 0;
+    while (i < block->dirtyCount && block->dirty[i].end + UNIFORM_BLOCK_MERGE_GAP < begin) i++;
+    // Ranges from i on that reach [begin, end) are absorbed into it
+    size_t last = i;
+    while (last < block->dirtyCount && block->dirty[last].begin <= end + UNIFORM_BLOCK_MERGE_GAP) {
+        if (block->dirty[last].begin < begin) begin = block->dirty[last].begin;
+        if (block->dirty[last].end > end) end = block->dirty[last].end;
+        last++;
+    }
+    size_t removed = last - i;
+    if (removed == 0 && block->dirtyCount == UNIFORM_BLOCK_MAX_RANGES) {
+        // No room: grow the neighbour it is closest to
+        size_t nearest = i == 0 ? 0 : i == block->dirtyCount ? i - 1 :
+            begin - block->dirty[i - 1].end < block->dirty[i].begin - end ? i - 1 : i;
+        if (block->dirty[nearest].begin > begin) block->dirty[nearest].begin = begin;
+        if (block->dirty[nearest].end < end) block->dirty[nearest].end = end;
+        // It may now reach the other neighbour
+        if (nearest + 1 < block->dirtyCount && block->dirty[nearest + 1].begin <= block->dirty[nearest].end) {
+            block->dirty[nearest].end = block->dirty[nearest + 1].end;
+            memmove(&block->dirty[nearest + 1], &block->dirty[nearest + 2], (block->dirtyCount - nearest - 2) * sizeof(t_uniform_range));
+            block->dirtyCount--;
+        }
+        if (nearest > 0 && block->dirty[nearest - 1].end >= block->dirty[nearest].begin) {
+            block->dirty[nearest - 1].end = block->dirty[nearest].end;
+            memmove(&block->dirty[nearest], &block->dirty[nearest + 1], (block->dirtyCount - nearest - 1) * sizeof(t_uniform_range));
+            block->dirtyCount--;
+        }
+        return;
+    }
+    if (removed == 0) {
+        memmove(&block->dirty[i + 1], &block->dirty[i], (block->dirtyCount - i) * sizeof(t_uniform_range));
+        block->dirtyCount++;
+    } else if (removed > 1) {
+        memmove(&block->dirty[i + 1], &block->dirty[last], (block->dirtyCount - last) * sizeof(t_uniform_range));
+        block->dirtyCount -= removed - 1;
+    }
+    block->dirty[i] = (t_uniform_range){begin, end};
+}
+
+void setUniforms(t_uniform_block * block, size_t offset, const void * data, size_t size) {
+    if (offset + size > block->size) {
+        printf("Uniforms at %zu..%zu are past the end of the block (%u bytes)\n", offset, offset + size, block->size);
+        return;
+    }
+    // Only the part between the first and the last changed byte
+    const uint8_t *bytes = data;
+    uint8_t *shadow = block->shadow + offset;
+    size_t begin = 0;
+    size_t end = size;
+    while (begin < end && bytes[begin] == shadow[begin]) begin++;
+    while (end > begin && bytes[end - 1] == shadow[end - 1]) end--;
+    block->current.unchangedBytes += size - (end - begin);
+    if (begin == end) return;
+    memcpy(shadow + begin, bytes + begin, end - begin);
+    markDirty(block, (uint32_t)(offset + begin), (uint32_t)(offset + end));
+}
+
+void updateUniformBlock(t_uniform_block * block, const void * data) {
+    // Runs of changed 4 byte words, the unit uniforms are made of
+    const uint8_t *bytes = data;
+    uint32_t word = 0;
+    while (word < block->size) {
+        while (word < block->size && memcmp(bytes + word, block->shadow + word, 4) == 0) {
+            block->current.unchangedBytes += 4;
+            word += 4;
+        }
+        uint32_t begin = word;
+        while (word < block->size && memcmp(bytes + word, block->shadow + word, 4) != 0) word += 4;
+        if (word > begin) {
+            memcpy(block->shadow + begin, bytes + begin, word - begin);
+            markDirty(block, begin, word);
+        }
+    }
+}
+
+void flushUniformBlock(t_uniform_block * block) {
+    t_uniform_block_stats *frame = &block->current;
+    for (size_t i = 0; i < block->dirtyCount; i++) {
+        t_uniform_range range = block->dirty[i];
+        wgpuQueueWriteBuffer(block->queue, block->buffer, block->offset + range.begin, block->shadow + range.begin, range.end - range.begin);
+        frame->writes++;
+        frame->bytes += range.end - range.begin;
+    }
+    frame->flushes = 1;
+    block->dirtyCount = 0;
+    block->lastFrame = *frame;
+    block->total.flushes++;
+    block->total.writes += frame->writes;
+    block->total.bytes += frame->bytes;
+    block->total.unchangedBytes += frame->unchangedBytes;
+    *frame = (t_uniform_block_stats){0};
+}
+
+void printUniformBlockStats(const t_uniform_block * block) {
+    const t_uniform_block_stats *stats = &block->total;
+    if (stats->flushes == 0) return;
+    printf("Uniform uploads: %.2f writes, %.1f bytes per frame (%.1f bytes unchanged)\n",
+        (double)stats->writes / stats->flushes, (double)stats->bytes / stats->flushes,
+        (double)stats->unchangedBytes / stats->flushes);
+}
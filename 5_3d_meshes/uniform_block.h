@@ -0,0 +1,61 @@
+#ifndef UNIFORM_BLOCK_HEADER_FILE
+#define UNIFORM_BLOCK_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//  ------------------------------- Uniform block------------------------------------------------------------------
+// A shadow copy of a uniform struct living in a GPU buffer. Changes are
+// compared with the copy, so values set again unchanged cost nothing; the
+// bytes that did change are kept as dirty ranges, merged when they overlap,
+// touch, or are fewer than UNIFORM_BLOCK_MERGE_GAP bytes apart (one more
+// write call costs more than uploading a few bytes twice). flushUniformBlock(),
+// right before the submit, writes each range once.
+
+#define UNIFORM_BLOCK_MAX_RANGES 8
+#define UNIFORM_BLOCK_MERGE_GAP 64
+
+typedef struct UniformRange {
+    uint32_t begin;
+    uint32_t end;
+} t_uniform_range;
+
+typedef struct UniformBlockStats {
+    size_t flushes;
+    size_t writes;              // wgpuQueueWriteBuffer calls
+    size_t bytes;               // bytes they uploaded
+    size_t unchangedBytes;      // bytes set to what they already were
+} t_uniform_block_stats;
+
+typedef struct UniformBlock {
+    WGPUQueue queue;
+    WGPUBuffer buffer;
+    uint64_t offset;            // of the struct in buffer
+    uint32_t size;
+    uint8_t * shadow;           // what the buffer holds once flushed
+    t_uniform_range dirty[UNIFORM_BLOCK_MAX_RANGES];   // sorted, disjoint
+    size_t dirtyCount;
+    t_uniform_block_stats current;      // since the last flush
+    t_uniform_block_stats lastFrame;    // of the last flush
+    t_uniform_block_stats total;
+} t_uniform_block;
+
+// Uploads data (size bytes, a multiple of 4) to buffer at offset, all of it
+bool initUniformBlock(t_uniform_block * block, WGPUQueue queue, WGPUBuffer buffer, uint64_t offset, const void * data, size_t size);
+void releaseUniformBlock(t_uniform_block * block);
+
+// Sets size bytes at offset into the struct, e.g. offsetof(MyUniforms, time)
+void setUniforms(t_uniform_block * block, size_t offset, const void * data, size_t size);
+
+// Sets the whole struct: only the fields that changed become dirty
+void updateUniformBlock(t_uniform_block * block, const void * data);
+
+void flushUniformBlock(t_uniform_block * block);
+
+// Prints the average writes and bytes per frame so far, nothing before the
+// first flush
+void printUniformBlockStats(const t_uniform_block * block);
+
+#endif
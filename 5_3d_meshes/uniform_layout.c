@@ -0,0 +1,140 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uniform_layout.h"
+#include "embedded_shaders.h"
+
+//  ------------------------------- WGSL scanning------------------------------------------------------------------
+
+static const char * skipSpace(const char * p) {
+    for (;;) {
+        while (isspace((unsigned char)*p)) p++;
+        if (p[0] == '/' && p[1] == '/') {
+            while (*p && *p != '\n') p++;
+        } else if (p[0] == '/' && p[1] == '*') {
+            // WGSL block comments nest
+            int depth = 0;
+            do {
+                if (p[0] == '/' && p[1] == '*') depth++, p += 2;
+                else if (p[0] == '*' && p[1] == '/') depth--, p += 2;
+                else if (*p) p++;
+                else return p;
+            } while (depth > 0);
+        } else {
+            return p;
+        }
+    }
+}
+
+static bool isIdentifierChar(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// Length of the identifier at p, 0 if there is none
+static size_t identifierLength(const char * p) {
+    if (isdigit((unsigned char)*p)) return 0;
+    size_t length = 0;
+    while (isIdentifierChar(p[length])) length++;
+    return length;
+}
+
+// The body of "struct name {", just after the brace, or NULL
+static const char * findStruct(const char * source, const char * name) {
+    size_t nameLength = strlen(name);
+    for (const char *p = skipSpace(source); *p; p = skipSpace(p)) {
+        size_t length = identifierLength(p);
+        if (length == 0) {
+            p++;
+            continue;
+        }
+        if (length == 6 && strncmp(p, "struct", 6) == 0) {
+            const char *q = skipSpace(p + length);
+            if (identifierLength(q) == nameLength && strncmp(q, name, nameLength) == 0) {
+                q = skipSpace(q + nameLength);
+                if (*q == '{') return q + 1;
+            }
+        }
+        p += length;
+    }
+    return NULL;
+}
+
+// Copies the type at p to type without spaces, with vec4f style aliases
+// spelled out (vec4<f32>), and returns the end of the type
+static const char * readType(const char * p, char * type, size_t capacity) {
+    size_t used = 0;
+    int depth = 0;
+    while (*p && used + 1 < capacity) {
+        p = skipSpace(p);
+        if (*p == '<') depth++;
+        else if (*p == '>') depth--;
+        else if (depth == 0 && !isIdentifierChar(*p)) break;
+        type[used++] = *p++;
+    }
+    type[used] = '\0';
+    size_t length = strlen(type);
+    char last = length ? type[length - 1] : 0;
+    bool alias = (strncmp(type, "vec", 3) == 0 && length == 5) || (strncmp(type, "mat", 3) == 0 && length == 7);
+    if (alias && (last == 'f' || last == 'i' || last == 'u' || last == 'h') && length + 5 < capacity) {
+        const char *scalar = last == 'f' ? "f32" : last == 'i' ? "i32" : last == 'u' ? "u32" : "f16";
+        snprintf(type + length - 1, capacity - length + 1, "<%s>", scalar);
+    }
+    return p;
+}
+
+//  ------------------------------- Checks------------------------------------------------------------------
+
+bool checkWgslUniformLayout(const char * source, const char * path, const t_uniform_layout * layout) {
+    const char *p = findStruct(source, layout->name);
+    if (!p) {
+        printf("%s declares no struct %s\n", path, layout->name);
+        return false;
+    }
+    for (size_t i = 0;; i++) {
+        p = skipSpace(p);
+        if (*p == '}') {
+            if (i == layout->fieldCount) return true;
+            printf("struct %s of %s has %zu fields, the host's has %zu:\n%s", layout->name, path, i, layout->fieldCount, layout->wgsl);
+            return false;
+        }
+        if (*p == '@') {
+            printf("struct %s of %s sets a layout attribute, the host's can't follow:\n%s", layout->name, path, layout->wgsl);
+            return false;
+        }
+        size_t nameLength = identifierLength(p);
+        const char *name = p;
+        p = skipSpace(p + nameLength);
+        if (nameLength == 0 || *p != ':') {
+            printf("can't read struct %s of %s\n", layout->name, path);
+            return false;
+        }
+        char type[64];
+        p = readType(p + 1, type, sizeof(type));
+        if (i >= layout->fieldCount) {
+            printf("struct %s of %s has more fields than the host's:\n%s", layout->name, path, layout->wgsl);
+            return false;
+        }
+        const t_uniform_field *field = &layout->fields[i];
+        if (strlen(field->name) != nameLength || strncmp(field->name, name, nameLength) != 0 || strcmp(field->type, type) != 0) {
+            printf("struct %s of %s has %.*s: %s where the host has %s: %s:\n%s", layout->name, path,
+                (int)nameLength, name, type, field->name, field->type, layout->wgsl);
+            return false;
+        }
+        p = skipSpace(p);
+        if (*p == ',') p++;
+    }
+}
+
+bool checkShaderUniforms(const char * path, const t_wgsl_define * defines, size_t defineCount, const t_uniform_layout * layout) {
+    size_t length;
+    char *text = readShaderSource(path, &length);
+    if (!text) return false;
+    size_t sourceLength;
+    char *source = preprocessWgsl(path, text, length, defines, defineCount, &sourceLength);
+    free(text);
+    if (!source) return false;
+    bool matches = checkWgslUniformLayout(source, path, layout);
+    free(source);
+    return matches;
+}
@@ -0,0 +1,103 @@
+#ifndef UNIFORM_LAYOUT_HEADER_FILE
+#define UNIFORM_LAYOUT_HEADER_FILE
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wgsl_preprocessor.h"
+
+//  ------------------------------- Uniform layout------------------------------------------------------------------
+// Uniform structs declared once, as a list of WGSL typed fields:
+//   #define MY_UNIFORMS(FIELD) FIELD(vec4f, color) FIELD(f32, time)
+//   UNIFORM_STRUCT(MyUniforms, MY_UNIFORMS)
+// declares the host struct MyUniforms, each field aligned as WGSL aligns it.
+// C then lays it out by the same rules WGSL does: the padding, including the
+// bytes after a vec3 and the end rounded to the largest alignment, is exactly
+// WGSL's, with no _pad fields to keep in step when fields move.
+// UNIFORM_LAYOUT(MyUniforms) describes it: its size, each field's name, WGSL
+// type, offset and size (for partial writes, e.g. setUniforms()), and the WGSL
+// text of the struct. checkShaderUniforms() makes sure a shader declares the
+// same struct.
+//
+// The types below have the same layout in the uniform and storage address
+// spaces. Arrays and nested structs, where the two differ, aren't supported.
+
+typedef struct UniformField {
+    const char * name;
+    const char * type;          // WGSL, e.g. "vec4<f32>"
+    uint32_t offset;
+    uint32_t size;
+} t_uniform_field;
+
+typedef struct UniformLayout {
+    const char * name;
+    uint32_t size;              // minBindingSize
+    const t_uniform_field * fields;
+    size_t fieldCount;
+    const char * wgsl;          // "struct Name {\n\tfield: type,\n...};\n"
+} t_uniform_layout;
+
+// Host declaration and WGSL type of each supported field type
+#define UNIFORM_C_f32(name) float name
+#define UNIFORM_C_i32(name) int32_t name
+#define UNIFORM_C_u32(name) uint32_t name
+#define UNIFORM_C_vec2f(name) alignas(8) float name[2]
+#define UNIFORM_C_vec3f(name) alignas(16) float name[3]
+#define UNIFORM_C_vec4f(name) alignas(16) float name[4]
+#define UNIFORM_C_vec2i(name) alignas(8) int32_t name[2]
+#define UNIFORM_C_vec3i(name) alignas(16) int32_t name[3]
+#define UNIFORM_C_vec4i(name) alignas(16) int32_t name[4]
+#define UNIFORM_C_vec2u(name) alignas(8) uint32_t name[2]
+#define UNIFORM_C_vec3u(name) alignas(16) uint32_t name[3]
+#define UNIFORM_C_vec4u(name) alignas(16) uint32_t name[4]
+// Matrices are arrays of column vectors: a mat3x3 column takes a vec4's room
+#define UNIFORM_C_mat2x2f(name) alignas(8) float name[2][2]
+#define UNIFORM_C_mat3x3f(name) alignas(16) float name[3][4]
+#define UNIFORM_C_mat4x4f(name) alignas(16) float name[4][4]
+
+#define UNIFORM_WGSL_f32 "f32"
+#define UNIFORM_WGSL_i32 "i32"
+#define UNIFORM_WGSL_u32 "u32"
+#define UNIFORM_WGSL_vec2f "vec2<f32>"
+#define UNIFORM_WGSL_vec3f "vec3<f32>"
+#define UNIFORM_WGSL_vec4f "vec4<f32>"
+#define UNIFORM_WGSL_vec2i "vec2<i32>"
+#define UNIFORM_WGSL_vec3i "vec3<i32>"
+#define UNIFORM_WGSL_vec4i "vec4<i32>"
+#define UNIFORM_WGSL_vec2u "vec2<u32>"
+#define UNIFORM_WGSL_vec3u "vec3<u32>"
+#define UNIFORM_WGSL_vec4u "vec4<u32>"
+#define UNIFORM_WGSL_mat2x2f "mat2x2<f32>"
+#define UNIFORM_WGSL_mat3x3f "mat3x3<f32>"
+#define UNIFORM_WGSL_mat4x4f "mat4x4<f32>"
+
+#define UNIFORM_MEMBER(type, name) UNIFORM_C_##type(name);
+#define UNIFORM_FIELD_INFO(type, name) \
+    {#name, UNIFORM_WGSL_##type, offsetof(t_uniform_struct, name), sizeof(((t_uniform_struct *)0)->name)},
+#define UNIFORM_FIELD_COUNT(type, name) + 1
+#define UNIFORM_WGSL_FIELD(type, name) "\t" #name ": " UNIFORM_WGSL_##type ",\n"
+
+#define UNIFORM_STRUCT(Name, FIELDS) \
+    typedef struct Name { FIELDS(UNIFORM_MEMBER) } Name; \
+    static inline const t_uniform_layout * getUniformLayout_##Name(void) { \
+        typedef Name t_uniform_struct; \
+        static const t_uniform_field fields[] = { FIELDS(UNIFORM_FIELD_INFO) }; \
+        static const t_uniform_layout layout = { \
+            #Name, sizeof(Name), fields, 0 FIELDS(UNIFORM_FIELD_COUNT), \
+            "struct " #Name " {\n" FIELDS(UNIFORM_WGSL_FIELD) "};\n" \
+        }; \
+        return &layout; \
+    }
+
+#define UNIFORM_LAYOUT(Name) getUniformLayout_##Name()
+
+// Whether the WGSL source declares struct layout->name with the same fields,
+// in the same order and of the same types (f32 and vec4f style aliases are
+// fine, @align and @size attributes aren't). Prints the first difference.
+bool checkWgslUniformLayout(const char * source, const char * path, const t_uniform_layout * layout);
+
+// The same for a shader file, preprocessed with the given defines
+bool checkShaderUniforms(const char * path, const t_wgsl_define * defines, size_t defineCount, const t_uniform_layout * layout);
+
+#endif
@@ -0,0 +1,105 @@
+#include <webgpu/webgpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uniform_ring.h"
+
+bool initUniformRing(t_uniform_ring * ring, t_frames_in_flight * frames, uint64_t size) {
+    WGPUDevice device = frames->device;
+    // The required limits may be looser than what the device has
+    WGPUSupportedLimits supportedLimits = {0};
+    wgpuDeviceGetLimits(device, &supportedLimits);
+    uint32_t alignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+    if (!alignment) alignment = 256;
+    // Offsets are aligned in the ring, and must stay so after wrapping
+    size = (size + alignment - 1) / alignment * alignment;
+    *ring = (t_uniform_ring){
+        .frames = frames,
+        .queue = wgpuDeviceGetQueue(device),
+        .size = size,
+        .alignment = alignment,
+        .data = malloc(size)
+    };
+    if (!ring->data) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    WGPUBufferDescriptor bufferDesc = {
+        .label = "Uniform ring",
+        .size = size,
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .mappedAtCreation = false
+    };
+    ring->buffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+    return ring->buffer != NULL;
+}
+
+// Run when the oldest frame with slices retires, frames retire in order
+static void retireSlices(void * object) {
+    t_uniform_ring *ring = (t_uniform_ring *)object;
+    ring->tail = ring->frameEnds[ring->firstFrame];
+    ring->firstFrame = (ring->firstFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    ring->frameCount--;
+}
+
+void * allocUniforms(t_uniform_ring * ring, size_t size, uint32_t * dynamicOffset) {
+    // wgpuQueueWriteBuffer sizes are multiples of 4
+    size = (size + 3) & ~(size_t)3;
+    for (;;) {
+        uint64_t start = (ring->head + ring->alignment - 1) / ring->alignment * ring->alignment;
+        // A slice can't straddle the end of the buffer: skip to the start
+        bool wraps = start % ring->size + size > ring->size;
+        if (wraps) start = (start / ring->size + 1) * ring->size;
+        uint64_t end = start + size;
+        if (end - ring->tail <= ring->size) {
+            ring->head = end;
+            *dynamicOffset = (uint32_t)(start % ring->size);
+            return ring->data + start % ring->size;
+        }
+        // Full: the oldest frame in flight has to give its slices back first
+        if (ring->frameCount == 0 || !waitOldestFrame(ring->frames)) {
+            printf("Uniform ring of %llu bytes is too small for one frame\n", (unsigned long long)ring->size);
+            return NULL;
+        }
+    }
+}
+
+uint32_t pushUniforms(t_uniform_ring * ring, const void * data, size_t size) {
+    uint32_t dynamicOffset;
+    void *slice = allocUniforms(ring, size, &dynamicOffset);
+    if (!slice) return UNIFORM_RING_FULL;
+    memcpy(slice, data, size);
+    return dynamicOffset;
+}
+
+void flushUniformRing(t_uniform_ring * ring) {
+    // One write per lap of the ring the frame's slices are in: two at most.
+    // Padding and the end skipped when wrapping go along, nothing reads them.
+    uint64_t start = ring->frameStart;
+    while (start < ring->head) {
+        uint64_t lapEnd = (start / ring->size + 1) * ring->size;
+        uint64_t end = ring->head < lapEnd ? ring->head : lapEnd;
+        wgpuQueueWriteBuffer(ring->queue, ring->buffer, start % ring->size, ring->data + start % ring->size, end - start);
+        start = end;
+    }
+    ring->frameStart = ring->head;
+
+    // Between frames this is the last one submitted, as for deferFrameRelease()
+    uint64_t frame = ring->frames->nextFrame - 1;
+    if (ring->frameCount > 0 && ring->lastFrame == frame) {
+        ring->frameEnds[(ring->firstFrame + ring->frameCount - 1) % MAX_FRAMES_IN_FLIGHT] = ring->head;
+        return;
+    }
+    // Frames not retired are maxFrames at most, the one being recorded included
+    ring->frameEnds[(ring->firstFrame + ring->frameCount) % MAX_FRAMES_IN_FLIGHT] = ring->head;
+    ring->frameCount++;
+    ring->lastFrame = frame;
+    deferFrameRelease(ring->frames, retireSlices, ring);
+}
+
+void releaseUniformRing(t_uniform_ring * ring) {
+    wgpuBufferRelease(ring->buffer);
+    free(ring->data);
+    ring->buffer = NULL;
+    ring->data = NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef UNIFORM_RING_HEADER_FILE
+#define UNIFORM_RING_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "frames_in_flight.h"
+
+//  ------------------------------- Uniform ring------------------------------------------------------------------
+// Per draw uniforms for any number of objects out of one uniform buffer bound
+// with a dynamic offset. Each frame, between beginFrame() and endFrame() of the
+// ring's frames in flight:
+//   pushUniforms() / allocUniforms()   per draw, gives the dynamic offset for
+//                                      wgpuRenderPassEncoderSetBindGroup()
+//   flushUniformRing()                 before wgpuQueueSubmit()
+// Slices are aligned to the device's minUniformBufferOffsetAlignment and
+// filled in a CPU copy, which the flush uploads with a single
+// wgpuQueueWriteBuffer (two on the frame where the ring wraps around).
+//
+// Slices of a frame the GPU may still be reading are never handed out again:
+// the flush has them given back when the frame retires (see
+// deferFrameRelease()), and when the ring is full the CPU waits for the oldest
+// frame in flight. Size the ring for maxFrames frames of uniforms.
+
+// What pushUniforms() returns when a frame asks for more than the ring holds
+#define UNIFORM_RING_FULL UINT32_MAX
+
+// The frame releases point to it: don't move a ring with frames in flight
+typedef struct UniformRing {
+    t_frames_in_flight * frames;
+    WGPUQueue queue;
+    WGPUBuffer buffer;
+    uint64_t size;
+    uint32_t alignment;
+    uint8_t * data;             // CPU copy of the buffer
+    // Positions count bytes since the start, the buffer offset is position % size
+    uint64_t head;              // next free byte
+    uint64_t tail;              // first byte of the oldest frame in flight
+    uint64_t frameStart;        // first byte of the frame being filled
+    uint64_t frameEnds[MAX_FRAMES_IN_FLIGHT];   // where the slices of each frame not retired end, oldest first
+    size_t firstFrame;
+    size_t frameCount;
+    uint64_t lastFrame;         // the frame of the newest end
+} t_uniform_ring;
+
+// Creates a Uniform | CopyDst buffer of size bytes on the frames' device
+bool initUniformRing(t_uniform_ring * ring, t_frames_in_flight * frames, uint64_t size);
+// Call after releaseFramesInFlight(), which runs the releases pointing to it
+void releaseUniformRing(t_uniform_ring * ring);
+
+// CPU memory for size bytes of uniforms, to fill before the flush. Returns
+// NULL if they don't fit in the ring even with the GPU idle.
+void * allocUniforms(t_uniform_ring * ring, size_t size, uint32_t * dynamicOffset);
+
+// Copies data in and returns its dynamic offset, or UNIFORM_RING_FULL
+uint32_t pushUniforms(t_uniform_ring * ring, const void * data, size_t size);
+
+void flushUniformRing(t_uniform_ring * ring);
+
+#endif
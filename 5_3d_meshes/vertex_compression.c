@@ -0,0 +1,274 @@
+#include <webgpu/webgpu.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vertex_compression.h"
+
+//  ------------------------------- Encodings------------------------------------------------------------------
+
+// Round to nearest even, like the GPU would convert
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if ((bits & 0x7fffffff) > 0x7f800000) return sign | 0x7e00;    // NaN
+    if (exponent >= 31) return sign | 0x7c00;                      // too large: inf
+    if (exponent <= 0) {
+        // Subnormal half, or zero
+        if (exponent < -10) return sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return sign | half;
+    }
+    uint32_t half = (exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    // A carry out of the mantissa bumps the exponent, up to inf: that's right
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+    return sign | half;
+}
+
+static float halfToFloat(uint16_t half) {
+    float sign = half & 0x8000 ? -1.0f : 1.0f;
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    if (exponent == 0) return sign * ldexpf(mantissa, -24);
+    if (exponent == 31) return mantissa ? NAN : sign * INFINITY;
+    return sign * ldexpf(mantissa + 1024, exponent - 25);
+}
+
+static int16_t floatToSnorm16(float value) {
+    if (value > 1) value = 1;
+    if (value < -1) value = -1;
+    return (int16_t)lrintf(value * 32767);
+}
+
+static float snorm16ToFloat(int16_t value) {
+    // -32768 also decodes to -1
+    float decoded = value / 32767.0f;
+    return decoded < -1 ? -1 : decoded;
+}
+
+static uint8_t floatToUnorm8(float value) {
+    if (!(value > 0)) value = 0;
+    if (value > 1) value = 1;
+    return (uint8_t)lrintf(value * 255);
+}
+
+//  ------------------------------- Compression------------------------------------------------------------------
+
+static size_t floatComponents(WGPUVertexFormat format) {
+    switch (format) {
+    case WGPUVertexFormat_Float32: return 1;
+    case WGPUVertexFormat_Float32x2: return 2;
+    case WGPUVertexFormat_Float32x3: return 3;
+    case WGPUVertexFormat_Float32x4: return 4;
+    default: return 0;
+    }
+}
+
+static const WGPUVertexAttribute * findAttribute(const WGPUVertexBufferLayout * layout, uint32_t shaderLocation) {
+    for (size_t i = 0; i < layout->attributeCount; i++) {
+        if (layout->attributes[i].shaderLocation == shaderLocation) return &layout->attributes[i];
+    }
+    return NULL;
+}
+
+// Bounding box of the positions, as the scale and offset that map [-1, 1] onto it
+static void positionBounds(const char * points, size_t vertexCount, size_t stride, size_t offset, size_t components, float * scale, float * center) {
+    float low[4], high[4];
+    for (size_t c = 0; c < components; c++) {
+        low[c] = INFINITY;
+        high[c] = -INFINITY;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        const float *p = (const float *)(points + v * stride + offset);
+        for (size_t c = 0; c < components; c++) {
+            if (p[c] < low[c]) low[c] = p[c];
+            if (p[c] > high[c]) high[c] = p[c];
+        }
+    }
+    for (size_t c = 0; c < components; c++) {
+        if (vertexCount == 0) low[c] = high[c] = 0;
+        center[c] = (low[c] + high[c]) / 2;
+        scale[c] = (high[c] - low[c]) / 2;
+        // Flat along this axis: any scale decodes back to the center
+        if (!(scale[c] > 0)) scale[c] = 1;
+    }
+}
+
+bool compressVertices(const t_geometry_data * geometry_data, const WGPUVertexBufferLayout * layout,
+    uint32_t positionLocation, uint32_t colorLocation, t_position_encoding encoding, t_compressed_vertices * compressed) {
+    *compressed = (t_compressed_vertices){0};
+    const WGPUVertexAttribute *position = findAttribute(layout, positionLocation);
+    const WGPUVertexAttribute *color = findAttribute(layout, colorLocation);
+    size_t positionComponents = position ? floatComponents(position->format) : 0;
+    size_t colorComponents = color ? floatComponents(color->format) : 0;
+    if (positionComponents < 2 || (color && colorComponents < 3) || layout->arrayStride == 0) {
+        printf("Can only compress Float32x2..4 positions and Float32x3..4 colours.\n");
+        return false;
+    }
+    if (layout->attributeCount > (color ? 2u : 1u)) printf("Vertex compression drops the attributes besides position and colour.\n");
+
+    size_t vertexCount = geometry_data->pointDataSize / layout->arrayStride;
+    size_t positionSize = positionComponents == 2 ? 4 : 8;
+    size_t colorSize = color ? 4 : 0;
+    size_t stride = positionSize + colorSize;
+    char *out = malloc((vertexCount ? vertexCount : 1) * stride);
+    if (!out) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+
+    bool snorm = encoding == PositionEncoding_Snorm16;
+    size_t encodedComponents = positionComponents == 2 ? 2 : 4;
+    compressed->vertexData = out;
+    compressed->vertexDataSize = vertexCount * stride;
+    compressed->vertexCount = vertexCount;
+    compressed->arrayStride = stride;
+    compressed->encoding = encoding;
+    compressed->positionComponents = positionComponents;
+    compressed->attributes[compressed->attributeCount++] = (WGPUVertexAttribute){
+        .shaderLocation = positionLocation,
+        .format = snorm ?
+            (encodedComponents == 2 ? WGPUVertexFormat_Snorm16x2 : WGPUVertexFormat_Snorm16x4) :
+            (encodedComponents == 2 ? WGPUVertexFormat_Float16x2 : WGPUVertexFormat_Float16x4),
+        .offset = 0
+    };
+    if (color) {
+        compressed->attributes[compressed->attributeCount++] = (WGPUVertexAttribute){
+            .shaderLocation = colorLocation,
+            .format = WGPUVertexFormat_Unorm8x4,
+            .offset = positionSize
+        };
+    }
+
+    const char *points = (const char *)geometry_data->pointData;
+    positionBounds(points, vertexCount, layout->arrayStride, position->offset, positionComponents,
+        compressed->positionScale, compressed->positionOffset);
+
+    double squaredError = 0;
+    for (size_t v = 0; v < vertexCount; v++) {
+        const float *p = (const float *)(points + v * layout->arrayStride + position->offset);
+        char *vertex = out + v * stride;
+        double distance = 0;
+        for (size_t c = 0; c < encodedComponents; c++) {
+            float normalized = c < positionComponents ? (p[c] - compressed->positionOffset[c]) / compressed->positionScale[c] : 0;
+            float decoded;
+            if (snorm) {
+                int16_t q = floatToSnorm16(normalized);
+                memcpy(vertex + c * sizeof(q), &q, sizeof(q));
+                decoded = snorm16ToFloat(q);
+            } else {
+                uint16_t h = floatToHalf(normalized);
+                memcpy(vertex + c * sizeof(h), &h, sizeof(h));
+                decoded = halfToFloat(h);
+            }
+            if (c >= positionComponents) continue;
+            float error = fabsf(decoded * compressed->positionScale[c] + compressed->positionOffset[c] - p[c]);
+            if (error > compressed->maxPositionError) compressed->maxPositionError = error;
+            distance += (double)error * error;
+        }
+        squaredError += distance;
+
+        if (!color) continue;
+        const float *rgba = (const float *)(points + v * layout->arrayStride + color->offset);
+        uint8_t *q = (uint8_t *)vertex + positionSize;
+        for (size_t c = 0; c < 4; c++) {
+            float channel = c < colorComponents ? rgba[c] : 1.0f;
+            q[c] = floatToUnorm8(channel);
+            float error = fabsf(q[c] / 255.0f - channel);
+            if (error > compressed->maxColorError) compressed->maxColorError = error;
+        }
+    }
+    compressed->rmsPositionError = vertexCount ? sqrt(squaredError / vertexCount) : 0;
+    return true;
+}
+
+void freeCompressedVertices(t_compressed_vertices * compressed) {
+    free(compressed->vertexData);
+    *compressed = (t_compressed_vertices){0};
+}
+
+WGPUVertexBufferLayout compressedVertexLayout(const t_compressed_vertices * compressed) {
+    return (WGPUVertexBufferLayout){
+        .attributeCount = compressed->attributeCount,
+        .attributes = compressed->attributes,
+        .arrayStride = compressed->arrayStride,
+        .stepMode = WGPUVertexStepMode_Vertex
+    };
+}
+
+bool loadCompressedGeometryBuffers(WGPUDevice device, const char * path, const WGPUVertexBufferLayout * layout,
+    uint32_t positionLocation, uint32_t colorLocation, t_position_encoding encoding,
+    t_compressed_vertices * compressed, t_geometry_buffers * buffers) {
+    struct GeometryData geometrydata = {NULL, 0, NULL, 0};
+    bool success = loadGeometry(path, &geometrydata) &&
+        compressVertices(&geometrydata, layout, positionLocation, colorLocation, encoding, compressed);
+    if (!success) {
+        free(geometrydata.pointData);
+        free(geometrydata.indexData);
+        return false;
+    }
+    *buffers = (t_geometry_buffers){
+        .vertexBuffer = createBufferWithData(device, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex, compressed->vertexData, compressed->vertexDataSize),
+        .vertexDataSize = compressed->vertexDataSize,
+        .indexBuffer = createBufferWithData(device, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index, geometrydata.indexData, geometrydata.indexDataSize),
+        .indexDataSize = geometrydata.indexDataSize,
+        .indexCount = geometrydata.indexDataSize / indexFormatSize(geometrydata.indexFormat),
+        .indexFormat = geometrydata.indexFormat
+    };
+    free(geometrydata.pointData);
+    free(geometrydata.indexData);
+    free(compressed->vertexData);
+    compressed->vertexData = NULL;
+    return true;
+}
+
+//  ------------------------------- Shader snippet------------------------------------------------------------------
+
+static int printVector(char * text, size_t size, const char * name, const float * values, size_t components) {
+    int length = snprintf(text, size, "const %s = vec%zuf(", name, components);
+    for (size_t c = 0; c < components; c++) {
+        length += snprintf(text + length, length < (int)size ? size - length : 0, "%s%.9g", c ? ", " : "", values[c]);
+    }
+    return length + snprintf(text + length, length < (int)size ? size - length : 0, ");\n");
+}
+
+char * dequantizationSnippet(const t_compressed_vertices * compressed) {
+    static const char *swizzles[] = {"", "x", "xy", "xyz", "xyzw"};
+    size_t components = compressed->positionComponents;
+    size_t size = 1024;
+    char *text = malloc(size);
+    if (!text) return NULL;
+    int length = snprintf(text, size,
+        "// Positions are %s, normalized to the mesh bounds.\n"
+        "// Take the position input as a vec4f and call decodePosition() on it.\n",
+        compressed->encoding == PositionEncoding_Snorm16 ? "Snorm16" : "Float16");
+    length += printVector(text + length, size - length, "positionScale", compressed->positionScale, components);
+    length += printVector(text + length, size - length, "positionOffset", compressed->positionOffset, components);
+    snprintf(text + length, size - length,
+        "fn decodePosition(encoded: vec4f) -> vec%zuf {\n"
+        "    return encoded.%s * positionScale + positionOffset;\n"
+        "}\n",
+        components, swizzles[components]);
+    return text;
+}
+
+size_t dequantizationConstants(const t_compressed_vertices * compressed, WGPUConstantEntry * constants) {
+    static const char *scaleKeys[] = {"positionScaleX", "positionScaleY", "positionScaleZ", "positionScaleW"};
+    static const char *offsetKeys[] = {"positionOffsetX", "positionOffsetY", "positionOffsetZ", "positionOffsetW"};
+    size_t count = 0;
+    for (size_t c = 0; c < compressed->positionComponents; c++) {
+        constants[count++] = (WGPUConstantEntry){.key = scaleKeys[c], .value = compressed->positionScale[c]};
+        constants[count++] = (WGPUConstantEntry){.key = offsetKeys[c], .value = compressed->positionOffset[c]};
+    }
+    return count;
+}
@@ -0,0 +1,76 @@
+#ifndef VERTEX_COMPRESSION_HEADER_FILE
+#define VERTEX_COMPRESSION_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "helper_v3.h"
+#include "geometry_cache.h"
+
+//  ------------------------------- Vertex compression------------------------------------------------------------------
+// Re-encodes float vertices into smaller vertex formats:
+//  - positions are normalized to the mesh bounding box, then stored as
+//    Snorm16 or Float16 (x2 for 2D positions, x4 otherwise)
+//  - colours are stored as Unorm8x4 (alpha 1 when the source has 3 channels)
+// The matching vertex buffer layout is derived from the result, and a WGSL
+// snippet or a set of override constants undoes the position normalization in
+// the vertex shader. Unorm8x4 colours need no help: the shader sees them as a
+// vec4f in [0, 1]. depth_buffer draws its mesh this way.
+
+typedef enum PositionEncoding {
+    PositionEncoding_Snorm16,   // 16 bit fixed point, uniform precision over the bounds
+    PositionEncoding_Float16,   // half floats, more precision near the center
+} t_position_encoding;
+
+#define COMPRESSED_MAX_ATTRIBUTES 2
+
+typedef struct CompressedVertices {
+    void * vertexData;
+    size_t vertexDataSize;
+    size_t vertexCount;
+    size_t arrayStride;
+    size_t attributeCount;
+    WGPUVertexAttribute attributes[COMPRESSED_MAX_ATTRIBUTES];
+    t_position_encoding encoding;
+    size_t positionComponents;
+    // position = decoded * positionScale + positionOffset
+    float positionScale[4];
+    float positionOffset[4];
+    // Measured against the source vertices
+    float maxPositionError;     // largest error of one component, in mesh units
+    float rmsPositionError;     // root mean square of the per vertex distance
+    float maxColorError;        // largest error of one channel, in [0, 1]
+} t_compressed_vertices;
+
+// Compresses the vertices described by layout (Float32x2..4 attributes only).
+// The attribute at positionLocation is the position, the one at colorLocation
+// the colour; the colour may be missing. Shader locations are kept.
+bool compressVertices(const t_geometry_data * geometry_data, const WGPUVertexBufferLayout * layout,
+    uint32_t positionLocation, uint32_t colorLocation, t_position_encoding encoding, t_compressed_vertices * compressed);
+void freeCompressedVertices(t_compressed_vertices * compressed);
+
+// Layout for the compressed vertex buffer. It points into compressed, which
+// must outlive the pipeline descriptor using it.
+WGPUVertexBufferLayout compressedVertexLayout(const t_compressed_vertices * compressed);
+
+// WGSL constants and a decodePosition() function to paste in the shader.
+// Returns a malloc'd string.
+char * dequantizationSnippet(const t_compressed_vertices * compressed);
+
+// The same numbers as pipeline override constants, for a shader that declares
+// positionScaleX, positionScaleY... and positionOffsetX... (f32, one per
+// position component) rather than pasting the snippet. The keys are static.
+// Returns the number of entries written, 2 * positionComponents.
+#define DEQUANTIZATION_MAX_CONSTANTS 8
+size_t dequantizationConstants(const t_compressed_vertices * compressed, WGPUConstantEntry * constants);
+
+// Loads a geometry file laid out as layout (through its cache, see
+// loadGeometry()), compresses it and creates the GPU buffers. compressed keeps
+// the layout and the dequantization numbers, its vertexData is freed once
+// uploaded.
+bool loadCompressedGeometryBuffers(WGPUDevice device, const char * path, const WGPUVertexBufferLayout * layout,
+    uint32_t positionLocation, uint32_t colorLocation, t_position_encoding encoding,
+    t_compressed_vertices * compressed, t_geometry_buffers * buffers);
+
+#endif
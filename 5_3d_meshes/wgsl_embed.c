@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "embedded_shaders.h"
+#include "wgsl_preprocessor.h"
+
+// Build tool for embed_shaders.cmake:
+//   wgsl_embed preprocess <in.wsl> <out.wgsl> [NAME=value]...
+//       one permutation, what Tint gets to validate
+//   wgsl_embed table <out.c> <resource dir> <file.wsl>...
+//       the embedded shader table
+
+// The tool itself reads every shader from disk
+const t_embedded_shader embeddedShaders[] = {{NULL, NULL, 0}};
+const size_t embeddedShaderCount = 0;
+const char embeddedShaderRoot[] = "";
+
+static bool writeFile(const char * path, const char * data, size_t size) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        printf("can't open file:\n %s\n", path);
+        return false;
+    }
+    bool success = fwrite(data, 1, size, f) == size;
+    success = fclose(f) == 0 && success;
+    if (!success) printf("can't write file:\n %s\n", path);
+    return success;
+}
+
+// With no defines Tint validates the permutation every #if is false in
+static bool preprocess(const char * inPath, const char * outPath, char ** defineArgs, int defineCount) {
+    t_wgsl_define *defines = malloc((defineCount ? defineCount : 1) * sizeof(t_wgsl_define));
+    if (!defines) {
+        printf("Memory Allocation failed.\n");
+        return false;
+    }
+    for (int i = 0; i < defineCount; i++) {
+        // NAME=value, or NAME alone for a flag
+        char *equals = strchr(defineArgs[i], '=');
+        if (equals) *equals = '\0';
+        defines[i] = (t_wgsl_define){defineArgs[i], equals ? equals + 1 : NULL};
+    }
+    size_t length;
+    char *source = readShaderSource(inPath, &length);
+    char *out = NULL;
+    size_t outLength;
+    if (source) out = preprocessWgsl(inPath, source, length, defines, defineCount, &outLength);
+    free(source);
+    free(defines);
+    if (!out) return false;
+    bool success = writeFile(outPath, out, outLength);
+    free(out);
+    return success;
+}
+
+// Byte arrays rather than string literals, which compilers cap in length
+static bool writeTable(const char * outPath, const char * root, char ** paths, int count) {
+    size_t rootLength = strlen(root);
+    while (rootLength > 1 && root[rootLength - 1] == '/') rootLength--;
+    for (int i = 0; i < count; i++) {
+        if (strncmp(paths[i], root, rootLength) != 0 || paths[i][rootLength] != '/') {
+            printf("shader isn't in the resource directory %.*s:\n %s\n", (int)rootLength, root, paths[i]);
+            return false;
+        }
+    }
+    FILE *f = fopen(outPath, "w");
+    if (!f) {
+        printf("can't open file:\n %s\n", outPath);
+        return false;
+    }
+    fprintf(f, "// Generated by wgsl_embed, don't edit\n#include \"embedded_shaders.h\"\n");
+    for (int i = 0; i < count; i++) {
+        size_t length;
+        char *source = readShaderSource(paths[i], &length);
+        if (!source) {
+            fclose(f);
+            remove(outPath);
+            return false;
+        }
+        fprintf(f, "\n// %s\nstatic const char shader%d[] = {", paths[i], i);
+        for (size_t j = 0; j <= length; j++) {
+            fprintf(f, "%s%d,", j % 24 == 0 ? "\n    " : "", (unsigned char)source[j]);
+        }
+        fprintf(f, "\n};\n");
+        free(source);
+    }
+    fprintf(f, "\nconst t_embedded_shader embeddedShaders[] = {\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "    {\"%s\", shader%d, sizeof(shader%d) - 1},\n", paths[i] + rootLength + 1, i, i);
+    }
+    fprintf(f, "    {NULL, NULL, 0}\n};\nconst size_t embeddedShaderCount = %d;\n", count);
+    fprintf(f, "const char embeddedShaderRoot[] = \"%.*s\";\n", (int)rootLength, root);
+    if (fclose(f) != 0) {
+        printf("can't write file:\n %s\n", outPath);
+        remove(outPath);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "preprocess") == 0) return preprocess(argv[2], argv[3], argv + 4, argc - 4) ? 0 : 1;
+    if (argc >= 4 && strcmp(argv[1], "table") == 0) return writeTable(argv[2], argv[3], argv + 4, argc - 4) ? 0 : 1;
+    printf("usage: wgsl_embed preprocess <in.wsl> <out.wgsl> [NAME=value]...\n"
+           "       wgsl_embed table <out.c> <resource dir> <file.wsl>...\n");
+    return 1;
+}
@@ -0,0 +1,565 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wgsl_preprocessor.h"
+#include "embedded_shaders.h"
+
+// How deep a define may expand to other defines (guards against #define A A)
+#define MAX_EXPANSION_DEPTH 8
+
+typedef struct Macro {
+    char * name;
+    char * value;
+} t_macro;
+
+typedef struct Conditional {
+    bool active;        // lines are kept
+    bool taken;         // some branch of this #if was active already
+    bool parentActive;
+    bool seenElse;
+} t_conditional;
+
+typedef struct Preprocessor {
+    char * out;
+    size_t outSize;
+    size_t outCapacity;
+    t_macro * macros;
+    size_t macroCount;
+    size_t macroCapacity;
+    t_conditional conditionals[WGSL_MAX_IF_DEPTH];
+    size_t conditionalCount;
+    // Where we are, for errors
+    const char * path;
+    size_t line;
+    // Block comments open where the current line starts (they nest in WGSL)
+    int commentDepth;
+    bool failed;
+} t_preprocessor;
+
+static void fail(t_preprocessor * pp, const char * format, ...) {
+    if (pp->failed) return;
+    pp->failed = true;
+    printf("can't preprocess %s:%zu: ", pp->path, pp->line);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+static void append(t_preprocessor * pp, const char * text, size_t size) {
+    if (pp->failed) return;
+    if (pp->outSize + size + 1 > pp->outCapacity) {
+        size_t capacity = pp->outCapacity ? pp->outCapacity : 4096;
+        while (pp->outSize + size + 1 > capacity) capacity *= 2;
+        char *tmp = realloc(pp->out, capacity);
+        if (!tmp) {
+            printf("Memory Re-allocation failed.\n");
+            pp->failed = true;
+            return;
+        }
+        pp->out = tmp;
+        pp->outCapacity = capacity;
+    }
+    memcpy(pp->out + pp->outSize, text, size);
+    pp->outSize += size;
+    pp->out[pp->outSize] = '\0';
+}
+
+static bool isIdentifierStart(char c) {
+    return isalpha((unsigned char)c) || c == '_';
+}
+
+static bool isIdentifier(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static const char * skipSpaces(const char * p, const char * end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static const char * identifierEnd(const char * p, const char * end) {
+    if (p == end || !isIdentifierStart(*p)) return p;
+    while (p < end && isIdentifier(*p)) p++;
+    return p;
+}
+
+// Where the block comment p is inside of ends, or end if it goes on. depth is
+// how many are open at p, updated.
+static const char * blockCommentEnd(int * depth, const char * p, const char * end) {
+    while (*depth > 0 && p < end) {
+        if (p + 1 < end && p[0] == '/' && p[1] == '*') {
+            (*depth)++;
+            p += 2;
+        } else if (p + 1 < end && p[0] == '*' && p[1] == '/') {
+            (*depth)--;
+            p += 2;
+        } else {
+            p++;
+        }
+    }
+    return p;
+}
+
+// Follows the block comments opened and closed in [p, end), which holds no code
+// that matters (a skipped line, or the comments after a directive)
+static void skipComments(int * depth, const char * p, const char * end) {
+    while (p < end) {
+        if (*depth > 0) {
+            p = blockCommentEnd(depth, p, end);
+        } else if (p + 1 < end && p[0] == '/' && p[1] == '/') {
+            return;
+        } else if (p + 1 < end && p[0] == '/' && p[1] == '*') {
+            *depth = 1;
+            p = blockCommentEnd(depth, p + 2, end);
+        } else {
+            p++;
+        }
+    }
+}
+
+// The first comment of a line, end if there is none
+static const char * commentStart(const char * p, const char * end) {
+    for (; p + 1 < end; p++) {
+        if (p[0] == '/' && (p[1] == '/' || p[1] == '*')) return p;
+    }
+    return end;
+}
+
+//  ------------------------------- Defines------------------------------------------------------------------
+
+static t_macro * findMacro(t_preprocessor * pp, const char * name, size_t length) {
+    for (size_t i = 0; i < pp->macroCount; i++) {
+        if (strlen(pp->macros[i].name) == length && memcmp(pp->macros[i].name, name, length) == 0) return &pp->macros[i];
+    }
+    return NULL;
+}
+
+static void setMacro(t_preprocessor * pp, const char * name, size_t nameLength, const char * value, size_t valueLength) {
+    char *valueCopy = malloc(valueLength + 1);
+    if (!valueCopy) {
+        printf("Memory Allocation failed.\n");
+        pp->failed = true;
+        return;
+    }
+    memcpy(valueCopy, value, valueLength);
+    valueCopy[valueLength] = '\0';
+    t_macro *macro = findMacro(pp, name, nameLength);
+    if (macro) {
+        free(macro->value);
+        macro->value = valueCopy;
+        return;
+    }
+    char *nameCopy = malloc(nameLength + 1);
+    if (nameCopy && pp->macroCount == pp->macroCapacity) {
+        size_t capacity = pp->macroCapacity ? pp->macroCapacity * 2 : 16;
+        t_macro *tmp = realloc(pp->macros, capacity * sizeof(t_macro));
+        if (tmp) {
+            pp->macros = tmp;
+            pp->macroCapacity = capacity;
+        } else {
+            free(nameCopy);
+            nameCopy = NULL;
+        }
+    }
+    if (!nameCopy) {
+        printf("Memory Allocation failed.\n");
+        free(valueCopy);
+        pp->failed = true;
+        return;
+    }
+    memcpy(nameCopy, name, nameLength);
+    nameCopy[nameLength] = '\0';
+    pp->macros[pp->macroCount++] = (t_macro){nameCopy, valueCopy};
+}
+
+static void removeMacro(t_preprocessor * pp, const char * name, size_t length) {
+    t_macro *macro = findMacro(pp, name, length);
+    if (!macro) return;
+    free(macro->name);
+    free(macro->value);
+    *macro = pp->macros[--pp->macroCount];
+}
+
+// Copies [p, end) to the output with defines replaced. Comments are copied as
+// is, block comments may go on from the previous line and on to the next.
+static void substitute(t_preprocessor * pp, const char * p, const char * end, int depth) {
+    while (p < end && !pp->failed) {
+        const char *q;
+        if (pp->commentDepth > 0) {
+            q = blockCommentEnd(&pp->commentDepth, p, end);
+        } else if (p + 1 < end && p[0] == '/' && p[1] == '/') {
+            q = end;
+        } else if (p + 1 < end && p[0] == '/' && p[1] == '*') {
+            pp->commentDepth = 1;
+            q = blockCommentEnd(&pp->commentDepth, p + 2, end);
+        } else if (isIdentifierStart(*p)) {
+            q = identifierEnd(p, end);
+            t_macro *macro = depth < MAX_EXPANSION_DEPTH ? findMacro(pp, p, q - p) : NULL;
+            if (macro) {
+                substitute(pp, macro->value, macro->value + strlen(macro->value), depth + 1);
+                p = q;
+                continue;
+            }
+        } else if (isdigit((unsigned char)*p)) {
+            // Numbers like 1e5 or 0x1fu hold letters that aren't identifiers
+            for (q = p; q < end && (isIdentifier(*q) || *q == '.'); q++);
+        } else {
+            for (q = p + 1; q < end && !isIdentifier(*q) && *q != '/'; q++);
+        }
+        append(pp, p, q - p);
+        p = q;
+    }
+}
+
+//  ------------------------------- Expressions------------------------------------------------------------------
+
+typedef struct Expression {
+    t_preprocessor * pp;
+    const char * p;
+    const char * end;
+    int depth;
+    int skipping;       // inside the side && or || doesn't need
+} t_expression;
+
+static long long parseOr(t_expression * e);
+
+// Whether p starts a two character operator, or a comment
+static bool isLongToken(const char * p, const char * end) {
+    static const char *tokens[] = {"<=", ">=", "==", "!=", "&&", "||", "//"};
+    if (end - p < 2) return false;
+    for (size_t i = 0; i < sizeof(tokens) / sizeof(tokens[0]); i++) {
+        if (p[0] == tokens[i][0] && p[1] == tokens[i][1]) return true;
+    }
+    return false;
+}
+
+static bool accept(t_expression * e, const char * token) {
+    e->p = skipSpaces(e->p, e->end);
+    size_t length = strlen(token);
+    if ((size_t)(e->end - e->p) < length || memcmp(e->p, token, length) != 0) return false;
+    // "<" is not the start of "<="
+    if (length == 1 && isLongToken(e->p, e->end)) return false;
+    e->p += length;
+    return true;
+}
+
+static long long evaluate(t_preprocessor * pp, const char * p, const char * end, int depth);
+
+static long long parsePrimary(t_expression * e) {
+    e->p = skipSpaces(e->p, e->end);
+    if (accept(e, "(")) {
+        long long value = parseOr(e);
+        if (!accept(e, ")")) fail(e->pp, "missing ')'");
+        return value;
+    }
+    if (e->p < e->end && isdigit((unsigned char)*e->p)) {
+        char number[32];
+        size_t length = 0;
+        while (e->p < e->end && isIdentifier(*e->p) && length + 1 < sizeof(number)) number[length++] = *e->p++;
+        number[length] = '\0';
+        // C style suffixes (1u, 2L...) are fine, WGSL ones too
+        char *eon;
+        long long value = strtoll(number, &eon, 0);
+        if (eon == number || strspn(eon, "uUlLi") != strlen(eon)) fail(e->pp, "bad number '%s'", number);
+        return value;
+    }
+    const char *name = e->p;
+    const char *nameEnd = identifierEnd(name, e->end);
+    if (nameEnd == name) {
+        fail(e->pp, "expected a value in #if");
+        return 0;
+    }
+    e->p = nameEnd;
+    if (nameEnd - name == 7 && memcmp(name, "defined", 7) == 0) {
+        bool parenthesis = accept(e, "(");
+        e->p = skipSpaces(e->p, e->end);
+        const char *defined = e->p;
+        const char *definedEnd = identifierEnd(defined, e->end);
+        e->p = definedEnd;
+        if (definedEnd == defined || (parenthesis && !accept(e, ")"))) fail(e->pp, "bad defined()");
+        return findMacro(e->pp, defined, definedEnd - defined) != NULL;
+    }
+    t_macro *macro = findMacro(e->pp, name, nameEnd - name);
+    if (!macro) return 0;
+    if (macro->value[0] == '\0') return 1;
+    if (e->depth >= MAX_EXPANSION_DEPTH) {
+        fail(e->pp, "%.*s expands too deep", (int)(nameEnd - name), name);
+        return 0;
+    }
+    return evaluate(e->pp, macro->value, macro->value + strlen(macro->value), e->depth + 1);
+}
+
+static long long parseUnary(t_expression * e) {
+    if (accept(e, "!")) return !parseUnary(e);
+    if (accept(e, "-")) return -parseUnary(e);
+    if (accept(e, "+")) return parseUnary(e);
+    if (accept(e, "~")) return ~parseUnary(e);
+    return parsePrimary(e);
+}
+
+static long long parseMultiplicative(t_expression * e) {
+    long long value = parseUnary(e);
+    for (;;) {
+        if (accept(e, "*")) {
+            value *= parseUnary(e);
+        } else {
+            bool divide = accept(e, "/");
+            if (!divide && !accept(e, "%")) return value;
+            long long divisor = parseUnary(e);
+            if (divisor == 0) {
+                if (!e->skipping) fail(e->pp, "division by zero");
+                return 0;
+            }
+            value = divide ? value / divisor : value % divisor;
+        }
+    }
+}
+
+static long long parseAdditive(t_expression * e) {
+    long long value = parseMultiplicative(e);
+    for (;;) {
+        if (accept(e, "+")) value += parseMultiplicative(e);
+        else if (accept(e, "-")) value -= parseMultiplicative(e);
+        else return value;
+    }
+}
+
+static long long parseRelational(t_expression * e) {
+    long long value = parseAdditive(e);
+    for (;;) {
+        if (accept(e, "<=")) value = value <= parseAdditive(e);
+        else if (accept(e, ">=")) value = value >= parseAdditive(e);
+        else if (accept(e, "<")) value = value < parseAdditive(e);
+        else if (accept(e, ">")) value = value > parseAdditive(e);
+        else return value;
+    }
+}
+
+static long long parseEquality(t_expression * e) {
+    long long value = parseRelational(e);
+    for (;;) {
+        if (accept(e, "==")) value = value == parseRelational(e);
+        else if (accept(e, "!=")) value = value != parseRelational(e);
+        else return value;
+    }
+}
+
+static long long parseAnd(t_expression * e) {
+    long long value = parseEquality(e);
+    while (accept(e, "&&")) {
+        e->skipping += !value;
+        long long right = parseEquality(e);
+        e->skipping -= !value;
+        value = value && right;
+    }
+    return value;
+}
+
+static long long parseOr(t_expression * e) {
+    long long value = parseAnd(e);
+    while (accept(e, "||")) {
+        e->skipping += !!value;
+        long long right = parseAnd(e);
+        e->skipping -= !!value;
+        value = value || right;
+    }
+    return value;
+}
+
+static long long evaluate(t_preprocessor * pp, const char * p, const char * end, int depth) {
+    t_expression e = {pp, p, end, depth, 0};
+    long long value = parseOr(&e);
+    e.p = skipSpaces(e.p, e.end);
+    if (e.p < e.end && !(e.p + 1 < e.end && e.p[0] == '/' && e.p[1] == '/')) fail(pp, "unexpected '%.*s' in #if", (int)(e.end - e.p), e.p);
+    return value;
+}
+
+//  ------------------------------- Directives------------------------------------------------------------------
+
+static bool isActive(const t_preprocessor * pp) {
+    return pp->conditionalCount == 0 || pp->conditionals[pp->conditionalCount - 1].active;
+}
+
+static bool processSource(t_preprocessor * pp, const char * path, const char * source, size_t length, int depth);
+
+// "// #line 12 "file"": the next output line is line 12 of file
+static void appendLineMarker(t_preprocessor * pp, size_t line, const char * path) {
+    char marker[32];
+    int length = snprintf(marker, sizeof(marker), "// #line %zu \"", line);
+    append(pp, marker, length);
+    append(pp, path, strlen(path));
+    append(pp, "\"", 1);
+}
+
+static void includeFile(t_preprocessor * pp, const char * p, const char * end, int depth) {
+    p = skipSpaces(p, end);
+    const char *close = p < end && *p == '"' ? memchr(p + 1, '"', end - p - 1) : NULL;
+    if (!close) {
+        fail(pp, "expected #include \"file\"");
+        return;
+    }
+    if (depth + 1 > WGSL_MAX_INCLUDE_DEPTH) {
+        fail(pp, "includes nested deeper than %d", WGSL_MAX_INCLUDE_DEPTH);
+        return;
+    }
+    // Relative to the directory of the including file
+    const char *name = p + 1;
+    size_t nameLength = close - name;
+    const char *slash = strrchr(pp->path, '/');
+    size_t directoryLength = name[0] != '/' && slash ? (size_t)(slash - pp->path + 1) : 0;
+    char *includePath = malloc(directoryLength + nameLength + 1);
+    if (!includePath) {
+        printf("Memory Allocation failed.\n");
+        pp->failed = true;
+        return;
+    }
+    memcpy(includePath, pp->path, directoryLength);
+    memcpy(includePath + directoryLength, name, nameLength);
+    includePath[directoryLength + nameLength] = '\0';
+
+    size_t size;
+    char *text = readShaderSource(includePath, &size);
+    if (!text) {
+        fail(pp, "can't open include %s", includePath);
+    } else {
+        // Compiler messages count lines in the output: these markers say
+        // which file and line an output line comes from
+        appendLineMarker(pp, 1, includePath);
+        append(pp, "\n", 1);
+        processSource(pp, includePath, text, size, depth + 1);
+        free(text);
+        // The directive's line ends after this one
+        appendLineMarker(pp, pp->line + 1, pp->path);
+    }
+    free(includePath);
+}
+
+static void processDirective(t_preprocessor * pp, const char * p, const char * end, int depth) {
+    p = skipSpaces(p, end);
+    const char *directive = p;
+    p = identifierEnd(p, end);
+    size_t length = p - directive;
+    bool active = isActive(pp);
+    t_conditional *top = pp->conditionalCount ? &pp->conditionals[pp->conditionalCount - 1] : NULL;
+#define IS(name) (length == strlen(name) && memcmp(directive, name, length) == 0)
+
+    if (IS("if") || IS("ifdef") || IS("ifndef")) {
+        if (pp->conditionalCount == WGSL_MAX_IF_DEPTH) {
+            fail(pp, "#if nested deeper than %d", WGSL_MAX_IF_DEPTH);
+            return;
+        }
+        bool condition = false;
+        // Dead branches aren't evaluated, they may use what isn't defined
+        if (active && IS("if")) {
+            condition = evaluate(pp, p, end, 0) != 0;
+        } else if (active) {
+            const char *name = skipSpaces(p, end);
+            const char *nameEnd = identifierEnd(name, end);
+            if (nameEnd == name) fail(pp, "expected a name after #%.*s", (int)length, directive);
+            condition = (findMacro(pp, name, nameEnd - name) != NULL) == IS("ifdef");
+        }
+        pp->conditionals[pp->conditionalCount++] = (t_conditional){condition, condition, active, false};
+    } else if (IS("elif") || IS("else")) {
+        if (!top || top->seenElse) {
+            fail(pp, "#%.*s without #if", (int)length, directive);
+            return;
+        }
+        bool condition = top->parentActive && !top->taken;
+        if (condition && IS("elif")) condition = evaluate(pp, p, end, 0) != 0;
+        top->seenElse = IS("else");
+        top->active = condition;
+        top->taken = top->taken || condition;
+    } else if (IS("endif")) {
+        if (!top) fail(pp, "#endif without #if");
+        else pp->conditionalCount--;
+    } else if (!active) {
+        // Anything else in a dead branch is skipped unread
+    } else if (IS("include")) {
+        includeFile(pp, p, end, depth);
+    } else if (IS("define") || IS("undef")) {
+        const char *name = skipSpaces(p, end);
+        const char *nameEnd = identifierEnd(name, end);
+        if (nameEnd == name) {
+            fail(pp, "expected a name after #%.*s", (int)length, directive);
+            return;
+        }
+        if (IS("undef")) {
+            removeMacro(pp, name, nameEnd - name);
+            return;
+        }
+        const char *value = skipSpaces(nameEnd, end);
+        // Up to a comment, if any
+        const char *valueEnd = value;
+        while (valueEnd < end && !(valueEnd + 1 < end && valueEnd[0] == '/' && valueEnd[1] == '/')) valueEnd++;
+        while (valueEnd > value && isspace((unsigned char)valueEnd[-1])) valueEnd--;
+        setMacro(pp, name, nameEnd - name, value, valueEnd - value);
+    } else {
+        fail(pp, "unknown directive #%.*s", (int)length, directive);
+    }
+#undef IS
+}
+
+static bool processSource(t_preprocessor * pp, const char * path, const char * source, size_t length, int depth) {
+    const char *savedPath = pp->path;
+    size_t savedLine = pp->line;
+    size_t conditionalCount = pp->conditionalCount;
+    pp->path = path;
+    pp->line = 0;
+    // An #include is never inside a comment
+    pp->commentDepth = 0;
+    const char *end = source + length;
+    for (const char *line = source; line < end && !pp->failed;) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        pp->line++;
+        const char *p = skipSpaces(line, eol);
+        if (pp->commentDepth == 0 && p < eol && *p == '#') {
+            // The directive ends where its comments start. Its line becomes
+            // empty, so a block comment can't go on past it.
+            const char *comment = commentStart(p + 1, eol);
+            skipComments(&pp->commentDepth, comment, eol);
+            if (pp->commentDepth > 0) fail(pp, "a block comment opened on a directive line must close on it");
+            else processDirective(pp, p + 1, comment, depth);
+        } else if (isActive(pp)) {
+            substitute(pp, line, eol, 0);
+        } else {
+            // Left out, but it may open or close a block comment
+            skipComments(&pp->commentDepth, line, eol);
+        }
+        append(pp, "\n", 1);
+        line = eol + 1;
+    }
+    if (!pp->failed && pp->conditionalCount != conditionalCount) fail(pp, "#if without #endif");
+    if (!pp->failed && pp->commentDepth > 0) fail(pp, "unterminated block comment");
+    pp->commentDepth = 0;
+    pp->path = savedPath;
+    pp->line = savedLine;
+    return !pp->failed;
+}
+
+char * preprocessWgsl(const char * path, const char * source, size_t length,
+    const t_wgsl_define * defines, size_t defineCount, size_t * outLength) {
+    t_preprocessor pp = {.path = path};
+    for (size_t i = 0; i < defineCount; i++) {
+        const char *value = defines[i].value ? defines[i].value : "";
+        setMacro(&pp, defines[i].name, strlen(defines[i].name), value, strlen(value));
+    }
+    // An empty source still gives an empty string
+    append(&pp, "", 0);
+    bool success = !pp.failed && processSource(&pp, path, source, length, 0);
+    for (size_t i = 0; i < pp.macroCount; i++) {
+        free(pp.macros[i].name);
+        free(pp.macros[i].value);
+    }
+    free(pp.macros);
+    if (!success) {
+        free(pp.out);
+        return NULL;
+    }
+    *outLength = pp.outSize;
+    return pp.out;
+}
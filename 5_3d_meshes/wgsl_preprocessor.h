@@ -0,0 +1,47 @@
+#ifndef WGSL_PREPROCESSOR_HEADER_FILE
+#define WGSL_PREPROCESSOR_HEADER_FILE
+
+#include <webgpu/webgpu.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//  ------------------------------- WGSL preprocessor------------------------------------------------------------------
+// A small C style preprocessor for building shader permutations out of one file:
+//   #include "file"          relative to the including file
+//   #define NAME [value]     NAME is replaced by value in the code that follows
+//   #undef NAME
+//   #if expr, #ifdef NAME, #ifndef NAME, #elif expr, #else, #endif
+// Expressions are integer C expressions over numbers, defines (undefined ones
+// are 0, empty ones 1) and defined(NAME). WGSL itself never uses '#', so any
+// other directive is an error. Comments, /* */ ones too (they nest in WGSL),
+// are left alone: no define is replaced in them and a '#' line inside one is
+// no directive. Directive lines and lines left out become empty lines, so up
+// to the first #include line numbers in compiler messages match the main
+// file. An included file's lines come between a "// #line 1 "file"" comment
+// and a "// #line N "main file"" one naming the line after the #include: the
+// closest marker above a line tells where it comes from.
+//
+// Values that only change numbers are better off as WGSL override constants
+// set with WGPUConstantEntry when the pipeline is built: one module serves
+// every value. Permutations are for code that differs.
+
+#define WGSL_MAX_INCLUDE_DEPTH 16
+#define WGSL_MAX_IF_DEPTH 32
+
+typedef struct WgslDefine {
+    const char * name;
+    const char * value;         // NULL or "" for a plain flag
+} t_wgsl_define;
+
+// Returns the preprocessed source (malloc'd, NUL terminated), or NULL after
+// printing the first error. path is where includes are resolved from.
+char * preprocessWgsl(const char * path, const char * source, size_t length,
+    const t_wgsl_define * defines, size_t defineCount, size_t * outLength);
+
+// Preprocesses a file with the given defines and goes through the shader
+// registry: each permutation is read and preprocessed once, and permutations
+// that come out the same share one module. Only the main file's mtime is
+// watched, not the files it includes.
+WGPUShaderModule loadShaderPermutation(WGPUDevice device, const char * path, const t_wgsl_define * defines, size_t defineCount);
+
+#endif